@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "../Entity/entity.h"
+
+// Crowd member that walks between random waypoints around a home point.
+// Process reads and writes nothing but the agent's own fields, so agents
+// are parallel-safe and update on the thread pool with
+// World::SetParallelUpdate. They don't collide by default, the resolve
+// phase would otherwise serialize them again.
+class Agent: public Entity {
+    DECLARE_POOLED_ENTITY(Agent)
+
+    protected:
+    Vector2 home = {0.0f, 0.0f};
+    float range = 256.0f;
+    float speed = 80.0f;
+    Vector2 waypoint = {0.0f, 0.0f};
+    uint32_t rng = 1;
+    uint32_t arrivals = 0;
+
+    float NextRandom() {
+        rng = rng * 1664525u + 1013904223u;
+        return (float)(rng >> 8) / 16777216.0f;
+    }
+
+    void PickWaypoint() {
+        float angle = NextRandom() * 6.2831853f;
+        float distance = std::sqrt(NextRandom()) * range;
+        waypoint = home + Vector2(std::cos(angle), std::sin(angle)) * distance;
+    }
+
+    public:
+    Agent() {
+        type = EntityType::AGENT;
+        hasCollision = false;
+        size = {8.0f, 8.0f};
+    }
+
+    // Wanders within range of home, seed picks the waypoints
+    void SetWander(Vector2 center, float radius, uint32_t seed) {
+        home = center;
+        range = std::max(radius, 1.0f);
+        rng = seed ? seed : 1;
+        PickWaypoint();
+    }
+
+    void SetSpeed(float s) { speed = s; }
+    float GetSpeed() const { return speed; }
+
+    // Waypoints reached so far
+    uint32_t GetArrivals() const { return arrivals; }
+
+    bool IsParallelSafe() const override { return true; }
+
+    void Process(double dt) override {
+        Vector2 toWaypoint = waypoint - position;
+        float distance = toWaypoint.Length();
+        if (distance < 4.0f) {
+            arrivals++;
+            PickWaypoint();
+            return;
+        }
+
+        // Eases into the desired velocity instead of turning on the spot
+        Vector2 desired = toWaypoint * (speed / distance);
+        float blend = std::min(1.0f, 4.0f * (float)dt);
+        velocity += (desired - velocity) * blend;
+        position += velocity * (float)dt;
+    }
+
+    void SaveState(SnapshotWriter &w) const override {
+        Entity::SaveState(w);
+        w.Write(home);
+        w.Write(range);
+        w.Write(speed);
+        w.Write(waypoint);
+        w.Write(rng);
+        w.Write(arrivals);
+    }
+
+    void LoadState(SnapshotReader &r) override {
+        Entity::LoadState(r);
+        r.Read(home);
+        r.Read(range);
+        r.Read(speed);
+        r.Read(waypoint);
+        r.Read(rng);
+        r.Read(arrivals);
+    }
+};
@@ -15,6 +15,8 @@ struct AnimationData_t {
 };
 
 class AnimatedEntity: public SpriteEntity {
+    DECLARE_POOLED_ENTITY(AnimatedEntity)
+
     protected:
     std::map<std::string, AnimationData_t> animations;
     std::string currentAnimation = "idle";
@@ -22,10 +24,46 @@ class AnimatedEntity: public SpriteEntity {
     double timeCount = 0.0;
 
     public:
+    AnimatedEntity() { type = EntityType::ANIMATED_ENTITY; }
+
+    // Frames change under a static entity too
+    bool IsDrawCacheable() const override { return false; }
+
+    // The animation table itself comes from InitializeAnimations, only the
+    // playback state is saved
+    void SaveState(SnapshotWriter &w) const override {
+        SpriteEntity::SaveState(w);
+        w.WriteString(currentAnimation);
+        w.Write(currentFrame);
+        w.Write(timeCount);
+    }
+
+    void LoadState(SnapshotReader &r) override {
+        SpriteEntity::LoadState(r);
+        r.ReadString(currentAnimation);
+        r.Read(currentFrame);
+        r.Read(timeCount);
+    }
+
     virtual void InitializeAnimations() {
         SDL_Log("Implement animations!");
     }
 
+    // Picks the animation to play, restarting it when it changes. Frames are
+    // advanced separately by TickAnimation (World::TickAnimations)
+    void SetAnimation(const std::string &newAnimation) {
+        if (newAnimation != currentAnimation) {
+            currentAnimation = newAnimation;
+            currentFrame = 0;
+            timeCount = 0.0;
+        }
+    }
+
+    void TickAnimation(double dt) {
+        timeCount += dt;
+        AdvanceFrame();
+    }
+
     virtual void UpdateAnimation(double dt, std::string newAnimation) {
         timeCount += dt;
         
@@ -35,7 +73,16 @@ class AnimatedEntity: public SpriteEntity {
             timeCount = 0.0;
         }
         
-        AnimationData_t& anim = animations[currentAnimation];
+        AdvanceFrame();
+    }
+
+    protected:
+    void AdvanceFrame() {
+        auto it = animations.find(currentAnimation);
+        if (it == animations.end() || it->second.frames.empty())
+            return;
+
+        AnimationData_t& anim = it->second;
         
         if (timeCount >= anim.frameInterval) {
             timeCount = 0.0;
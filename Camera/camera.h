@@ -2,12 +2,13 @@
 
 #include "../Vector2/vector2.h"
 #include "../Screen/screen.h"
+#include "../Snapshot/snapshot.h"
+#include "../Engine/enginecontext.h"
 
 class Camera {
     public:
     static Camera& GetInstance() {
-        static Camera instance;
-        return instance;
+        return EngineContext::Current().Get<Camera>();
     };
 
     void SetZoom(float zoom) {
@@ -22,6 +23,13 @@ class Camera {
         this->position = position;
     }
 
+    // Jumps there, the view doesn't slide over from the old position
+    void Teleport(Vector2 position) {
+        this->position = position;
+        previousPosition = position;
+        renderPosition = position;
+    }
+
     void SetScreen(Vector2 position) {
         screen = position;
     }
@@ -30,14 +38,34 @@ class Camera {
         return screen;
     }
 
+    // Screen conversions use the interpolated render position, so they match
+    // what was drawn this frame
     Vector2 WorldToScreen(Vector2 worldPosition) {
         Vector2 screenCenter = Screen::GetInstance().GetSize() / 2.0;
-        return (worldPosition - position) * zoom + screenCenter;
+        return (worldPosition - renderPosition) * zoom + screenCenter;
     }
 
     Vector2 ScreenToWorld(Vector2 screenPosition) {
         Vector2 screenCenter = Screen::GetInstance().GetSize() / 2.0;
-        return (screenPosition - screenCenter) / zoom + position;
+        return (screenPosition - screenCenter) / zoom + renderPosition;
+    }
+
+    Vector2 GetRenderPosition() {
+        return renderPosition;
+    }
+
+    // Overrides the interpolated position until the next InterpolatePosition,
+    // used to draw into off-screen targets
+    void SetRenderPosition(Vector2 position) {
+        renderPosition = position;
+    }
+
+    void SavePreviousPosition() {
+        previousPosition = position;
+    }
+
+    void InterpolatePosition(float alpha) {
+        renderPosition = previousPosition + (position - previousPosition) * alpha;
     }
 
     float GetZoomOnScreen(float scale) {
@@ -48,11 +76,27 @@ class Camera {
         return this->zoom;
     }
 
+    void SaveState(SnapshotWriter &w) const {
+        w.Write(position);
+        w.Write(previousPosition);
+        w.Write(zoom);
+    }
+
+    void LoadState(SnapshotReader &r) {
+        r.Read(position);
+        r.Read(previousPosition);
+        r.Read(zoom);
+        renderPosition = position;
+    }
+
     protected:
     float zoom = 1;
     Vector2 position;
+    Vector2 previousPosition;
+    Vector2 renderPosition;
 
 private:
+    friend class EngineContext;
     Camera() {};
     Vector2 screen;
 };
\ No newline at end of file
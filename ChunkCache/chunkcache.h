@@ -0,0 +1,386 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_render.h>
+#include "../Entity/entity.h"
+#include "../Camera/camera.h"
+#include "../Screen/screen.h"
+#include "../RenderQueue/renderqueue.h"
+#include "../SpriteBatch/spritebatch.h"
+
+struct ChunkCacheStats_t {
+    int chunks = 0;             // with at least one entity
+    int textures = 0;           // chunks holding a rendered texture
+    int cachedEntities = 0;
+    int chunksDrawn = 0;        // cached textures queued this frame
+    int chunksRendered = 0;     // (re)rendered this frame
+    int fallbackEntities = 0;   // drawn one by one because their chunk wasn't ready
+    double renderMs = 0.0;
+};
+
+// Static drawables grouped into fixed-size world chunks, one set per render
+// layer, each chunk pre-rendered into a target texture. A frame then queues
+// a few chunk textures under the layer's other items instead of every tile.
+// A chunk is rendered again when an entity in it is added, removed or
+// invalidated, or when the zoom changes. Only a few are rendered per frame,
+// the rest draw their entities directly until their turn comes.
+//
+// Cached entities are drawn beneath the dynamic ones of their layer, keep
+// foreground decoration on a higher layer. Y-sorted layers aren't cached.
+class ChunkCache {
+    private:
+    struct Chunk_t {
+        int x = 0, y = 0;
+        uint8_t layer = 0;
+        std::vector<Entity*> entities;  // the RenderQueue sorts them when rendering
+        SDL_Texture *texture = nullptr;
+        int pixels = 0;                 // texture width and height
+        float zoom = 0.0f;              // zoom it was rendered at
+        bool dirty = true;
+        uint64_t lastUsed = 0;
+    };
+
+    // Chunk range an entity was filed under, and the bounds and tint it
+    // had then
+    struct Membership_t {
+        int minX, minY, maxX, maxY;
+        uint8_t layer;
+        Vector2 position, half;
+        Color color;
+    };
+
+    float chunkSize = 256.0f;
+    int maxTexturePixels = 2048;    // larger chunks (zoomed in a lot) aren't cached
+    int renderBudget = 4;           // chunk renders per frame
+    size_t maxTextures = 96;
+    bool enabled = true;
+
+    std::unordered_map<uint64_t, Chunk_t> chunks;
+    std::unordered_map<Entity*, Membership_t> members;
+    int layerChunks[256] = {};      // chunks per layer, Draw only looks up layers in use
+    uint32_t sortGeneration = 0;
+    uint64_t frame = 0;
+
+    std::vector<Chunk_t*> visible;
+    std::unordered_set<Entity*> fallbackSeen;
+    ChunkCacheStats_t stats;
+
+    static uint64_t Key(uint8_t layer, int x, int y) {
+        return ((uint64_t)layer << 48) | ((uint64_t)((uint32_t)x & 0xffffff) << 24) | ((uint32_t)y & 0xffffff);
+    }
+
+    int ChunkOf(float v) const {
+        return (int)std::floor(v / chunkSize);
+    }
+
+    bool IsCacheable(Entity *e) const {
+        return e->IsDrawCacheable() && RenderQueue::GetInstance().GetLayerSort(e->GetRenderLayer()) != LayerSort_t::Y;
+    }
+
+    void FreeTexture(Chunk_t &chunk) {
+        if (chunk.texture)
+            SDL_DestroyTexture(chunk.texture);
+        chunk.texture = nullptr;
+        chunk.dirty = true;
+    }
+
+    Membership_t MembershipOf(Entity *e) const {
+        Vector2 pos = e->GetPosition();
+        Vector2 half = e->GetDrawSize() * (e->GetScale() * 0.5f);
+        half = {std::fabs(half.x), std::fabs(half.y)};
+        return {ChunkOf(pos.x - half.x), ChunkOf(pos.y - half.y),
+                ChunkOf(pos.x + half.x), ChunkOf(pos.y + half.y), e->GetRenderLayer(), pos, half, e->GetColor()};
+    }
+
+    void File(Entity *e) {
+        if (!IsCacheable(e))
+            return;
+        Membership_t m = MembershipOf(e);
+        for (int x = m.minX; x <= m.maxX; x++) {
+            for (int y = m.minY; y <= m.maxY; y++) {
+                auto [it, added] = chunks.try_emplace(Key(m.layer, x, y));
+                Chunk_t &chunk = it->second;
+                if (added)
+                    layerChunks[m.layer]++;
+                chunk.x = x;
+                chunk.y = y;
+                chunk.layer = m.layer;
+                chunk.entities.push_back(e);
+                chunk.dirty = true;
+            }
+        }
+        members[e] = m;
+        e->drawCached = true;
+    }
+
+    void Unfile(Entity *e) {
+        auto it = members.find(e);
+        if (it == members.end())
+            return;
+        const Membership_t &m = it->second;
+        for (int x = m.minX; x <= m.maxX; x++) {
+            for (int y = m.minY; y <= m.maxY; y++) {
+                auto c = chunks.find(Key(m.layer, x, y));
+                if (c == chunks.end())
+                    continue;
+                Chunk_t &chunk = c->second;
+                chunk.entities.erase(std::find(chunk.entities.begin(), chunk.entities.end(), e));
+                chunk.dirty = true;
+                if (chunk.entities.empty()) {
+                    FreeTexture(chunk);
+                    chunks.erase(c);
+                    layerChunks[m.layer]--;
+                }
+            }
+        }
+        members.erase(it);
+        e->drawCached = false;
+    }
+
+    // Moves the camera so the chunk's corner lands on the target's origin
+    template <typename QueueFn>
+    void Render(Chunk_t &chunk, int pixels, float zoom, QueueFn &&queueEntity) {
+        SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
+        if (chunk.texture && chunk.pixels != pixels)
+            FreeTexture(chunk);
+        if (!chunk.texture) {
+            chunk.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, pixels, pixels);
+            if (!chunk.texture) {
+                SDL_Log("ChunkCache: couldn't create a %dx%d target: %s", pixels, pixels, SDL_GetError());
+                return;
+            }
+            SDL_SetTextureBlendMode(chunk.texture, SDL_BLENDMODE_BLEND);
+            SDL_SetTextureScaleMode(chunk.texture, SDL_SCALEMODE_NEAREST);
+            chunk.pixels = pixels;
+        }
+
+        Camera &camera = Camera::GetInstance();
+        Vector2 savedPosition = camera.GetRenderPosition();
+        Vector2 origin = {chunk.x * chunkSize, chunk.y * chunkSize};
+        camera.SetRenderPosition(origin + Screen::GetInstance().GetSize() / (2.0f * zoom));
+
+        SDL_SetRenderTarget(renderer, chunk.texture);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+
+        RenderQueue &queue = RenderQueue::GetInstance();
+        SpriteBatch &batch = SpriteBatch::GetInstance();
+        queue.Begin();
+        for (Entity *e : chunk.entities)
+            queueEntity(queue, e);
+        batch.Begin();
+        queue.Submit(batch);
+        batch.End();
+
+        SDL_SetRenderTarget(renderer, nullptr);
+        camera.SetRenderPosition(savedPosition);
+
+        chunk.zoom = zoom;
+        chunk.dirty = false;
+        stats.chunksRendered++;
+    }
+
+    // Least recently drawn textures go first, this frame's are kept
+    void Evict() {
+        size_t textures = 0;
+        for (auto &c : chunks)
+            textures += c.second.texture ? 1 : 0;
+        while (textures > maxTextures) {
+            Chunk_t *oldest = nullptr;
+            for (auto &c : chunks) {
+                if (c.second.texture && c.second.lastUsed != frame && (!oldest || c.second.lastUsed < oldest->lastUsed))
+                    oldest = &c.second;
+            }
+            if (!oldest)
+                break;
+            FreeTexture(*oldest);
+            textures--;
+        }
+        stats.textures = (int)textures;
+    }
+
+    public:
+    ~ChunkCache() {
+        Clear();
+    }
+
+    void Insert(Entity *e) {
+        if (enabled)
+            File(e);
+    }
+
+    void Erase(Entity *e) {
+        Unfile(e);
+    }
+
+    // After a cached entity changed position, size, look or layer
+    void Invalidate(Entity *e) {
+        Unfile(e);
+        if (enabled)
+            File(e);
+    }
+
+    void Clear() {
+        for (auto &c : chunks) {
+            FreeTexture(c.second);
+            for (Entity *e : c.second.entities)
+                e->drawCached = false;
+        }
+        chunks.clear();
+        members.clear();
+        std::fill(std::begin(layerChunks), std::end(layerChunks), 0);
+    }
+
+    // Re-files entities whose bounds, tint, layer or cacheability changed,
+    // for snapshot restores. Chunks of unchanged entities keep their textures.
+    void Refresh(const std::vector<Entity*> &entities) {
+        for (Entity *e : entities) {
+            bool wanted = enabled && IsCacheable(e);
+            auto it = members.find(e);
+            if (it == members.end()) {
+                if (wanted)
+                    File(e);
+                continue;
+            }
+            Membership_t m = MembershipOf(e);
+            const Membership_t &old = it->second;
+            if (wanted && m.layer == old.layer && m.position.x == old.position.x && m.position.y == old.position.y &&
+                m.half.x == old.half.x && m.half.y == old.half.y && m.color.r == old.color.r &&
+                m.color.g == old.color.g && m.color.b == old.color.b && m.color.a == old.color.a)
+                continue;
+            Unfile(e);
+            if (wanted)
+                File(e);
+        }
+    }
+
+    // Files every entity again, for setting changes
+    void Rebuild(const std::vector<Entity*> &entities) {
+        Clear();
+        sortGeneration = RenderQueue::GetInstance().GetSortGeneration();
+        if (!enabled)
+            return;
+        for (Entity *e : entities)
+            File(e);
+    }
+
+    // Renders what the view needs (within the budget) and queues the chunk
+    // textures. Entities of chunks that aren't ready go through
+    // queueEntity(queue, entity) like uncached ones.
+    template <typename QueueFn>
+    void Draw(const std::vector<Entity*> &entities, Vector2 viewMin, Vector2 viewMax, QueueFn &&queueEntity) {
+        Uint64 start = SDL_GetTicksNS();
+        frame++;
+        stats.chunksDrawn = stats.chunksRendered = stats.fallbackEntities = 0;
+
+        RenderQueue &queue = RenderQueue::GetInstance();
+        if (queue.GetSortGeneration() != sortGeneration)
+            Rebuild(entities);
+
+        float zoom = Camera::GetInstance().GetZoom();
+        int pixels = (int)std::ceil(chunkSize * zoom);
+        bool canCache = Screen::GetInstance().GetRenderer() && pixels > 0 && pixels <= maxTexturePixels;
+
+        // Visible chunks of every layer in use, rendered before the frame's
+        // queue is started since rendering reuses it
+        visible.clear();
+        int minX = ChunkOf(viewMin.x), maxX = ChunkOf(viewMax.x);
+        int minY = ChunkOf(viewMin.y), maxY = ChunkOf(viewMax.y);
+        if ((int64_t)(maxX - minX + 1) * (maxY - minY + 1) > (int64_t)chunks.size()) {
+            for (auto &c : chunks) {
+                Chunk_t &chunk = c.second;
+                if (chunk.x >= minX && chunk.x <= maxX && chunk.y >= minY && chunk.y <= maxY)
+                    visible.push_back(&chunk);
+            }
+        } else {
+            for (int layer = 0; layer < 256; layer++) {
+                if (layerChunks[layer] == 0)
+                    continue;
+                for (int x = minX; x <= maxX; x++) {
+                    for (int y = minY; y <= maxY; y++) {
+                        auto it = chunks.find(Key((uint8_t)layer, x, y));
+                        if (it != chunks.end())
+                            visible.push_back(&it->second);
+                    }
+                }
+            }
+        }
+
+        int budget = renderBudget;
+        for (Chunk_t *chunk : visible) {
+            bool stale = chunk->dirty || chunk->zoom != zoom || !chunk->texture;
+            if (canCache && stale && budget > 0) {
+                Render(*chunk, pixels, zoom, queueEntity);
+                budget--;
+            }
+        }
+        stats.renderMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+
+        // The frame's queue is open from here on
+        queue.Begin();
+        Camera &camera = Camera::GetInstance();
+        fallbackSeen.clear();
+        for (Chunk_t *chunk : visible) {
+            chunk->lastUsed = frame;
+            bool ready = canCache && chunk->texture && !chunk->dirty && chunk->zoom == zoom;
+            if (ready) {
+                // The texture is rounded up to whole pixels, only the chunk's
+                // exact extent is drawn, at the unrounded corner, so the
+                // chunk lands where its sprites would have been drawn
+                Vector2 corner = camera.WorldToScreen({chunk->x * chunkSize, chunk->y * chunkSize});
+                float extent = chunkSize * zoom;
+                SDL_FRect src = {0.0f, 0.0f, extent, extent};
+                SDL_FRect dst = {corner.x, corner.y, extent, extent};
+                queue.SetBackgroundOwner(chunk, chunk->layer);
+                queue.AddSprite(chunk->texture, src, dst);
+                stats.chunksDrawn++;
+            } else {
+                for (Entity *e : chunk->entities) {
+                    if (fallbackSeen.insert(e).second) {
+                        queueEntity(queue, e);
+                        stats.fallbackEntities++;
+                    }
+                }
+            }
+        }
+
+        Evict();
+        stats.chunks = (int)chunks.size();
+        stats.cachedEntities = (int)members.size();
+    }
+
+    // Turning it off hands every entity back to the normal draw path
+    void SetEnabled(bool enable, const std::vector<Entity*> &entities) {
+        enabled = enable;
+        Rebuild(entities);
+    }
+
+    bool IsEnabled() const {
+        return enabled;
+    }
+
+    void SetChunkSize(float size, const std::vector<Entity*> &entities) {
+        if (size <= 0.0f)
+            return;
+        chunkSize = size;
+        Rebuild(entities);
+    }
+
+    float GetChunkSize() const {
+        return chunkSize;
+    }
+
+    void SetRenderBudget(int chunksPerFrame) {
+        renderBudget = std::max(chunksPerFrame, 1);
+    }
+
+    const ChunkCacheStats_t& GetStats() const {
+        return stats;
+    }
+};
@@ -5,6 +5,7 @@
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include "../Engine/enginecontext.h"
 
 enum class CollisionSide_t {
     None,
@@ -40,35 +41,42 @@ struct TraceResult_t {
 class CollisionSystem {
     CollisionSystem(const CollisionSystem&) = delete;
     CollisionSystem& operator=(const CollisionSystem&) = delete;
+    friend class EngineContext;
     CollisionSystem() : cellSize(100.0f) {}
 
     // Spatial hash grid
     float cellSize;
-    std::unordered_map<int, std::vector<Entity*>> spatialGrid;
+    std::unordered_map<uint64_t, std::vector<Entity*>> spatialGrid;
+    // Cells in the order they were first filled, which follows the entity
+    // list. Pairs are visited in this order, never in hash map order, so the
+    // same world always resolves its collisions in the same order.
+    std::vector<uint64_t> occupiedCells;
+    double lastDetectMs = 0.0;
+
+    // The list the grid was built from and the cells each of its entities
+    // was filed in, lets RefreshSpatialGrid only move what changed cells
+    struct GridCells_t {
+        int minX, minY, maxX, maxY;
+        bool operator==(const GridCells_t &o) const {
+            return minX == o.minX && minY == o.minY && maxX == o.maxX && maxY == o.maxY;
+        }
+    };
+    std::vector<Entity*> gridEntities;
+    std::vector<GridCells_t> gridCells;
 
-    // Hash function for grid cells
-    int HashCell(int x, int y) const {
-        // Use prime numbers for better distribution
-        return (x * 73856093) ^ (y * 19349663);
+    // Both coordinates packed into the key, distinct cells never share one
+    uint64_t HashCell(int x, int y) const {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
     }
 
-    // Get all cell keys an entity occupies
-    std::vector<int> GetCellKeys(Entity* e) {
-        Vector2 minPos, maxPos;
-        GetWorldAABB(e, minPos, maxPos);
-
-        int minX = (int)std::floor(minPos.x / cellSize);
-        int maxX = (int)std::floor(maxPos.x / cellSize);
-        int minY = (int)std::floor(minPos.y / cellSize);
-        int maxY = (int)std::floor(maxPos.y / cellSize);
-
-        std::vector<int> keys;
-        for (int x = minX; x <= maxX; ++x) {
-            for (int y = minY; y <= maxY; ++y) {
-                keys.push_back(HashCell(x, y));
-            }
+    // Candidates from the cells a query touches, each once and in the order
+    // the cells were walked (iterating a pointer set would differ per run)
+    static void AddCandidates(const std::vector<Entity*> &cell, Entity *ignore,
+                              std::vector<Entity*> &candidates, std::unordered_set<Entity*> &seen) {
+        for (Entity* e : cell) {
+            if (e != ignore && seen.insert(e).second)
+                candidates.push_back(e);
         }
-        return keys;
     }
 
     CollisionSide_t Opposite(CollisionSide_t side) {
@@ -83,8 +91,7 @@ class CollisionSystem {
 
 public:
     static CollisionSystem& GetInstance() {
-        static CollisionSystem instance;
-        return instance;
+        return EngineContext::Current().Get<CollisionSystem>();
     }
 
     // Set the cell size (should match typical entity size or slightly larger)
@@ -96,6 +103,11 @@ public:
         return cellSize;
     }
 
+    // Grid cell coordinate of a world coordinate, same cells the grid uses
+    int CellOf(float v) const {
+        return (int)std::floor(v / cellSize);
+    }
+
     void GetWorldAABB(Entity* e, Vector2 &minOut, Vector2 &maxOut) {
         Vector2 pos = e->GetPosition();
         Vector2 size = e->GetSize();
@@ -134,39 +146,110 @@ public:
         }
     }
 
+    GridCells_t CellsOf(Entity *e) {
+        Vector2 minPos, maxPos;
+        GetWorldAABB(e, minPos, maxPos);
+        return {CellOf(minPos.x), CellOf(minPos.y), CellOf(maxPos.x), CellOf(maxPos.y)};
+    }
+
+    void FileInCells(Entity *e, const GridCells_t &c) {
+        for (int x = c.minX; x <= c.maxX; ++x) {
+            for (int y = c.minY; y <= c.maxY; ++y) {
+                uint64_t key = HashCell(x, y);
+                auto [cell, added] = spatialGrid.try_emplace(key);
+                if (added)
+                    occupiedCells.push_back(key);
+                cell->second.push_back(e);
+            }
+        }
+    }
+
+    // Emptied cells stay in the grid and occupiedCells until the next full build
+    void UnfileFromCells(Entity *e, const GridCells_t &c) {
+        for (int x = c.minX; x <= c.maxX; ++x) {
+            for (int y = c.minY; y <= c.maxY; ++y) {
+                std::vector<Entity*> &cell = spatialGrid[HashCell(x, y)];
+                cell.erase(std::find(cell.begin(), cell.end(), e));
+            }
+        }
+    }
+
     // Build spatial grid from entities
     void BuildSpatialGrid(const std::vector<Entity*>& entities) {
         spatialGrid.clear();
-        
-        for (Entity* e : entities) {
-            std::vector<int> keys = GetCellKeys(e);
-            for (int key : keys) {
-                spatialGrid[key].push_back(e);
+        occupiedCells.clear();
+        gridEntities.assign(entities.begin(), entities.end());
+        gridCells.resize(entities.size());
+
+        for (size_t i = 0; i < entities.size(); i++) {
+            Entity *e = entities[i];
+            gridCells[i] = CellsOf(e);
+            for (int x = gridCells[i].minX; x <= gridCells[i].maxX; ++x) {
+                for (int y = gridCells[i].minY; y <= gridCells[i].maxY; ++y) {
+                    uint64_t key = HashCell(x, y);
+                    std::vector<Entity*> &cell = spatialGrid[key];
+                    if (cell.empty())
+                        occupiedCells.push_back(key);
+                    cell.push_back(e);
+                }
             }
         }
     }
 
+    // Brings the grid up to date for the same list it was last built from,
+    // only entities that changed cells are refiled. Any other list, or the
+    // same one in a different order, gets a full build. A refiled entity
+    // goes to the back of its new cells, so pairs come out in an order that
+    // still only depends on the world and the last full build.
+    void RefreshSpatialGrid(const std::vector<Entity*>& entities) {
+        if (entities != gridEntities) {
+            BuildSpatialGrid(entities);
+            return;
+        }
+        for (size_t i = 0; i < entities.size(); i++) {
+            GridCells_t cells = CellsOf(entities[i]);
+            if (cells == gridCells[i])
+                continue;
+            UnfileFromCells(entities[i], gridCells[i]);
+            FileInCells(entities[i], cells);
+            gridCells[i] = cells;
+        }
+    }
+
     // Optimized collision detection using spatial hash
     std::vector<CollisionInfo_t> DetectCollisions(const std::vector<Entity*>& entities) {
-        // Build spatial grid
-        BuildSpatialGrid(entities);
+        Uint64 start = SDL_GetTicksNS();
+
+        // The grid from the start of the step, moved entities refiled
+        RefreshSpatialGrid(entities);
 
         std::vector<CollisionInfo_t> out;
-        std::unordered_map<Entity*, std::unordered_map<Entity*, bool>> checked;
 
         // Check collisions only within same cells
-        for (auto& [key, cellEntities] : spatialGrid) {
+        for (uint64_t key : occupiedCells) {
+            const std::vector<Entity*> &cellEntities = spatialGrid.find(key)->second;
+            int cellX = (int)(int32_t)(uint32_t)(key >> 32);
+            int cellY = (int)(int32_t)(uint32_t)key;
+
             for (size_t i = 0; i < cellEntities.size(); ++i) {
                 for (size_t j = i + 1; j < cellEntities.size(); ++j) {
                     Entity* A = cellEntities[i];
                     Entity* B = cellEntities[j];
 
-                    // Avoid duplicate checks (entities can be in multiple cells)
-                    if (checked[A][B] || checked[B][A])
+                    // Attached entities follow their parent, pushing them apart would fight the hierarchy
+                    if (A->GetParent() == B || B->GetParent() == A)
+                        continue;
+
+                    Vector2 minA, maxA, minB, maxB;
+                    GetWorldAABB(A, minA, maxA);
+                    GetWorldAABB(B, minB, maxB);
+
+                    // Entities share several cells, a pair is only reported
+                    // from the cell holding the top-left corner of the overlap
+                    if (CellOf(std::max(minA.x, minB.x)) != cellX || CellOf(std::max(minA.y, minB.y)) != cellY)
                         continue;
-                    checked[A][B] = true;
 
-                    if (Intersect(A, B)) {
+                    if (minA.x < maxB.x && maxA.x > minB.x && minA.y < maxB.y && maxA.y > minB.y) {
                         Vector2 pen = GetPenetrationDepth(A, B);
                         CollisionSide_t sideA = DetermineCollisionSide(A, B, pen);
                         CollisionSide_t sideB = Opposite(sideA);
@@ -181,9 +264,16 @@ public:
                 }
             }
         }
+
+        lastDetectMs = (double)(SDL_GetTicksNS() - start) / 1e6;
         return out;
     }
 
+    // Time spent in the last DetectCollisions call (grid build + pair tests)
+    double GetLastDetectMs() const {
+        return lastDetectMs;
+    }
+
     void ResolveCollisions(std::vector<CollisionInfo_t>& collisions) {
         for (auto& c : collisions) {
             if (c.staticA && c.staticB)
@@ -254,11 +344,13 @@ public:
     }
 
     // TraceLine: Cast a ray from start to end, return first hit
+    // (read-only on the grid, safe to call from parallel entity updates)
     TraceResult_t TraceLine(Vector2 start, Vector2 end, Entity* ignore = nullptr) {
         TraceResult_t result;
         
         // Collect candidate entities along the line path
-        std::unordered_set<Entity*> candidates;
+        std::vector<Entity*> candidates;
+        std::unordered_set<Entity*> seen;
         
         Vector2 dir = { end.x - start.x, end.y - start.y };
         float lineLength = std::sqrt(dir.x * dir.x + dir.y * dir.y);
@@ -278,15 +370,9 @@ public:
             
             int cellX = (int)std::floor(samplePos.x / cellSize);
             int cellY = (int)std::floor(samplePos.y / cellSize);
-            int key = HashCell(cellX, cellY);
-            
-            if (spatialGrid.count(key)) {
-                for (Entity* e : spatialGrid[key]) {
-                    if (e != ignore) {
-                        candidates.insert(e);
-                    }
-                }
-            }
+            auto cell = spatialGrid.find(HashCell(cellX, cellY));
+            if (cell != spatialGrid.end())
+                AddCandidates(cell->second, ignore, candidates, seen);
         }
         
         // Test line against each candidate AABB
@@ -377,6 +463,7 @@ public:
     }
 
     // TraceLine with explicit entity list (useful if grid isn't built yet)
+    // Rebuilds the grid, never call this from a parallel update
     TraceResult_t TraceLine(Vector2 start, Vector2 end, 
                          const std::vector<Entity*>& entities, 
                          Entity* ignore = nullptr) {
@@ -389,7 +476,8 @@ public:
         TraceResult_t result;
         
         // Collect candidate entities along the swept path
-        std::unordered_set<Entity*> candidates;
+        std::vector<Entity*> candidates;
+        std::unordered_set<Entity*> seen;
         
         Vector2 dir = { end.x - start.x, end.y - start.y };
         float sweepLength = std::sqrt(dir.x * dir.x + dir.y * dir.y);
@@ -418,14 +506,9 @@ public:
         
         for (int x = minCellX; x <= maxCellX; ++x) {
             for (int y = minCellY; y <= maxCellY; ++y) {
-                int key = HashCell(x, y);
-                if (spatialGrid.count(key)) {
-                    for (Entity* e : spatialGrid[key]) {
-                        if (e != ignore) {
-                            candidates.insert(e);
-                        }
-                    }
-                }
+                auto cell = spatialGrid.find(HashCell(x, y));
+                if (cell != spatialGrid.end())
+                    AddCandidates(cell->second, ignore, candidates, seen);
             }
         }
         
@@ -533,6 +616,7 @@ public:
     }
 
     // TraceHull with explicit entity list (useful if grid isn't built yet)
+    // Rebuilds the grid, never call this from a parallel update
     TraceResult_t TraceHull(Vector2 start, Vector2 end, Vector2 hullSize,
                         const std::vector<Entity*>& entities, 
                         Entity* ignore = nullptr)  {
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <algorithm>
+#include "../Entity/entity.h"
+
+enum class EntityCommandType_t {
+    Spawn,
+    Destroy
+};
+
+struct EntityCommand_t {
+    EntityCommandType_t type;
+    Entity* entity;
+};
+
+// Records spawn/destroy requests while the world is being iterated and hands
+// them back in one batch at a sync point. Recording is thread safe so worker
+// threads can queue commands during a parallel phase.
+class CommandBuffer {
+    private:
+    std::mutex mutex;
+
+    // Two buffers that are swapped on Take(), so commands queued while a batch
+    // is being applied go to the next batch. Capacity is kept between frames.
+    std::vector<EntityCommand_t> recording;
+    std::vector<EntityCommand_t> applying;
+
+    public:
+    CommandBuffer() {
+        recording.reserve(64);
+        applying.reserve(64);
+    }
+
+    void Spawn(Entity *entity) {
+        if (!entity)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        recording.push_back({EntityCommandType_t::Spawn, entity});
+    }
+
+    void Destroy(Entity *entity) {
+        if (!entity)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        recording.push_back({EntityCommandType_t::Destroy, entity});
+    }
+
+    bool IsEmpty() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return recording.empty();
+    }
+
+    // Returns the pending batch, ordered so every spawn comes before every
+    // destroy and duplicate destroys are dropped. The returned vector is only
+    // valid until the next call to Take().
+    std::vector<EntityCommand_t>& Take() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            applying.clear();
+            std::swap(recording, applying);
+        }
+
+        std::stable_partition(applying.begin(), applying.end(), [](const EntityCommand_t &c) {
+            return c.type == EntityCommandType_t::Spawn;
+        });
+
+        auto firstDestroy = std::find_if(applying.begin(), applying.end(), [](const EntityCommand_t &c) {
+            return c.type == EntityCommandType_t::Destroy;
+        });
+
+        std::sort(firstDestroy, applying.end(), [](const EntityCommand_t &a, const EntityCommand_t &b) {
+            return a.entity < b.entity;
+        });
+
+        applying.erase(std::unique(firstDestroy, applying.end(), [](const EntityCommand_t &a, const EntityCommand_t &b) {
+            return a.entity == b.entity;
+        }), applying.end());
+
+        return applying;
+    }
+
+    // Drops everything that was queued, deleting entities that were never spawned.
+    void Discard() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &c : recording) {
+            if (c.type == EntityCommandType_t::Spawn)
+                delete c.entity;
+        }
+        recording.clear();
+    }
+};
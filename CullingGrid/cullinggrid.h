@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "../Entity/entity.h"
+
+// Loose uniform grid for view queries. An entity sits in the one cell
+// holding its center, so moving it is a swap-remove and a push when it
+// crosses a cell. Anything drawn larger than a cell is kept in a separate
+// list that every query checks. Queries return candidates, callers test
+// the exact bounds.
+//
+// Only non-static entities (movers) are checked every frame. A static
+// entity is re-filed when told with Refile, or by a full Refresh.
+class CullingGrid {
+    private:
+    float cellSize = 128.0f;
+    std::unordered_map<uint64_t, std::vector<Entity*>> cells;
+    std::vector<Entity*> large;
+    std::vector<Entity*> movers;
+    uint32_t nextOrder = 1;
+
+    static uint64_t HashCell(int x, int y) {
+        return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+    }
+
+    int CellOf(float v) const {
+        return (int)std::floor(v / cellSize);
+    }
+
+    bool IsLarge(Entity *e) const {
+        Vector2 drawSize = e->GetDrawSize() * e->GetScale();
+        return std::max(std::fabs(drawSize.x), std::fabs(drawSize.y)) > cellSize;
+    }
+
+    uint64_t KeyOf(Entity *e) const {
+        Vector2 pos = e->GetPosition();
+        return HashCell(CellOf(pos.x), CellOf(pos.y));
+    }
+
+    std::vector<Entity*>& ListOf(Entity *e) {
+        return e->cullLarge ? large : cells[e->cullCell];
+    }
+
+    void Place(Entity *e) {
+        e->cullLarge = IsLarge(e);
+        e->cullCell = e->cullLarge ? 0 : KeyOf(e);
+        std::vector<Entity*> &list = ListOf(e);
+        e->cullSlot = (int)list.size();
+        list.push_back(e);
+    }
+
+    void Unplace(Entity *e) {
+        if (e->cullLarge) {
+            large[e->cullSlot] = large.back();
+            large[e->cullSlot]->cullSlot = e->cullSlot;
+            large.pop_back();
+        } else {
+            auto it = cells.find(e->cullCell);
+            std::vector<Entity*> &list = it->second;
+            list[e->cullSlot] = list.back();
+            list[e->cullSlot]->cullSlot = e->cullSlot;
+            list.pop_back();
+            if (list.empty())
+                cells.erase(it);
+        }
+        e->cullSlot = -1;
+    }
+
+    // Keeps e in movers exactly while it isn't static
+    void SyncMover(Entity *e) {
+        bool mover = !e->IsStatic();
+        if (mover == (e->cullMover >= 0))
+            return;
+        if (mover) {
+            e->cullMover = (int)movers.size();
+            movers.push_back(e);
+        } else {
+            movers[e->cullMover] = movers.back();
+            movers[e->cullMover]->cullMover = e->cullMover;
+            movers.pop_back();
+            e->cullMover = -1;
+        }
+    }
+
+    // Moves e if its cell (or large/small class) changed
+    void Follow(Entity *e) {
+        bool isLarge = IsLarge(e);
+        if (isLarge == e->cullLarge && (isLarge || KeyOf(e) == e->cullCell))
+            return;
+        Unplace(e);
+        Place(e);
+    }
+
+    public:
+    // Also hands out the draw order, which is insertion order like the
+    // World's buckets
+    void Insert(Entity *e) {
+        if (e->cullSlot >= 0)
+            return;
+        e->drawOrder = nextOrder++;
+        Place(e);
+        SyncMover(e);
+    }
+
+    void Erase(Entity *e) {
+        if (e->cullSlot < 0)
+            return;
+        Unplace(e);
+        if (e->cullMover >= 0) {
+            movers[e->cullMover] = movers.back();
+            movers[e->cullMover]->cullMover = e->cullMover;
+            movers.pop_back();
+            e->cullMover = -1;
+        }
+    }
+
+    // Follows the movers, once per rendered frame
+    void Update() {
+        for (Entity *e : movers)
+            Follow(e);
+    }
+
+    // After a static entity moved or resized, or an entity's static flag
+    // changed
+    void Refile(Entity *e) {
+        if (e->cullSlot < 0)
+            return;
+        SyncMover(e);
+        Follow(e);
+    }
+
+    // Checks every entity, for snapshot restores
+    void Refresh(const std::vector<Entity*> &entities) {
+        for (Entity *e : entities)
+            Refile(e);
+    }
+
+    void Clear() {
+        for (auto &cell : cells) {
+            for (Entity *e : cell.second)
+                e->cullSlot = -1;
+        }
+        for (Entity *e : large)
+            e->cullSlot = -1;
+        for (Entity *e : movers)
+            e->cullMover = -1;
+        cells.clear();
+        large.clear();
+        movers.clear();
+    }
+
+    // Entities that may overlap [minPos, maxPos], unordered
+    void Query(Vector2 minPos, Vector2 maxPos, std::vector<Entity*> &out) const {
+        // Small entities reach at most half a cell past their own
+        float reach = cellSize * 0.5f;
+        int minX = CellOf(minPos.x - reach), maxX = CellOf(maxPos.x + reach);
+        int minY = CellOf(minPos.y - reach), maxY = CellOf(maxPos.y + reach);
+        for (int x = minX; x <= maxX; x++) {
+            for (int y = minY; y <= maxY; y++) {
+                auto it = cells.find(HashCell(x, y));
+                if (it != cells.end())
+                    out.insert(out.end(), it->second.begin(), it->second.end());
+            }
+        }
+        out.insert(out.end(), large.begin(), large.end());
+    }
+
+    // Rebuilds with the new size
+    void SetCellSize(float size, const std::vector<Entity*> &entities) {
+        if (size <= 0.0f)
+            return;
+        Clear();
+        cellSize = size;
+        for (Entity *e : entities) {
+            Place(e);
+            SyncMover(e);
+        }
+    }
+
+    float GetCellSize() const {
+        return cellSize;
+    }
+
+    size_t GetLargeCount() const {
+        return large.size();
+    }
+
+    size_t GetMoverCount() const {
+        return movers.size();
+    }
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "../Engine/enginecontext.h"
+
+// Writes to shared state (the camera, global counters, ...) made from inside a
+// parallel update phase. They are collected while the phase runs and applied
+// on the main thread afterwards, ordered by the entity that made them so the
+// result doesn't depend on thread scheduling. Outside a phase Push() just
+// runs the write right away.
+class DeferredWrites {
+    private:
+    struct Write {
+        size_t order;
+        std::function<void()> apply;
+    };
+
+    std::vector<Write> writes;
+    std::mutex mutex;
+    bool deferring = false;
+
+    DeferredWrites(const DeferredWrites&) = delete;
+    DeferredWrites& operator=(const DeferredWrites&) = delete;
+
+    friend class EngineContext;
+    DeferredWrites() {}
+
+    static size_t& CurrentOrder() {
+        static thread_local size_t order = 0;
+        return order;
+    }
+
+    public:
+    static DeferredWrites& GetInstance() {
+        return EngineContext::Current().Get<DeferredWrites>();
+    }
+
+    // Tags writes pushed by the calling thread, usually the entity's index
+    static void SetOrder(size_t order) {
+        CurrentOrder() = order;
+    }
+
+    bool IsDeferring() const {
+        return deferring;
+    }
+
+    void Push(std::function<void()> apply) {
+        if (!deferring) {
+            apply();
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        writes.push_back({CurrentOrder(), std::move(apply)});
+    }
+
+    void Begin() {
+        deferring = true;
+    }
+
+    // Serial merge step
+    void Apply() {
+        deferring = false;
+
+        std::stable_sort(writes.begin(), writes.end(), [](const Write &a, const Write &b) {
+            return a.order < b.order;
+        });
+
+        for (auto &w : writes)
+            w.apply();
+        writes.clear();
+    }
+};
@@ -4,6 +4,7 @@
 #include <string>
 #include <fstream>
 #include "../EntityTemplate/entitytemplate.h"
+#include "../InputRecorder/inputrecorder.h"
 
 #include "../imgui.h"
 #include "../imgui_impl_sdl3.h"
@@ -30,6 +31,7 @@ private:
     float entColor[4] = {255, 255, 255, 255};
     float entScale = 1.0f;
     bool entStatic = false;
+    int entLayer = 0;
     
     // Sprite properties
     int selectedMaterial = 0;
@@ -42,11 +44,33 @@ private:
     
     // Selected entity for editing
     Entity* selectedEntity = nullptr;
+    char findName[64] = "";
+    char tagName[32] = "";
+    int findTag = -1;
+
+    // Tilemap painting, left button paints, right erases
+    bool paintTiles = false;
+    int paintTile = 1;
+    Tilemap* paintTarget = nullptr;
+
+    // Level files start with "level <version>". Version 1 files had no
+    // header and no render layer, they still load onto layer 0.
+    static constexpr int LEVEL_VERSION = 2;
+
+    // Quick save/restore of the whole simulation
+    Snapshot quickSnapshot;
+    double quickSnapshotMs = 0.0;
+
+    // Set while the render thread runs, the list it draws holds raw
+    // textures that an atlas rebuild would destroy
+    bool assetsLocked = false;
     
 public:
     WorldEditor(World& world) : world(world) {
         InitializeDefaultTemplates();
     }
+
+    void SetAssetsLocked(bool locked) { assetsLocked = locked; }
     
     void InitializeDefaultTemplates() {
         // Basic entity template
@@ -86,6 +110,15 @@ public:
         player.name = "Player";
         player.hasAnimations = true;
         templates.push_back(player);
+
+        // Tilemap template, 32x32 cells of 16 px
+        EntityTemplate tilemap;
+        tilemap.type = EntityType::TILEMAP;
+        tilemap.name = "Tilemap";
+        tilemap.size = {512, 512};
+        tilemap.srcRect = {0, 0, 16, 16};
+        tilemap.isStatic = true;
+        templates.push_back(tilemap);
         
         currentTemplate = templates[0];
     }
@@ -101,6 +134,7 @@ public:
         entColor[3] = tmpl.color.a;
         entScale = tmpl.scale;
         entStatic = tmpl.isStatic;
+        entLayer = tmpl.renderLayer;
         
         srcRegion[0] = tmpl.srcRect.x;
         srcRegion[1] = tmpl.srcRect.y;
@@ -117,6 +151,7 @@ public:
         tmpl.color = {entColor[0], entColor[1], entColor[2], entColor[3]};
         tmpl.scale = entScale;
         tmpl.isStatic = entStatic;
+        tmpl.renderLayer = entLayer;
         
         // Sprite properties
         auto materials = MaterialManager::GetInstance().GetMaterialNames();
@@ -130,7 +165,7 @@ public:
         return tmpl;
     }
     
-    void SpawnEntity(const EntityTemplate& tmpl) {
+    Entity* SpawnEntity(const EntityTemplate& tmpl) {
         Entity* entity = tmpl.Spawn(world);
         if (entity) {
             world.AddEntity(entity);
@@ -138,11 +173,49 @@ public:
                 SDL_Log("Player spawned successfully");
             }
         }
+        return entity;
+    }
+
+    // Topmost tilemap with a cell under the position
+    Tilemap* FindTilemapAt(Vector2 worldPos, int &x, int &y) {
+        Tilemap* found = nullptr;
+        int foundX = 0, foundY = 0;
+        for (Tilemap* tilemap : world.Query<Tilemap>()) {
+            int tx, ty;
+            if (!tilemap->WorldToTile(worldPos, tx, ty))
+                continue;
+            if (!found || tilemap->GetRenderLayer() >= found->GetRenderLayer()) {
+                found = tilemap;
+                foundX = tx;
+                foundY = ty;
+            }
+        }
+        x = foundX;
+        y = foundY;
+        return found;
+    }
+
+    void PaintTiles(Vector2 worldPos) {
+        bool paint = ImGui::IsMouseDown(0), erase = ImGui::IsMouseDown(1);
+        if ((!paint && !erase) || ImGui::GetIO().WantCaptureMouse)
+            return;
+        int x, y;
+        Tilemap* tilemap = FindTilemapAt(worldPos, x, y);
+        if (!tilemap)
+            return;
+        tilemap->SetTile(x, y, erase ? 0 : (uint16_t)paintTile);
+        paintTarget = tilemap;
     }
     
     void Update(double dt, SDL_Renderer* renderer) {
         Camera& camera = Camera::GetInstance();
         
+        // Painting takes the mouse over from spawning
+        if (paintTiles) {
+            PaintTiles(camera.ScreenToWorld(GetMousePosition()));
+            return;
+        }
+
         // Mouse spawn mode
         if (mouseSpawnMode && ImGui::IsMouseClicked(0) && !ImGui::GetIO().WantCaptureMouse) {
             Vector2 mousePos = camera.ScreenToWorld(GetMousePosition());
@@ -190,7 +263,7 @@ public:
             }
             
             // Entity type selector
-            const char* typeNames[] = {"Entity", "Sprite", "Tiled Sprite", "Animated", "Player"};
+            const char* typeNames[] = {"Entity", "Sprite", "Tiled Sprite", "Animated", "Player", "Tilemap", "Agent"};
             int currentType = (int)currentTemplate.type;
             if (ImGui::Combo("Entity Type", &currentType, typeNames, IM_ARRAYSIZE(typeNames))) {
                 currentTemplate.type = (EntityType)currentType;
@@ -219,9 +292,10 @@ public:
             }
             
             ImGui::Checkbox("Static", &entStatic);
+            ImGui::SliderInt("Render Layer", &entLayer, 0, 255);
             
             // Sprite-specific properties
-            if (currentTemplate.type >= EntityType::SPRITE_ENTITY) {
+            if (currentTemplate.type >= EntityType::SPRITE_ENTITY && currentTemplate.type <= EntityType::TILEMAP) {
                 ImGui::Separator();
                 ImGui::Text("Sprite Properties");
                 
@@ -237,9 +311,13 @@ public:
                 }
                 
                 ImGui::SliderFloat4("Source Region", srcRegion, 0, 512, "%.0f");
-                ImGui::Checkbox("Flip X", &flipX);
-                ImGui::SameLine();
-                ImGui::Checkbox("Flip Y", &flipY);
+                if (currentTemplate.type == EntityType::TILEMAP) {
+                    ImGui::Text("Tile size is the region width, size / tile size cells");
+                } else {
+                    ImGui::Checkbox("Flip X", &flipX);
+                    ImGui::SameLine();
+                    ImGui::Checkbox("Flip Y", &flipY);
+                }
             }
             
             ImGui::Separator();
@@ -287,6 +365,9 @@ public:
                 ImGui::InputText("Path", pathBuf, 256);
                 ImGui::InputText("Name", nameBuf, 64);
                 
+                if (assetsLocked)
+                    ImGui::Text("Stop the render thread to change materials");
+                ImGui::BeginDisabled(assetsLocked);
                 if (ImGui::Button("Load Material")) {
                     Material* mat = MaterialManager::GetInstance().LoadMaterial(nameBuf, pathBuf);
                     if (mat) {
@@ -296,6 +377,23 @@ public:
                     }
                 }
                 
+                MaterialManager &manager = MaterialManager::GetInstance();
+                bool atlas = manager.IsAtlasEnabled();
+                if (ImGui::Checkbox("Texture Atlas", &atlas)) {
+                    if (atlas)
+                        manager.EnableAtlas();
+                    else
+                        manager.DisableAtlas();
+                }
+                ImGui::EndDisabled();
+                if (atlas) {
+                    const TextureAtlas &pages = manager.GetAtlas();
+                    ImGui::Text("%zu pages, %.1f%% occupied, %d not packed", pages.GetPages().size(),
+                                pages.GetOccupancy() * 100.0, pages.GetUnpackedCount());
+                    for (const AtlasPage_t &page : pages.GetPages())
+                        ImGui::BulletText("%dx%d, %d images", page.size, page.size, page.images);
+                }
+
                 ImGui::Text("Loaded Materials:");
                 auto materials = MaterialManager::GetInstance().GetMaterialNames();
                 for (const auto& name : materials) {
@@ -303,6 +401,30 @@ public:
                 }
             }
             
+            // Tile painting on existing tilemaps
+            if (ImGui::CollapsingHeader("Tilemap Painting")) {
+                ImGui::Checkbox("Paint Tiles", &paintTiles);
+                ImGui::InputInt("Tile", &paintTile);
+                paintTile = std::clamp(paintTile, 1, 0xffff);
+                ImGui::Text("Left button paints, right button erases");
+
+                // The target may have been destroyed since it was painted
+                auto tilemaps = world.Query<Tilemap>();
+                if (paintTarget && std::find(tilemaps.begin(), tilemaps.end(), paintTarget) == tilemaps.end())
+                    paintTarget = nullptr;
+
+                if (paintTarget) {
+                    const TilemapStats_t& tileStats = paintTarget->GetStats();
+                    ImGui::Text("%dx%d tiles, %d chunks drawn, %d rebuilt, %d quads", paintTarget->GetColumns(),
+                                paintTarget->GetRows(), tileStats.chunksDrawn, tileStats.chunksRebuilt, tileStats.quads);
+                    if (ImGui::Button("Fill", ImVec2(100, 0)))
+                        paintTarget->Fill((uint16_t)paintTile);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Clear", ImVec2(100, 0)))
+                        paintTarget->Fill(0);
+                }
+            }
+
             // Level save/load
             if (ImGui::CollapsingHeader("Level Management")) {
                 static char levelName[64] = "level1.txt";
@@ -316,6 +438,179 @@ public:
                     LoadLevel(levelName);
                 }
             }
+
+            // Instant retry
+            if (ImGui::CollapsingHeader("Snapshots")) {
+                if (ImGui::Button("Save State", ImVec2(150, 0))) {
+                    Uint64 start = SDL_GetTicksNS();
+                    world.SaveSnapshot(quickSnapshot);
+                    quickSnapshotMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Restore State", ImVec2(150, 0)) && !quickSnapshot.data.empty()) {
+                    Uint64 start = SDL_GetTicksNS();
+                    world.RestoreSnapshot(quickSnapshot);
+                    quickSnapshotMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+                }
+                ImGui::Text("%zu bytes, last op %.3f ms", quickSnapshot.data.size(), quickSnapshotMs);
+            }
+
+            // Play session capture, replay it with --replay=<file>
+            if (ImGui::CollapsingHeader("Input Recording")) {
+                static char recordingName[64] = "session.rec";
+                InputRecorder &recorder = InputRecorder::GetInstance();
+                bool recording = recorder.GetMode() == InputRecorder::Mode::RECORDING;
+                ImGui::InputText("Recording", recordingName, 64);
+
+                if (!recording && ImGui::Button("Start Recording", ImVec2(150, 0))) {
+                    recorder.StartRecording(world);
+                }
+                if (recording && ImGui::Button("Stop And Save", ImVec2(150, 0))) {
+                    recorder.StopRecording();
+                    recorder.Save(recordingName);
+                }
+                ImGui::Text("%zu frames%s", recorder.GetFrameCount(), recording ? ", recording" : "");
+            }
+
+            // Update/draw timings
+            if (ImGui::CollapsingHeader("World Stats")) {
+                bool staticDispatch = world.IsStaticDispatch();
+                if (ImGui::Checkbox("Static Dispatch", &staticDispatch)) {
+                    world.SetStaticDispatch(staticDispatch);
+                }
+                SpriteBatch &batch = SpriteBatch::GetInstance();
+                bool batching = batch.IsEnabled();
+                if (ImGui::Checkbox("Sprite Batching", &batching)) {
+                    batch.SetEnabled(batching);
+                }
+                ImGui::Text("Entities: %zu", world.GetEntities().size());
+                ImGui::Text("Process: %.3f ms", world.GetStats().processMs);
+                ImGui::Text("Draw: %.3f ms", world.GetStats().drawMs);
+                ImGui::Text("Draw calls: %d, %d vertices, %d quads, %d texture switches", batch.GetStats().drawCalls,
+                            batch.GetStats().vertices, batch.GetStats().quads, batch.GetStats().textureSwitches);
+
+                bool viewCulling = world.IsViewCulling();
+                float cullMargin = world.GetCullMargin();
+                if (ImGui::Checkbox("View Culling", &viewCulling) | ImGui::SliderFloat("Cull Margin", &cullMargin, 0.0f, 256.0f)) {
+                    world.SetViewCulling(viewCulling, cullMargin);
+                }
+                ImGui::Text("Drawn: %d, culled: %d (%.3f ms)", world.GetStats().drawnEntities,
+                            world.GetStats().culledEntities, world.GetStats().cullMs);
+
+                bool drawCache = world.IsDrawCache();
+                if (ImGui::Checkbox("Static Chunk Cache", &drawCache)) {
+                    world.SetDrawCache(drawCache);
+                }
+                const ChunkCacheStats_t &chunkStats = world.GetChunkCache().GetStats();
+                ImGui::Text("Chunks: %d (%d textures), %d cached entities", chunkStats.chunks, chunkStats.textures,
+                            chunkStats.cachedEntities);
+                ImGui::Text("Chunk draws: %d, rendered: %d (%.3f ms), fallback entities: %d", chunkStats.chunksDrawn,
+                            chunkStats.chunksRendered, chunkStats.renderMs, chunkStats.fallbackEntities);
+
+                RenderQueue &queue = RenderQueue::GetInstance();
+                const char* sortNames[] = {"Submission", "Material", "Y"};
+                for (int layer = 0; layer < 4; layer++) {
+                    int sort = (int)queue.GetLayerSort((uint8_t)layer);
+                    std::string label = "Layer " + std::to_string(layer) + " Sort";
+                    if (ImGui::Combo(label.c_str(), &sort, sortNames, IM_ARRAYSIZE(sortNames))) {
+                        queue.SetLayerSort((uint8_t)layer, (LayerSort_t)sort);
+                    }
+                }
+                ImGui::Text("Queue: %d items, sort %.3f ms%s", queue.GetStats().items, queue.GetStats().sortMs,
+                            queue.GetStats().incremental ? " (incremental)" : "");
+                ImGui::Text("Grouped by texture: %d", queue.GetStats().grouped);
+                ImGui::Text("Collisions: %.3f ms", CollisionSystem::GetInstance().GetLastDetectMs());
+
+                bool spatialSort = world.IsSpatialSort();
+                if (ImGui::Checkbox("Morton Sort", &spatialSort)) {
+                    world.SetSpatialSort(spatialSort);
+                }
+                ImGui::Text("Sort: %.3f ms, %zu out of order%s", world.GetStats().spatialSortMs,
+                            world.GetStats().spatialInversions, world.GetStats().spatialFullSort ? " (full)" : "");
+
+                TickScheduler& lod = world.GetTickScheduler();
+                bool lodEnabled = lod.IsEnabled();
+                if (ImGui::Checkbox("Distance Update LOD", &lodEnabled)) {
+                    lod.SetEnabled(lodEnabled);
+                }
+                const TickStats_t& tickStats = lod.GetStats();
+                for (size_t i = 0; i < tickStats.tierCounts.size(); i++) {
+                    ImGui::BulletText("Tier %zu (every %d): %d", i, lod.GetTiers()[i].interval, tickStats.tierCounts[i]);
+                }
+                ImGui::Text("Updated %d, skipped %d, animations skipped %d",
+                            tickStats.updated, tickStats.skipped, tickStats.animationsSkipped);
+            }
+
+            // Lookups through the world's query index
+            if (ImGui::CollapsingHeader("Find Entities")) {
+                ImGui::InputText("Name##find", findName, 64);
+                ImGui::SameLine();
+                if (ImGui::Button("Find")) {
+                    selectedEntity = world.FindEntity(findName);
+                    if (!selectedEntity)
+                        SDL_Log("No entity named '%s'", findName);
+                }
+
+                // Query matches the exact class, subclasses aren't counted
+                ImGui::Text("Entities %zu", world.GetEntities().size());
+                ImGui::Text("By exact type: plain %zu, sprites %zu, animated %zu, players %zu",
+                            world.Query<Entity>().size(), world.Query<SpriteEntity>().size(),
+                            world.Query<AnimatedEntity>().size(), world.Query<Player>().size());
+
+                const auto& tags = NameTable::GetInstance().GetTags();
+                for (int i = 0; i < (int)tags.size(); i++) {
+                    int count = 0;
+                    for (Entity* e : world.WithTags(1ull << i)) {
+                        (void)e;
+                        count++;
+                    }
+                    if (ImGui::Selectable((tags[i] + " (" + std::to_string(count) + ")").c_str(), findTag == i))
+                        findTag = i;
+                }
+                if (findTag >= 0 && ImGui::Button("Select Next With Tag")) {
+                    Entity* first = nullptr;
+                    bool takeNext = false;
+                    for (Entity* e : world.WithTags(1ull << findTag)) {
+                        if (!first)
+                            first = e;
+                        if (takeNext) {
+                            first = e;
+                            break;
+                        }
+                        takeNext = e == selectedEntity;
+                    }
+                    selectedEntity = first;
+                }
+
+                // The entity may have been destroyed since it was picked
+                const auto& entities = world.GetEntities();
+                if (selectedEntity && std::find(entities.begin(), entities.end(), selectedEntity) == entities.end())
+                    selectedEntity = nullptr;
+
+                if (selectedEntity) {
+                    Vector2 pos = selectedEntity->GetPosition();
+                    ImGui::Text("Selected '%s' at %.1f, %.1f", selectedEntity->GetName().c_str(), pos.x, pos.y);
+                    if (ImGui::Button("Focus Camera"))
+                        Camera::GetInstance().Teleport(pos);
+
+                    ImGui::InputText("Tag", tagName, 32);
+                    if (ImGui::Button("Add Tag") && tagName[0])
+                        world.AddTags(selectedEntity, NameTable::GetInstance().Tag(tagName));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Remove Tag") && tagName[0])
+                        world.RemoveTags(selectedEntity, NameTable::GetInstance().Tag(tagName));
+                    ImGui::SameLine();
+                    if (ImGui::Button("Rename"))
+                        world.RenameEntity(selectedEntity, findName);
+                }
+            }
+
+            // Entity pool occupancy
+            if (ImGui::CollapsingHeader("Entity Pools")) {
+                for (const auto& s : EntityPoolRegistry::GetInstance().GetStats()) {
+                    ImGui::BulletText("%s: %zu / %zu (high water %zu)", s.name, s.live, s.capacity, s.highWater);
+                }
+            }
         }
         ImGui::End();
     }
@@ -328,36 +623,34 @@ public:
             return;
         }
         
-        // Write entity count
+        // Write version and entity count
         const auto& entities = world.GetEntities();
+        file << "level " << LEVEL_VERSION << "\n";
         file << entities.size() << "\n";
         
         for (const Entity* entity : entities) {
-            // Determine entity type
-            EntityType type = EntityType::ENTITY;
+            // Stored type tag, every sprite-derived type shares SpriteEntity's material
+            EntityType type = entity->GetType();
+            // The manager's name, what LoadLevel looks materials up by
             std::string materialName = "";
-            SDL_FRect srcRect = {0, 0, 32, 32};
             
-            if (const Player* player = dynamic_cast<const Player*>(entity)) {
-                type = EntityType::PLAYER;
-                if (player->GetMaterial()) {
-                    materialName = player->GetMaterial()->GetPath();
-                }
-            } else if (const TiledSpriteEntity* tiled = dynamic_cast<const TiledSpriteEntity*>(entity)) {
-                type = EntityType::TILED_SPRITE_ENTITY;
-                if (tiled->GetMaterial()) {
-                    materialName = tiled->GetMaterial()->GetPath();
-                }
-            } else if (const AnimatedEntity* animated = dynamic_cast<const AnimatedEntity*>(entity)) {
-                type = EntityType::ANIMATED_ENTITY;
-                if (animated->GetMaterial()) {
-                    materialName = animated->GetMaterial()->GetPath();
-                }
-            } else if (const SpriteEntity* sprite = dynamic_cast<const SpriteEntity*>(entity)) {
-                type = EntityType::SPRITE_ENTITY;
-                if (sprite->GetMaterial()) {
-                    materialName = sprite->GetMaterial()->GetPath();
+            switch (type) {
+                case EntityType::SPRITE_ENTITY:
+                case EntityType::TILED_SPRITE_ENTITY:
+                case EntityType::ANIMATED_ENTITY:
+                case EntityType::PLAYER: {
+                    const SpriteEntity* sprite = static_cast<const SpriteEntity*>(entity);
+                    materialName = MaterialManager::GetInstance().GetMaterialName(sprite->GetMaterial());
+                    break;
+                }
+                case EntityType::TILEMAP: {
+                    const Tilemap* tilemap = static_cast<const Tilemap*>(entity);
+                    materialName = MaterialManager::GetInstance().GetMaterialName(tilemap->GetMaterial());
+                    break;
                 }
+                case EntityType::ENTITY:
+                case EntityType::AGENT:
+                    break;
             }
             
             Vector2 pos = entity->GetPosition();
@@ -370,7 +663,27 @@ public:
                  << color.r << " " << color.g << " " << color.b << " " << color.a << " "
                  << entity->GetScale() << " "
                  << entity->IsStatic() << " "
+                 << (int)entity->GetRenderLayer() << " "
                  << materialName << "\n";
+
+            // Tilemaps add a line: tile size, columns, rows, then runs of
+            // tile and length
+            if (type == EntityType::TILEMAP) {
+                const Tilemap* tilemap = static_cast<const Tilemap*>(entity);
+                int columns = tilemap->GetColumns();
+                int cells = columns * tilemap->GetRows();
+                file << tilemap->GetTileSize() << " " << columns << " " << tilemap->GetRows();
+                int i = 0;
+                while (i < cells) {
+                    uint16_t tile = tilemap->GetTile(i % columns, i / columns);
+                    int length = 1;
+                    while (i + length < cells && tilemap->GetTile((i + length) % columns, (i + length) / columns) == tile)
+                        length++;
+                    file << " " << tile << " " << length;
+                    i += length;
+                }
+                file << "\n";
+            }
         }
         
         file.close();
@@ -385,18 +698,34 @@ public:
             return;
         }
         
+        int version = 1;
+        std::string first;
+        file >> first;
+        if (first == "level")
+            file >> version;
+        if (!file || version < 1 || version > LEVEL_VERSION) {
+            SDL_Log("Level %s has version %d, this build reads up to %d", filename.c_str(), version, LEVEL_VERSION);
+            return;
+        }
+
         world.ClearEntities();
         
-        int entityCount;
-        file >> entityCount;
+        int entityCount = 0;
+        if (first == "level")
+            file >> entityCount;
+        else
+            entityCount = SDL_atoi(first.c_str());
         
         for (int i = 0; i < entityCount; i++) {
             int typeInt;
             float px, py, sx, sy, scale;
             float r, g, b, a, isStatic;
+            int renderLayer = 0;
             std::string materialName;
             
             file >> typeInt >> px >> py >> sx >> sy >> r >> g >> b >> a >> scale >> isStatic;
+            if (version >= 2)
+                file >> renderLayer;
             std::getline(file >> std::ws, materialName);
             
             EntityTemplate tmpl;
@@ -406,7 +735,28 @@ public:
             tmpl.color = {r, g, b, a};
             tmpl.scale = scale;
             tmpl.isStatic = (bool)isStatic;
+            tmpl.renderLayer = renderLayer;
             tmpl.materialName = materialName;
+
+            if (tmpl.type == EntityType::TILEMAP) {
+                int tileSize = 16, columns = 0, rows = 0;
+                file >> tileSize >> columns >> rows;
+                tmpl.srcRect = {0, 0, (float)tileSize, (float)tileSize};
+                tmpl.size = {(float)(columns * tileSize), (float)(rows * tileSize)};
+                Tilemap* tilemap = static_cast<Tilemap*>(SpawnEntity(tmpl));
+                int cells = columns * rows;
+                for (int cell = 0; cell < cells && file; ) {
+                    int tile = 0, length = 0;
+                    file >> tile >> length;
+                    for (int n = 0; n < length && cell < cells; n++, cell++) {
+                        if (tilemap)
+                            tilemap->SetTile(cell % columns, cell / columns, (uint16_t)tile);
+                    }
+                    if (length <= 0)
+                        break;
+                }
+                continue;
+            }
             
             SpawnEntity(tmpl);
         }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <SDL3/SDL.h>
+
+// Owns one instance of every engine service (World, CollisionSystem, Camera,
+// Screen, MaterialManager, ...). The services' GetInstance() resolves through
+// the calling thread's current context, so code written against the
+// singletons runs unchanged inside any context. Several contexts can
+// simulate side by side, each driven by its own thread.
+//
+// Threads start out on the default context. ThreadPool tasks run in the
+// context that submitted them. Entity pools and the thread pool itself stay
+// process-wide, both are thread-safe.
+class EngineContext {
+    private:
+    static constexpr int MAX_SERVICES = 32;
+
+    struct Owned {
+        void *instance;
+        void (*destroy)(void*);
+    };
+
+    std::atomic<void*> services[MAX_SERVICES] = {};
+    std::vector<Owned> owned;   // creation order, destroyed in reverse
+    std::recursive_mutex mutex;
+
+    static int NextTypeId() {
+        static std::atomic<int> next{0};
+        return next++;
+    }
+
+    template <typename T>
+    static int TypeId() {
+        static const int id = NextTypeId();
+        return id;
+    }
+
+    static EngineContext*& CurrentSlot() {
+        static thread_local EngineContext *current = nullptr;
+        return current;
+    }
+
+    template <typename T>
+    T* Create(int id) {
+        // Services may look up other services from their constructor
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (void *existing = services[id].load(std::memory_order_acquire))
+            return static_cast<T*>(existing);
+
+        T *instance = new T();
+        owned.push_back({instance, [](void *p) { delete static_cast<T*>(p); }});
+        services[id].store(instance, std::memory_order_release);
+        return instance;
+    }
+
+    public:
+    EngineContext() = default;
+
+    ~EngineContext() {
+        for (auto it = owned.rbegin(); it != owned.rend(); ++it)
+            it->destroy(it->instance);
+    }
+
+    EngineContext(const EngineContext&) = delete;
+    EngineContext& operator=(const EngineContext&) = delete;
+
+    // The context's instance of T, created on first use
+    template <typename T>
+    T& Get() {
+        int id = TypeId<T>();
+        if (id >= MAX_SERVICES) {
+            SDL_Log("EngineContext: too many service types, raise MAX_SERVICES");
+            std::abort();
+        }
+        void *instance = services[id].load(std::memory_order_acquire);
+        return instance ? *static_cast<T*>(instance) : *Create<T>(id);
+    }
+
+    static EngineContext& Default() {
+        static EngineContext context;
+        return context;
+    }
+
+    static EngineContext& Current() {
+        EngineContext *current = CurrentSlot();
+        return current ? *current : Default();
+    }
+
+    // Makes a context current on this thread until the scope ends
+    class Scope {
+        EngineContext *previous;
+
+        public:
+        Scope(EngineContext &context) : previous(CurrentSlot()) {
+            CurrentSlot() = &context;
+        }
+        ~Scope() {
+            CurrentSlot() = previous;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+};
@@ -4,52 +4,208 @@
 #include "../Color/color.h"
 #include "../Camera/camera.h"
 #include "../Material/material.h"
+#include "../EntityPool/entitypool.h"
+#include "../Snapshot/snapshot.h"
+#include "../NameTable/nametable.h"
+#include "../RenderQueue/renderqueue.h"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
 
+// Stored type tag, used for serialization and by World's typed buckets
+enum class EntityType {
+    ENTITY,
+    SPRITE_ENTITY,
+    TILED_SPRITE_ENTITY,
+    ANIMATED_ENTITY,
+    PLAYER,
+    TILEMAP,
+    AGENT
+};
+
+// Per-entity update LOD bookkeeping, filled in by TickScheduler
+struct TickState_t {
+    double pendingDt = 0.0;     // time skipped since the last update
+    double stepDt = 0.0;        // dt to pass to Process this frame
+    int tier = 0;
+    bool update = true;         // run Process this frame
+    bool alwaysUpdate = false;  // never demote (players, scripted objects, ...)
+    uint32_t phase = 0;         // spreads updates of one tier over frames
+};
+
 class Entity {
+    DECLARE_POOLED_ENTITY(Entity)
+
 protected:
     Vector2 position = {0.0, 0.0};
+    Vector2 previousPosition = {0.0, 0.0};  // position at the start of the last fixed step
+    Vector2 renderPosition = {0.0, 0.0};    // interpolated position used by Draw
     Vector2 velocity = {0.0, 0.0};
     Vector2 size = {0.0, 0.0};
     float scale = 1.0f;
     Color color = {1.0, 1.0, 1.0, 1.0};
     bool isStatic = false;
     bool hasCollision = true;
+    uint8_t renderLayer = 0;    // see RenderQueue, higher layers draw on top
+    EntityType type = EntityType::ENTITY;
+    TickState_t tick;
+
+    // Index of the World bucket holding this entity, -1 when it isn't one of
+    // the statically dispatched types
+    friend class World;
+    int worldBucket = -1;
+    uint32_t stableIndex = 0;   // scratch index used while writing snapshots
+    uint32_t id = 0;            // unique per world, assigned when added
+
+    // Set by TransformHierarchy, a child's position follows its parent
+    friend class TransformHierarchy;
+    Entity *parent = nullptr;
+    int transformNode = -1;
+
+    // Query keys, changed through World::RetagEntity/RenameEntity so the
+    // EntityIndex stays in sync
+    friend class EntityIndex;
+    uint64_t tags = 0;
+    uint32_t nameId = 0;
+    bool indexed = false;
+
+    // Place in the World's CullingGrid
+    friend class CullingGrid;
+    uint64_t cullCell = 0;
+    int cullSlot = -1;
+    int cullMover = -1;     // index in the grid's movers, static entities aren't one
+    bool cullLarge = false;
+    uint32_t drawOrder = 0;
+
+    // Drawn from a ChunkCache texture instead of its own Draw
+    friend class ChunkCache;
+    bool drawCached = false;
 
 public:
     Entity() = default;
     virtual ~Entity() = default;
 
+    EntityType GetType() const { return type; }
+
+    // Stable id for replication, World assigns one on add unless it's set.
+    // Only set it on entities mirrored from another world.
+    uint32_t GetId() const { return id; }
+    void SetId(uint32_t id) { this->id = id; }
+
     // Basic properties
     Vector2 GetPosition() const { return position; }
     void SetPosition(Vector2 pos) { position = pos; }
 
+    // Moves without sliding there over the next rendered step
+    void Teleport(Vector2 pos) {
+        position = pos;
+        ResetInterpolation();
+    }
+
+    // Fixed-step interpolation, driven by World::BeginStep/Interpolate
+    Vector2 GetRenderPosition() const { return renderPosition; }
+    void SavePreviousPosition() { previousPosition = position; }
+    void InterpolatePosition(float alpha) {
+        renderPosition = previousPosition + (position - previousPosition) * alpha;
+    }
+    void ResetInterpolation() {
+        previousPosition = position;
+        renderPosition = position;
+    }
+
+    // Parent in the World's transform hierarchy, see World::Attach
+    Entity* GetParent() const { return parent; }
+    int GetTransformNode() const { return transformNode; }
+
+    uint64_t GetTags() const { return tags; }
+    bool HasTags(uint64_t mask) const { return (tags & mask) == mask; }
+    uint32_t GetNameId() const { return nameId; }
+    const std::string& GetName() const { return NameTable::GetInstance().GetName(nameId); }
+
     Vector2 GetSize() const { return size; }
     void SetSize(Vector2 s) { size = s; }
 
+    // Unscaled size of what Draw puts on screen, centered on the position
+    virtual Vector2 GetDrawSize() const { return size; }
+
     float GetScale() const { return scale; }
     void SetScale(float s) { scale = s; }
 
     bool IsStatic() const { return isStatic; }
     void SetStatic(bool s) { isStatic = s; }
 
+    // Whether Draw looks the same every frame, so it can be pre-rendered
+    // into a ChunkCache texture. Call World::OnStaticChanged after
+    // moving a static entity or changing how a cached one looks from
+    // gameplay code, the transform hierarchy, snapshot restores and
+    // replication already do.
+    virtual bool IsDrawCacheable() const { return isStatic; }
+    bool IsDrawCached() const { return drawCached; }
+
+    uint8_t GetRenderLayer() const { return renderLayer; }
+    void SetRenderLayer(uint8_t layer) { renderLayer = layer; }
+
     Color GetColor() const { return color; }
     void SetColor(Color c) { color = c; }
 
     Vector2 GetVelocity() const { return velocity; }
     void SetVelocity(Vector2 v) { velocity = v; }
 
-    bool GetHasCollision() { return this->hasCollision; }
+    TickState_t& GetTickState() { return tick; }
+    void SetAlwaysUpdate(bool always) { tick.alwaysUpdate = always; }
+
+    bool GetHasCollision() const { return this->hasCollision; }
     void SetCollision(bool hasCollision) { this->hasCollision = hasCollision; }
 
     virtual void Process(double dt) { }
 
+    // Snapshot state, subclasses write their own fields after the base's
+    virtual void SaveState(SnapshotWriter &w) const {
+        w.Write(position);
+        w.Write(previousPosition);
+        w.Write(velocity);
+        w.Write(size);
+        w.Write(scale);
+        w.Write(color);
+        w.Write(isStatic);
+        w.Write(hasCollision);
+        w.Write(renderLayer);
+        // field by field, struct padding would make checksums unstable
+        w.Write(tick.pendingDt);
+        w.Write(tick.tier);
+        w.Write(tick.alwaysUpdate);
+        w.Write(tick.phase);
+    }
+
+    virtual void LoadState(SnapshotReader &r) {
+        r.Read(position);
+        r.Read(previousPosition);
+        r.Read(velocity);
+        r.Read(size);
+        r.Read(scale);
+        r.Read(color);
+        r.Read(isStatic);
+        r.Read(hasCollision);
+        r.Read(renderLayer);
+        r.Read(tick.pendingDt);
+        r.Read(tick.tier);
+        r.Read(tick.alwaysUpdate);
+        r.Read(tick.phase);
+        renderPosition = position;
+    }
+
+    // Return true if Process only writes this entity's own state and reads
+    // nothing that moves during the update: no traces or GetPosition of
+    // other non-static entities, they may be mid-write on another worker.
+    // Those entities may be updated on worker threads, shared writes go
+    // through DeferredWrites. Checked once when the entity is added to the
+    // world.
+    virtual bool IsParallelSafe() const { return false; }
+
+    // Queued on the RenderQueue, World::DrawEntities sorts and submits it
     virtual void Draw() {
-        SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
         Camera& camera = Camera::GetInstance();
-        Vector2 screenPos = camera.WorldToScreen(position);
+        Vector2 screenPos = camera.WorldToScreen(renderPosition);
 
         SDL_FRect rect;
         rect.w = size.x * camera.GetZoomOnScreen(scale);
@@ -57,8 +213,7 @@ public:
         rect.x = screenPos.x - (rect.w * 0.5f);
         rect.y = screenPos.y - (rect.h * 0.5f);
 
-        SDL_SetRenderDrawColorFloat(renderer, color.r, color.g, color.b, color.a);
-        SDL_RenderFillRect(renderer, &rect);
+        RenderQueue::GetInstance().AddRect(rect, {color.r, color.g, color.b, color.a});
     }
 
 };
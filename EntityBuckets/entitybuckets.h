@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <tuple>
+#include <typeinfo>
+#include <vector>
+#include "../Entity/entity.h"
+#include "../SpriteEntity/spriteentity.h"
+#include "../TiledSpriteEntity/tiledspriteentity.h"
+#include "../AnimatedEntity/animatedentity.h"
+#include "../Player/player.h"
+#include "../Tilemap/tilemap.h"
+#include "../Agent/agent.h"
+
+template <typename... Ts>
+struct EntityTypeList {};
+
+// Concrete classes that get their own bucket and are called without virtual
+// dispatch. The order is also the order buckets are processed and drawn in.
+using WorldEntityTypes = EntityTypeList<Tilemap, TiledSpriteEntity, Entity, SpriteEntity, AnimatedEntity, Player, Agent>;
+
+template <typename List>
+class EntityBuckets;
+
+// Keeps entities grouped by their exact dynamic type. Subclasses that aren't
+// in the type list go into a fallback bucket and keep using virtual calls.
+template <typename... Ts>
+class EntityBuckets<EntityTypeList<Ts...>> {
+    private:
+    std::tuple<std::vector<Ts*>...> typed;
+    std::vector<Entity*> dynamic;
+
+    static_assert((HasOwnPool<Ts> && ...), "every bucketed entity type needs its own DECLARE_POOLED_ENTITY");
+
+    template <typename T>
+    static void Remove(std::vector<T*> &list, Entity *entity) {
+        auto it = std::find(list.begin(), list.end(), static_cast<T*>(entity));
+        if (it != list.end())
+            list.erase(it);
+    }
+
+    public:
+    static constexpr int Count = sizeof...(Ts);
+
+    // Bucket index for the entity's exact type, -1 if it isn't listed
+    static int Classify(Entity *entity) {
+        int index = -1, i = 0;
+        ((typeid(*entity) == typeid(Ts) && index < 0 ? (index = i) : 0, i++), ...);
+        return index;
+    }
+
+    void Insert(Entity *entity, int bucket) {
+        if (bucket < 0) {
+            dynamic.push_back(entity);
+            return;
+        }
+        int i = 0;
+        ((i++ == bucket ? std::get<std::vector<Ts*>>(typed).push_back(static_cast<Ts*>(entity)) : void()), ...);
+    }
+
+    void Erase(Entity *entity, int bucket) {
+        if (bucket < 0) {
+            auto it = std::find(dynamic.begin(), dynamic.end(), entity);
+            if (it != dynamic.end())
+                dynamic.erase(it);
+            return;
+        }
+        int i = 0;
+        ((i++ == bucket ? Remove(std::get<std::vector<Ts*>>(typed), entity) : void()), ...);
+    }
+
+    void Clear() {
+        (std::get<std::vector<Ts*>>(typed).clear(), ...);
+        dynamic.clear();
+    }
+
+    // Calls fn(std::vector<T*>&) for every typed bucket, in list order
+    template <typename F>
+    void ForEachBucket(F &&fn) {
+        (fn(std::get<std::vector<Ts*>>(typed)), ...);
+    }
+
+    std::vector<Entity*>& GetDynamic() {
+        return dynamic;
+    }
+
+    template <typename T>
+    std::vector<T*>& Get() {
+        return std::get<std::vector<T*>>(typed);
+    }
+
+    // Single-entity dispatch through the stored bucket index
+    static void Draw(Entity *entity, int bucket) {
+        if (bucket < 0) {
+            entity->Draw();
+            return;
+        }
+        int i = 0;
+        ((i++ == bucket ? static_cast<Ts*>(entity)->Ts::Draw() : void()), ...);
+    }
+};
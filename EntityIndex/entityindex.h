@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "../Entity/entity.h"
+#include "../NameTable/nametable.h"
+
+// Non-owning range over an index list. Valid until the world's next
+// add/remove, same as World::GetEntities().
+template <typename T>
+class EntityView {
+    private:
+    T* const *first = nullptr;
+    T* const *last = nullptr;
+
+    public:
+    EntityView() = default;
+    EntityView(const std::vector<T*> &list) : first(list.data()), last(list.data() + list.size()) {}
+
+    T* const* begin() const { return first; }
+    T* const* end() const { return last; }
+    size_t size() const { return (size_t)(last - first); }
+    bool empty() const { return first == last; }
+    T* operator[](size_t i) const { return first[i]; }
+};
+
+// Entities carrying every tag in a mask. Walks the shortest per-tag list
+// and skips the ones missing any of the other tags.
+class TagView {
+    private:
+    Entity* const *first = nullptr;
+    Entity* const *last = nullptr;
+    uint64_t mask = 0;
+
+    public:
+    class Iterator {
+        Entity* const *it;
+        Entity* const *last;
+        uint64_t mask;
+
+        void Skip() {
+            while (it != last && ((*it)->GetTags() & mask) != mask)
+                it++;
+        }
+
+        public:
+        Iterator(Entity* const *it, Entity* const *last, uint64_t mask) : it(it), last(last), mask(mask) { Skip(); }
+        Entity* operator*() const { return *it; }
+        Iterator& operator++() { it++; Skip(); return *this; }
+        bool operator!=(const Iterator &other) const { return it != other.it; }
+    };
+
+    TagView() = default;
+    TagView(const std::vector<Entity*> &list, uint64_t mask)
+        : first(list.data()), last(list.data() + list.size()), mask(mask) {}
+
+    Iterator begin() const { return Iterator(first, last, mask); }
+    Iterator end() const { return Iterator(last, last, mask); }
+};
+
+// Tag and name lookups for the World, updated on add, remove, retag and
+// rename. Per-type lookups reuse World's entity buckets.
+class EntityIndex {
+    private:
+    std::vector<Entity*> byTag[64];
+    std::unordered_map<uint32_t, std::vector<Entity*>> byName;
+    std::vector<Entity*> none;
+
+    static void Remove(std::vector<Entity*> &list, Entity *entity) {
+        auto it = std::find(list.begin(), list.end(), entity);
+        if (it != list.end()) {
+            *it = list.back();
+            list.pop_back();
+        }
+    }
+
+    void AddTags(Entity *entity, uint64_t tags) {
+        for (uint64_t bits = tags; bits; bits &= bits - 1)
+            byTag[__builtin_ctzll(bits)].push_back(entity);
+    }
+
+    void RemoveTags(Entity *entity, uint64_t tags) {
+        for (uint64_t bits = tags; bits; bits &= bits - 1)
+            Remove(byTag[__builtin_ctzll(bits)], entity);
+    }
+
+    public:
+    void Insert(Entity *entity) {
+        AddTags(entity, entity->tags);
+        if (entity->nameId)
+            byName[entity->nameId].push_back(entity);
+        entity->indexed = true;
+    }
+
+    void Erase(Entity *entity) {
+        if (!entity->indexed)
+            return;
+        RemoveTags(entity, entity->tags);
+        if (entity->nameId) {
+            auto it = byName.find(entity->nameId);
+            if (it != byName.end())
+                Remove(it->second, entity);
+        }
+        entity->indexed = false;
+    }
+
+    void Clear() {
+        for (auto &list : byTag)
+            list.clear();
+        byName.clear();
+    }
+
+    // Also fine on entities that aren't in the world yet
+    void SetTags(Entity *entity, uint64_t tags) {
+        if (entity->indexed) {
+            RemoveTags(entity, entity->tags & ~tags);
+            AddTags(entity, tags & ~entity->tags);
+        }
+        entity->tags = tags;
+    }
+
+    void SetName(Entity *entity, uint32_t nameId) {
+        if (entity->indexed && entity->nameId != nameId) {
+            if (entity->nameId)
+                Remove(byName[entity->nameId], entity);
+            if (nameId)
+                byName[nameId].push_back(entity);
+        }
+        entity->nameId = nameId;
+    }
+
+    TagView WithTags(uint64_t mask) const {
+        if (mask == 0)
+            return TagView(none, 0);
+
+        const std::vector<Entity*> *shortest = nullptr;
+        for (uint64_t bits = mask; bits; bits &= bits - 1) {
+            const auto &list = byTag[__builtin_ctzll(bits)];
+            if (!shortest || list.size() < shortest->size())
+                shortest = &list;
+        }
+        return TagView(*shortest, mask);
+    }
+
+    EntityView<Entity> WithName(uint32_t nameId) const {
+        auto it = byName.find(nameId);
+        if (nameId == 0 || it == byName.end())
+            return EntityView<Entity>();
+        return EntityView<Entity>(it->second);
+    }
+};
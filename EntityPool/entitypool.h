@@ -0,0 +1,165 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+struct EntityPoolStats_t {
+    const char* name;
+    size_t live;        // objects currently allocated
+    size_t capacity;    // slots owned by the pool
+    size_t highWater;   // most objects ever alive at once
+    size_t slabs;
+};
+
+class EntityPoolBase {
+    public:
+    virtual ~EntityPoolBase() = default;
+    virtual EntityPoolStats_t GetStats() = 0;
+};
+
+class EntityPoolRegistry {
+    private:
+    std::vector<EntityPoolBase*> pools;
+    std::mutex mutex;
+
+    EntityPoolRegistry() {}
+
+    public:
+    static EntityPoolRegistry& GetInstance() {
+        static EntityPoolRegistry instance;
+        return instance;
+    }
+
+    void Register(EntityPoolBase *pool) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pools.push_back(pool);
+    }
+
+    std::vector<EntityPoolStats_t> GetStats() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<EntityPoolStats_t> out;
+        for (auto *pool : pools)
+            out.push_back(pool->GetStats());
+        return out;
+    }
+
+    void LogStats() {
+        for (auto &s : GetStats()) {
+            SDL_Log("Pool %-18s live %zu / %zu (high water %zu, %zu slabs)",
+                    s.name, s.live, s.capacity, s.highWater, s.slabs);
+        }
+    }
+};
+
+// Slab allocator for one concrete entity class. Memory is grabbed in slabs of
+// SlabSize objects and never given back to the system, freed slots go into an
+// intrusive free list, so steady-state spawning and despawning costs no
+// malloc/free and instances of one type sit next to each other.
+template <typename T, size_t SlabSize = 256>
+class EntityPool : public EntityPoolBase {
+    private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    Slot *freeList = nullptr;
+    size_t live = 0;
+    size_t highWater = 0;
+    std::mutex mutex;
+
+    EntityPool() {
+        EntityPoolRegistry::GetInstance().Register(this);
+    }
+
+    void Grow() {
+        slabs.emplace_back(new Slot[SlabSize]);
+        Slot *slab = slabs.back().get();
+        for (size_t i = SlabSize; i > 0; --i) {
+            slab[i - 1].next = freeList;
+            freeList = &slab[i - 1];
+        }
+    }
+
+    void* Acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeList)
+            Grow();
+
+        Slot *slot = freeList;
+        freeList = slot->next;
+
+        if (++live > highWater)
+            highWater = live;
+
+        return slot->storage;
+    }
+
+    void Release(void *p) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Slot *slot = reinterpret_cast<Slot*>(p);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    public:
+    static EntityPool& Get() {
+        static EntityPool pool;
+        return pool;
+    }
+
+    // Sized allocations that don't match T come from a subclass that didn't
+    // declare its own pool, those fall back to the global heap.
+    static void* Allocate(size_t size) {
+        if (size != sizeof(T))
+            return ::operator new(size);
+        return Get().Acquire();
+    }
+
+    static void Free(void *p, size_t size) {
+        if (!p)
+            return;
+        if (size != sizeof(T)) {
+            ::operator delete(p);
+            return;
+        }
+        Get().Release(p);
+    }
+
+    // Pre-allocate enough slabs for count objects before a bulk spawn
+    void Reserve(size_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (slabs.size() * SlabSize < count)
+            Grow();
+    }
+
+    EntityPoolStats_t GetStats() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {T::PoolName(), live, slabs.size() * SlabSize, highWater, slabs.size()};
+    }
+};
+
+// Routes new/delete of an entity class through its own EntityPool. The
+// entity destructor is virtual, so delete on an Entity* reaches the pool of
+// the concrete class. Put it first in the class body, it leaves the access
+// at private like the class default. Every subclass needs its own, see
+// HasOwnPool.
+#define DECLARE_POOLED_ENTITY(Class) \
+    public: \
+    using PooledClass = Class; \
+    static const char* PoolName() { return #Class; } \
+    static void* operator new(size_t size) { return EntityPool<Class>::Allocate(size); } \
+    static void operator delete(void *p, size_t size) { EntityPool<Class>::Free(p, size); } \
+    private:
+
+// False for a subclass that inherited its base's DECLARE_POOLED_ENTITY. One
+// of the same size would take slots from the base's pool.
+template <typename T>
+constexpr bool HasOwnPool = std::is_same_v<typename T::PooledClass, T>;
@@ -7,18 +7,12 @@
 #include "../AnimatedEntity/animatedentity.h"
 #include "../TiledSpriteEntity/tiledspriteentity.h"
 #include "../Player/player.h"
+#include "../Tilemap/tilemap.h"
+#include "../Agent/agent.h"
 
 #include "../Material/materialmanager.h"
 #include "../World/world.h"
 
-enum class EntityType {
-    ENTITY,
-    SPRITE_ENTITY,
-    TILED_SPRITE_ENTITY,
-    ANIMATED_ENTITY,
-    PLAYER
-};
-
 struct EntityTemplate {
     EntityType type;
     std::string name;
@@ -29,6 +23,7 @@ struct EntityTemplate {
     Color color;
     float scale;
     bool isStatic;
+    int renderLayer;
     
     // Sprite properties
     std::string materialName;
@@ -37,6 +32,8 @@ struct EntityTemplate {
     
     // Tiled sprite properties
     bool isTiled;
+
+    // Tilemaps use srcRect.w as the tile size and size / tile size cells
     
     // Animation properties (for AnimatedEntity/Player)
     bool hasAnimations;
@@ -49,6 +46,7 @@ struct EntityTemplate {
         , color{255, 255, 255, 255}
         , scale(1.0f)
         , isStatic(false)
+        , renderLayer(0)
         , materialName("")
         , srcRect{0, 0, 32, 32}
         , flipX(false)
@@ -113,6 +111,25 @@ struct EntityTemplate {
                 entity = player;
                 break;
             }
+
+            case EntityType::TILEMAP: {
+                Tilemap* tilemap = new Tilemap();
+                if (!materialName.empty())
+                    tilemap->SetMaterial(MaterialManager::GetInstance().GetMaterial(materialName));
+                int tileSize = std::max((int)srcRect.w, 1);
+                tilemap->SetTileSize(tileSize);
+                tilemap->Resize((int)(size.x / tileSize), (int)(size.y / tileSize));
+                entity = tilemap;
+                break;
+            }
+
+            case EntityType::AGENT: {
+                Agent* agent = new Agent();
+                uint32_t seed = (uint32_t)(int)position.x * 73856093u ^ (uint32_t)(int)position.y * 19349663u;
+                agent->SetWander(position, 256.0f, seed);
+                entity = agent;
+                break;
+            }
         }
         
         if (entity) {
@@ -121,6 +138,7 @@ struct EntityTemplate {
             entity->SetColor(color);
             entity->SetScale(scale);
             entity->SetStatic(isStatic);
+            entity->SetRenderLayer((uint8_t)renderLayer);
         }
         
         return entity;
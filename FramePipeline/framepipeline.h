@@ -0,0 +1,153 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <SDL3/SDL.h>
+#include "../RenderQueue/renderqueue.h"
+#include "../Engine/enginecontext.h"
+
+enum class FrameLatency_t : uint8_t {
+    LOW,        // the main thread waits for this frame's list, nothing overlaps
+    PIPELINED   // last frame's list is drawn while the next is simulated, one frame behind
+};
+
+struct FramePipelineStats_t {
+    double produceMs = 0.0;     // simulating and recording the last list
+    double waitMs = 0.0;        // main thread blocked in the last Sync
+    uint64_t frames = 0;
+};
+
+// Runs the simulation on a thread of its own and hands every frame to the
+// main thread as a DrawList_t. SDL wants its renderer used from the main
+// thread only, so the main thread is the render thread: it draws the lists,
+// the UI and presents, and it is the only thread calling the renderer while
+// the pipeline runs. The producer must not.
+//
+// Two lists: the simulation thread records into the back one while the
+// main thread draws the front one. Per frame the main thread calls Sync,
+// may then touch the world (editor, UI) while the simulation thread is
+// idle, calls Kick and draws GetFront().
+class FramePipeline {
+    private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    std::function<void(DrawList_t&)> produce;
+    EngineContext *context = nullptr;   // the producer runs in the starting thread's context
+
+    DrawList_t lists[2];
+    int front = 0;
+    bool requested = false;     // the simulation thread has a frame to produce
+    bool ready = false;         // the back list holds a frame that Sync hasn't taken yet
+    bool running = false;
+    FrameLatency_t latency = FrameLatency_t::PIPELINED;
+    FramePipelineStats_t stats;
+
+    void Loop() {
+        EngineContext::Scope scope(*context);
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return requested || !running; });
+            if (!running)
+                return;
+
+            // The back list is only touched here until ready is set
+            lock.unlock();
+            Uint64 start = SDL_GetTicksNS();
+            produce(lists[1 - front]);
+            double ms = (double)(SDL_GetTicksNS() - start) / 1e6;
+            lock.lock();
+
+            stats.produceMs = ms;
+            requested = false;
+            ready = true;
+            done.notify_all();
+        }
+    }
+
+    public:
+    ~FramePipeline() {
+        Stop();
+    }
+
+    // producer runs once per frame on the simulation thread: step, interpolate
+    // and record the frame into the list it's given
+    void Start(std::function<void(DrawList_t&)> producer) {
+        if (thread.joinable())
+            return;
+        produce = std::move(producer);
+        context = &EngineContext::Current();
+        running = true;
+        requested = ready = false;
+        thread = std::thread([this]() { Loop(); });
+    }
+
+    // Waits for the frame in flight, the main thread has the world to itself after
+    void Stop() {
+        if (!thread.joinable())
+            return;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this]() { return !requested; });
+            running = false;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    bool IsRunning() const {
+        return thread.joinable();
+    }
+
+    // Waits until a new frame is recorded and makes it the front list. LOW
+    // (and the first PIPELINED frame) asks for that frame here, otherwise it
+    // was asked for by the last Kick. The simulation thread stays idle
+    // until the next Kick.
+    void Sync() {
+        Uint64 start = SDL_GetTicksNS();
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!requested && !ready) {
+            requested = true;
+            wake.notify_one();
+        }
+        done.wait(lock, [this]() { return ready; });
+        ready = false;
+        front = 1 - front;
+        stats.frames++;
+        stats.waitMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    // PIPELINED: starts the next frame, to be drawn after the one Sync just
+    // returned. The main thread must leave the world alone until Sync.
+    void Kick() {
+        if (latency != FrameLatency_t::PIPELINED)
+            return;
+        std::lock_guard<std::mutex> lock(mutex);
+        if (requested || ready)
+            return;
+        requested = true;
+        wake.notify_one();
+    }
+
+    // The list Sync returned, valid until the next Sync
+    const DrawList_t& GetFront() const {
+        return lists[front];
+    }
+
+    // Takes effect from the next Sync, a frame already in flight is still drawn
+    void SetLatency(FrameLatency_t mode) {
+        latency = mode;
+    }
+
+    FrameLatency_t GetLatency() const {
+        return latency;
+    }
+
+    // Read between Sync and Kick, or with the pipeline stopped
+    const FramePipelineStats_t& GetStats() const {
+        return stats;
+    }
+};
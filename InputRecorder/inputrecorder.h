@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <SDL3/SDL.h>
+#include "../InputSystem/inputsystem.h"
+#include "../Snapshot/snapshot.h"
+#include "../World/world.h"
+#include "../Engine/enginecontext.h"
+
+// One simulation step of a recording
+struct RecordedFrame_t {
+    double dt;
+    InputState_t inputs[InputSystem::MAX_SLOTS];
+    uint64_t hash;      // world checksum after the step
+};
+
+struct ReplayStats_t {
+    size_t frames = 0;          // replayed so far
+    size_t mismatches = 0;
+    int64_t firstMismatch = -1;
+    double stepMs = 0.0;        // total simulation time, hashing excluded
+};
+
+// Records the input slots and dt of every simulation step, plus the world
+// checksum after it, starting from a snapshot of the world. Replaying feeds
+// the same inputs back into the InputSystem and compares checksums, so a
+// play session can be rerun headless as a perf capture, and a change that
+// alters simulation outcomes shows up as the first mismatching frame.
+// Editor changes made while recording are not part of it.
+class InputRecorder {
+    public:
+    enum class Mode {
+        IDLE,
+        RECORDING,
+        REPLAYING
+    };
+
+    private:
+    static constexpr uint32_t FILE_MAGIC = 0x5250564e;   // "NVPR"
+    static constexpr uint32_t FILE_VERSION = 2;    // 2: World::Checksum hashes fields
+
+    Mode mode = Mode::IDLE;
+    Snapshot start;
+    std::vector<RecordedFrame_t> frames;
+    size_t cursor = 0;
+    Uint64 stepStart = 0;
+    ReplayStats_t replayStats;
+
+    InputRecorder(const InputRecorder&) = delete;
+    InputRecorder& operator=(const InputRecorder&) = delete;
+
+    friend class EngineContext;
+    InputRecorder() {}
+
+    public:
+    static InputRecorder& GetInstance() {
+        return EngineContext::Current().Get<InputRecorder>();
+    }
+
+    void StartRecording(World &world) {
+        frames.clear();
+        world.SaveSnapshot(start);
+        mode = Mode::RECORDING;
+    }
+
+    void StopRecording() {
+        if (mode == Mode::RECORDING)
+            mode = Mode::IDLE;
+    }
+
+    // Loads a recording, puts the world back where it started and takes
+    // over the input slots
+    bool StartReplay(World &world, const char *path) {
+        if (!Load(path))
+            return false;
+        if (!StartReplay(world)) {
+            SDL_Log("InputRecorder: couldn't restore the start of %s", path);
+            return false;
+        }
+        return true;
+    }
+
+    // Replays the recording held in memory, the last one made or loaded
+    bool StartReplay(World &world) {
+        if (!world.RestoreSnapshot(start))
+            return false;
+        InputSystem::GetInstance().SetKeyboardEnabled(false);
+        cursor = 0;
+        replayStats = ReplayStats_t();
+        mode = Mode::REPLAYING;
+        return true;
+    }
+
+    // Before a step, after the InputSystem was filled. Replaying overwrites
+    // the slots and dt with the recorded ones.
+    void BeforeStep(double &dt) {
+        InputSystem &input = InputSystem::GetInstance();
+        if (mode == Mode::RECORDING) {
+            RecordedFrame_t frame;
+            frame.dt = dt;
+            for (int s = 0; s < InputSystem::MAX_SLOTS; s++)
+                frame.inputs[s] = input.Get(s);
+            frame.hash = 0;
+            frames.push_back(frame);
+        } else if (mode == Mode::REPLAYING && cursor < frames.size()) {
+            const RecordedFrame_t &frame = frames[cursor];
+            dt = frame.dt;
+            for (int s = 0; s < InputSystem::MAX_SLOTS; s++)
+                input.Set(s, frame.inputs[s]);
+        }
+        stepStart = SDL_GetTicksNS();
+    }
+
+    void AfterStep(World &world) {
+        if (mode == Mode::IDLE)
+            return;
+        Uint64 stepNS = SDL_GetTicksNS() - stepStart;
+        uint64_t hash = world.Checksum();
+
+        if (mode == Mode::RECORDING) {
+            frames.back().hash = hash;
+            return;
+        }
+        if (cursor >= frames.size())
+            return;
+
+        replayStats.stepMs += (double)stepNS / 1e6;
+        if (hash != frames[cursor].hash) {
+            if (replayStats.firstMismatch < 0) {
+                replayStats.firstMismatch = (int64_t)cursor;
+                SDL_Log("InputRecorder: replay diverged at frame %zu", cursor);
+            }
+            replayStats.mismatches++;
+        }
+        cursor++;
+        replayStats.frames = cursor;
+    }
+
+    bool IsReplayDone() const {
+        return mode == Mode::REPLAYING && cursor >= frames.size();
+    }
+
+    Mode GetMode() const {
+        return mode;
+    }
+
+    size_t GetFrameCount() const {
+        return frames.size();
+    }
+
+    const ReplayStats_t& GetReplayStats() const {
+        return replayStats;
+    }
+
+    bool Save(const char *path) const {
+        std::vector<uint8_t> out;
+        {
+            SnapshotWriter w(out);
+            w.Write(FILE_MAGIC);
+            w.Write(FILE_VERSION);
+            w.Write((uint32_t)start.data.size());
+            for (uint8_t b : start.data)
+                w.Write(b);
+            w.Write((uint32_t)frames.size());
+            for (const RecordedFrame_t &f : frames) {
+                // field by field, struct padding isn't written
+                w.Write(f.dt);
+                for (const InputState_t &input : f.inputs)
+                    w.Write(input.buttons);
+                w.Write(f.hash);
+            }
+        }
+
+        SDL_IOStream *file = SDL_IOFromFile(path, "wb");
+        if (!file) {
+            SDL_Log("InputRecorder: couldn't open %s for writing", path);
+            return false;
+        }
+        bool ok = SDL_WriteIO(file, out.data(), out.size()) == out.size();
+        SDL_CloseIO(file);
+        if (!ok)
+            SDL_Log("InputRecorder: couldn't write %s", path);
+        return ok;
+    }
+
+    bool Load(const char *path) {
+        SDL_IOStream *file = SDL_IOFromFile(path, "rb");
+        if (!file) {
+            SDL_Log("InputRecorder: couldn't open %s", path);
+            return false;
+        }
+        std::vector<uint8_t> in;
+        uint8_t chunk[65536];
+        size_t read;
+        while ((read = SDL_ReadIO(file, chunk, sizeof(chunk))) > 0)
+            in.insert(in.end(), chunk, chunk + read);
+        SDL_CloseIO(file);
+
+        SnapshotReader r(in);
+        if (r.Read<uint32_t>() != FILE_MAGIC || r.Read<uint32_t>() != FILE_VERSION) {
+            SDL_Log("InputRecorder: %s isn't a recording of this version", path);
+            return false;
+        }
+        start.data.resize(r.Read<uint32_t>());
+        for (uint8_t &b : start.data)
+            r.Read(b);
+
+        frames.resize(r.Read<uint32_t>());
+        for (RecordedFrame_t &f : frames) {
+            r.Read(f.dt);
+            for (InputState_t &input : f.inputs)
+                r.Read(input.buttons);
+            r.Read(f.hash);
+        }
+        if (!r.IsOk()) {
+            SDL_Log("InputRecorder: %s is truncated", path);
+            frames.clear();
+            return false;
+        }
+        return true;
+    }
+};
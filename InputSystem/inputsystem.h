@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <SDL3/SDL_keyboard.h>
+#include <SDL3/SDL_scancode.h>
+#include "../Engine/enginecontext.h"
+
+enum InputButton_t : uint8_t {
+    INPUT_LEFT = 1,
+    INPUT_RIGHT = 2,
+    INPUT_JUMP = 4
+};
+
+// Everything a player reads in one simulation step. Small and trivially
+// copyable so it can be sent, recorded and compared as is.
+struct InputState_t {
+    uint8_t buttons = 0;
+
+    bool Down(uint8_t button) const {
+        return (buttons & button) != 0;
+    }
+
+    bool operator==(const InputState_t &other) const {
+        return buttons == other.buttons;
+    }
+
+    bool operator!=(const InputState_t &other) const {
+        return buttons != other.buttons;
+    }
+};
+
+// Per-step input of every player slot. Gameplay only reads from here, so
+// whatever fills the slots (keyboard, network peer, recording) drives the
+// simulation the same way.
+class InputSystem {
+    public:
+    static constexpr int MAX_SLOTS = 4;
+
+    private:
+    InputState_t slots[MAX_SLOTS];
+    bool keyboardEnabled = true;
+
+    InputSystem(const InputSystem&) = delete;
+    InputSystem& operator=(const InputSystem&) = delete;
+
+    friend class EngineContext;
+    InputSystem() {}
+
+    public:
+    static InputSystem& GetInstance() {
+        return EngineContext::Current().Get<InputSystem>();
+    }
+
+    // SDL's keyboard state, main thread only
+    static InputState_t ReadKeyboard() {
+        InputState_t state;
+        const bool *keys = SDL_GetKeyboardState(nullptr);
+        if (!keys)
+            return state;
+        if (keys[SDL_SCANCODE_A])
+            state.buttons |= INPUT_LEFT;
+        if (keys[SDL_SCANCODE_D])
+            state.buttons |= INPUT_RIGHT;
+        if (keys[SDL_SCANCODE_W])
+            state.buttons |= INPUT_JUMP;
+        return state;
+    }
+
+    // Once per simulation step, before the world updates. Slot 0 takes the
+    // keyboard state unless something else owns the slots (rollback,
+    // replay). The caller reads it with ReadKeyboard on the main thread.
+    void BeginStep(InputState_t keyboard) {
+        if (keyboardEnabled)
+            slots[0] = keyboard;
+    }
+
+    void SetKeyboardEnabled(bool enabled) {
+        keyboardEnabled = enabled;
+    }
+
+    bool IsKeyboardEnabled() const {
+        return keyboardEnabled;
+    }
+
+    void Set(int slot, InputState_t state) {
+        if (slot >= 0 && slot < MAX_SLOTS)
+            slots[slot] = state;
+    }
+
+    InputState_t Get(int slot) const {
+        return slot >= 0 && slot < MAX_SLOTS ? slots[slot] : InputState_t();
+    }
+};
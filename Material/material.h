@@ -2,7 +2,9 @@
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_render.h>
+#ifndef HEADLESS
 #include <SDL3_image/SDL_image.h>
+#endif
 #include <string>
 #include "../Screen/screen.h"
 
@@ -14,13 +16,26 @@ private:
     SDL_Surface* surface = nullptr;
     SDL_Texture* texture = nullptr;
 
+    // Where the image sits in a shared atlas page, see TextureAtlas
+    SDL_Texture* atlasTexture = nullptr;
+    float atlasX = 0.0f, atlasY = 0.0f;
+    float atlasSize = 0.0f;     // the page is square, kept so nobody asks the renderer
+
 public:
     Material(const char* path) : path(path) {} 
     ~Material() { Unload(); }
 
+    // Without a renderer (headless) only the image size is read, entities
+    // still get a valid source rectangle to clip against
     bool Load() {
         Unload();
 
+        if (!Screen::GetInstance().GetRenderer())
+            return LoadMetadata();
+
+        #ifdef HEADLESS
+        return LoadMetadata();
+        #else
         surface = IMG_Load(path.c_str());
         if (!surface) {
             SDL_Log("Failed to load image: %s", path.c_str());
@@ -40,9 +55,53 @@ public:
         surface = nullptr;
 
         return true;
+        #endif
+    }
+
+    // From pixels made at runtime instead of a file, the surface stays the
+    // caller's. Used by benchmarks that can't rely on image files.
+    bool LoadFromSurface(SDL_Surface *image) {
+        Unload();
+        width = image->w;
+        height = image->h;
+
+        SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
+        if (!renderer)
+            return true;
+        texture = SDL_CreateTextureFromSurface(renderer, image);
+        if (!texture) {
+            SDL_Log("Failed to create texture for %s : %s", path.c_str(), SDL_GetError());
+            return false;
+        }
+        return true;
+    }
+
+    // Reads width and height from the PNG header without decoding pixels
+    bool LoadMetadata() {
+        SDL_IOStream *file = SDL_IOFromFile(path.c_str(), "rb");
+        if (!file) {
+            SDL_Log("Failed to open image: %s", path.c_str());
+            return false;
+        }
+
+        // Signature (8) + IHDR length and type (8) + width (4) + height (4)
+        Uint8 header[24];
+        bool ok = SDL_ReadIO(file, header, sizeof(header)) == sizeof(header);
+        SDL_CloseIO(file);
+
+        static const Uint8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        if (!ok || SDL_memcmp(header, signature, sizeof(signature)) != 0) {
+            SDL_Log("Only PNG metadata can be read without a renderer: %s", path.c_str());
+            return false;
+        }
+
+        width = ((Uint32)header[16] << 24) | ((Uint32)header[17] << 16) | ((Uint32)header[18] << 8) | header[19];
+        height = ((Uint32)header[20] << 24) | ((Uint32)header[21] << 16) | ((Uint32)header[22] << 8) | header[23];
+        return true;
     }
 
     void Unload() {
+        ClearAtlasRegion();
         if (texture) {
             SDL_DestroyTexture(texture);
             texture = nullptr;
@@ -55,6 +114,30 @@ public:
     }
 
     SDL_Texture* GetTexture() const { return texture; }
+
+    void SetAtlasRegion(SDL_Texture *atlas, float x, float y, float pageSize) {
+        atlasTexture = atlas;
+        atlasX = x;
+        atlasY = y;
+        atlasSize = pageSize;
+    }
+    void ClearAtlasRegion() { atlasTexture = nullptr; }
+    bool IsInAtlas() const { return atlasTexture != nullptr; }
+
+    // What sprites draw from: the atlas page when packed, the own texture
+    // otherwise. Regions stay in image coordinates, DrawRegion moves them
+    // onto the page.
+    SDL_Texture* GetDrawTexture() const { return atlasTexture ? atlasTexture : texture; }
+    // Size of GetDrawTexture without a renderer call, safe off the main thread
+    void GetDrawTextureSize(float &w, float &h) const {
+        w = atlasTexture ? atlasSize : (float)width;
+        h = atlasTexture ? atlasSize : (float)height;
+    }
+    SDL_FRect DrawRegion(const SDL_FRect &region) const {
+        if (!atlasTexture)
+            return region;
+        return {region.x + atlasX, region.y + atlasY, region.w, region.h};
+    }
     const std::string& GetPath() const { return path; }
     void SetPath(char *path) { this->path = path; }
     unsigned int GetWidth() const { return width; }
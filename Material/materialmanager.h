@@ -4,17 +4,26 @@
 #include <memory>
 #include <vector>
 #include "material.h"
+#include "textureatlas.h"
+#include "../Engine/enginecontext.h"
 
 class MaterialManager {
 private:
     std::map<std::string, std::unique_ptr<Material>> materials;
+    std::vector<Material*> loadOrder;
+
+    // Atlas mode: materials draw from shared pages instead of their own
+    // textures. Declared after materials so pages go first on teardown.
+    TextureAtlas atlas;
+    bool atlasEnabled = false;
+    bool atlasDirty = false;    // materials were loaded since the last build
     
+    friend class EngineContext;
     MaterialManager() {}
     
 public:
     static MaterialManager& GetInstance() {
-        static MaterialManager instance;
-        return instance;
+        return EngineContext::Current().Get<MaterialManager>();
     }
     
     Material* LoadMaterial(const std::string& name, const char* path) {
@@ -27,11 +36,32 @@ public:
         if (material->Load()) {
             Material* ptr = material.get();
             materials[name] = std::move(material);
+            loadOrder.push_back(ptr);
+            // A build decodes every image again, so a level's worth of loads
+            // shares one in UpdateAtlas. Until then it draws from its own texture.
+            if (atlasEnabled)
+                atlasDirty = true;
             return ptr;
         }
         return nullptr;
     }
     
+    // Like LoadMaterial for generated images, the name doubles as the path
+    Material* AddMaterial(const std::string& name, SDL_Surface* image) {
+        auto it = materials.find(name);
+        if (it != materials.end()) {
+            return it->second.get();
+        }
+
+        auto material = std::make_unique<Material>(name.c_str());
+        if (!material->LoadFromSurface(image))
+            return nullptr;
+        Material* ptr = material.get();
+        materials[name] = std::move(material);
+        loadOrder.push_back(ptr);
+        return ptr;
+    }
+
     Material* GetMaterial(const std::string& name) {
         auto it = materials.find(name);
         return (it != materials.end()) ? it->second.get() : nullptr;
@@ -45,7 +75,67 @@ public:
         return names;
     }
     
+    // Reverse lookup, empty if the material isn't managed here
+    std::string GetMaterialName(const Material* material) const {
+        for (const auto& pair : materials) {
+            if (pair.second.get() == material)
+                return pair.first;
+        }
+        return "";
+    }
+
+    // Position in load order, -1 if unmanaged. Processes that load the same
+    // materials in the same order agree on it, unlike on pointers.
+    int32_t GetMaterialIndex(const Material* material) const {
+        if (!material)
+            return -1;
+        for (size_t i = 0; i < loadOrder.size(); i++) {
+            if (loadOrder[i] == material)
+                return (int32_t)i;
+        }
+        return -1;
+    }
+
+    Material* GetMaterialByIndex(int32_t index) const {
+        return index >= 0 && index < (int32_t)loadOrder.size() ? loadOrder[index] : nullptr;
+    }
+
+    // Packs every loaded material, and later loads, into atlas pages of at
+    // most pageSize. False when there is nothing to build them with
+    // (headless).
+    bool EnableAtlas(int pageSize = 2048) {
+        atlasEnabled = true;
+        atlasDirty = false;
+        atlas.SetPageSize(pageSize);
+        return atlas.Build(loadOrder);
+    }
+
+    void DisableAtlas() {
+        atlasEnabled = false;
+        atlasDirty = false;
+        atlas.Clear(loadOrder);
+    }
+
+    // Repacks once if materials were loaded since the last build. Call
+    // once per frame before drawing, pages of the old build are destroyed.
+    void UpdateAtlas() {
+        if (!atlasEnabled || !atlasDirty)
+            return;
+        atlasDirty = false;
+        atlas.Build(loadOrder);
+    }
+
+    bool IsAtlasEnabled() const {
+        return atlasEnabled;
+    }
+
+    const TextureAtlas& GetAtlas() const {
+        return atlas;
+    }
+
     void UnloadAll() {
+        atlas.Clear(loadOrder);
+        loadOrder.clear();
         materials.clear();
     }
 };
\ No newline at end of file
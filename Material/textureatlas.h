@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_render.h>
+#ifndef HEADLESS
+#include <SDL3_image/SDL_image.h>
+#endif
+#include "material.h"
+#include "../Screen/screen.h"
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../imstb_rectpack.h"
+
+struct AtlasPlacement_t {
+    int page = -1;      // -1 when the image is larger than a page
+    int x = 0, y = 0;
+};
+
+struct AtlasPage_t {
+    SDL_Texture *texture = nullptr;
+    int size = 0;
+    long long usedArea = 0;     // pixels covered by images, padding excluded
+    int images = 0;
+};
+
+// Packs whole material images into a few large textures so sprites from
+// different sheets can share a SpriteBatch run. Materials keep their own
+// texture for the editor and point at their spot on a page for drawing.
+class TextureAtlas {
+    private:
+    std::vector<AtlasPage_t> pages;
+    int pageSize = 2048;
+    int padding = 2;            // transparent gap so filtering doesn't bleed between images
+    int unpacked = 0;
+
+    static bool PackPage(int size, std::vector<stbrp_rect> &rects, std::vector<stbrp_node> &nodes) {
+        nodes.resize(size);
+        stbrp_context context;
+        stbrp_init_target(&context, size, size, nodes.data(), size);
+        return stbrp_pack_rects(&context, rects.data(), (int)rects.size()) == 1;
+    }
+
+    public:
+    ~TextureAtlas() {
+        Clear();
+    }
+
+    // Page and position for each size, pages filled one after the other.
+    // The last page shrinks to the smallest power of two that still fits.
+    static std::vector<AtlasPlacement_t> Pack(const std::vector<SDL_Point> &sizes, int pageSize, int padding,
+                                              std::vector<int> &pageSizes) {
+        std::vector<AtlasPlacement_t> out(sizes.size());
+        std::vector<stbrp_rect> rects;
+        std::vector<stbrp_node> nodes;
+        for (size_t i = 0; i < sizes.size(); i++) {
+            if (sizes[i].x + padding > pageSize || sizes[i].y + padding > pageSize)
+                continue;
+            stbrp_rect r = {};
+            r.id = (int)i;
+            r.w = sizes[i].x + padding;
+            r.h = sizes[i].y + padding;
+            rects.push_back(r);
+        }
+
+        pageSizes.clear();
+        while (!rects.empty()) {
+            int size = pageSize;
+            if (PackPage(size, rects, nodes)) {
+                while (size > 64 && PackPage(size / 2, rects, nodes))
+                    size /= 2;
+                PackPage(size, rects, nodes);
+            }
+
+            int page = (int)pageSizes.size();
+            pageSizes.push_back(size);
+            std::vector<stbrp_rect> rest;
+            for (const stbrp_rect &r : rects) {
+                if (r.was_packed)
+                    out[r.id] = {page, r.x, r.y};
+                else
+                    rest.push_back(r);
+            }
+            rects.swap(rest);
+        }
+        return out;
+    }
+
+    // Repacks all materials with a texture. Without a renderer nothing is
+    // built and materials keep drawing from their own textures.
+    bool Build(const std::vector<Material*> &materials) {
+        Clear(materials);
+        SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
+        if (!renderer)
+            return false;
+
+        #ifdef HEADLESS
+        return false;
+        #else
+        // Textures don't give their pixels back, decode the files again
+        std::vector<Material*> sources;
+        std::vector<SDL_Surface*> images;
+        std::vector<SDL_Point> sizes;
+        for (Material *m : materials) {
+            if (!m->GetTexture())
+                continue;
+            SDL_Surface *loaded = IMG_Load(m->GetPath().c_str());
+            SDL_Surface *image = loaded ? SDL_ConvertSurface(loaded, SDL_PIXELFORMAT_RGBA32) : nullptr;
+            if (loaded)
+                SDL_DestroySurface(loaded);
+            if (!image) {
+                SDL_Log("TextureAtlas: couldn't read %s, it keeps its own texture", m->GetPath().c_str());
+                continue;
+            }
+            sources.push_back(m);
+            images.push_back(image);
+            sizes.push_back({image->w, image->h});
+        }
+
+        std::vector<int> pageSizes;
+        std::vector<AtlasPlacement_t> placements = Pack(sizes, pageSize, padding, pageSizes);
+
+        std::vector<SDL_Surface*> surfaces;
+        for (int size : pageSizes) {
+            surfaces.push_back(SDL_CreateSurface(size, size, SDL_PIXELFORMAT_RGBA32));
+            AtlasPage_t page;
+            page.size = size;
+            pages.push_back(page);
+        }
+
+        for (size_t i = 0; i < images.size(); i++) {
+            const AtlasPlacement_t &p = placements[i];
+            if (p.page < 0 || !surfaces[p.page]) {
+                unpacked++;
+                continue;
+            }
+            // Copy alpha as is instead of blending onto the empty page
+            SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE);
+            SDL_Rect dst = {p.x, p.y, images[i]->w, images[i]->h};
+            SDL_BlitSurface(images[i], nullptr, surfaces[p.page], &dst);
+            pages[p.page].usedArea += (long long)images[i]->w * images[i]->h;
+            pages[p.page].images++;
+        }
+
+        for (size_t p = 0; p < pages.size(); p++) {
+            if (surfaces[p]) {
+                pages[p].texture = SDL_CreateTextureFromSurface(renderer, surfaces[p]);
+                SDL_DestroySurface(surfaces[p]);
+            }
+            if (!pages[p].texture)
+                SDL_Log("TextureAtlas: couldn't create page %zu: %s", p, SDL_GetError());
+        }
+
+        for (size_t i = 0; i < sources.size(); i++) {
+            const AtlasPlacement_t &p = placements[i];
+            if (p.page >= 0 && pages[p.page].texture)
+                sources[i]->SetAtlasRegion(pages[p.page].texture, (float)p.x, (float)p.y, (float)pages[p.page].size);
+            SDL_DestroySurface(images[i]);
+        }
+        return true;
+        #endif
+    }
+
+    // Pages are freed, materials go back to their own textures
+    void Clear(const std::vector<Material*> &materials = {}) {
+        for (Material *m : materials)
+            m->ClearAtlasRegion();
+        for (AtlasPage_t &page : pages) {
+            if (page.texture)
+                SDL_DestroyTexture(page.texture);
+        }
+        pages.clear();
+        unpacked = 0;
+    }
+
+    void SetPageSize(int size) {
+        pageSize = std::max(size, 64);
+    }
+
+    int GetPageSize() const {
+        return pageSize;
+    }
+
+    const std::vector<AtlasPage_t>& GetPages() const {
+        return pages;
+    }
+
+    // Share of page pixels covered by images, over all pages
+    double GetOccupancy() const {
+        long long used = 0, total = 0;
+        for (const AtlasPage_t &page : pages) {
+            used += page.usedArea;
+            total += (long long)page.size * page.size;
+        }
+        return total ? (double)used / (double)total : 0.0;
+    }
+
+    // Images too large for a page, drawn from their own textures
+    int GetUnpackedCount() const {
+        return unpacked;
+    }
+};
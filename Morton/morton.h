@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include "../Vector2/vector2.h"
+
+// Z-order (Morton) codes: interleaving the bits of x and y keeps points that
+// are close in 2D mostly close in the 1D order.
+namespace Morton {
+    // Spreads the low 21 bits of v so there is a zero bit between each
+    inline uint64_t Part1By1(uint64_t v) {
+        v &= 0x1fffff;
+        v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+        v = (v | (v << 8))  & 0x00ff00ff00ff00ffull;
+        v = (v | (v << 4))  & 0x0f0f0f0f0f0f0f0full;
+        v = (v | (v << 2))  & 0x3333333333333333ull;
+        v = (v | (v << 1))  & 0x5555555555555555ull;
+        return v;
+    }
+
+    inline uint64_t Encode(uint32_t x, uint32_t y) {
+        return Part1By1(x) | (Part1By1(y) << 1);
+    }
+
+    // Quantizes a world position to cells of cellSize, centered so negative
+    // coordinates keep their order
+    inline uint64_t Encode(Vector2 position, float cellSize) {
+        const int64_t bias = 1 << 20;
+        int64_t x = (int64_t)std::floor(position.x / cellSize) + bias;
+        int64_t y = (int64_t)std::floor(position.y / cellSize) + bias;
+        x = x < 0 ? 0 : (x > 0x1fffff ? 0x1fffff : x);
+        y = y < 0 ? 0 : (y > 0x1fffff ? 0x1fffff : y);
+        return Encode((uint32_t)x, (uint32_t)y);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Engine/enginecontext.h"
+
+// Interned strings for entity names and tags. Names map to a small id so
+// entities store 4 bytes and lookups compare integers, id 0 is "no name".
+// Tags map to a bit, at most 64 of them.
+class NameTable {
+    private:
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> tags;
+
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    friend class EngineContext;
+    NameTable() {
+        names.emplace_back();
+    }
+
+    public:
+    static NameTable& GetInstance() {
+        return EngineContext::Current().Get<NameTable>();
+    }
+
+    uint32_t Intern(const std::string &name) {
+        if (name.empty())
+            return 0;
+        auto it = ids.find(name);
+        if (it != ids.end())
+            return it->second;
+        uint32_t id = (uint32_t)names.size();
+        names.push_back(name);
+        ids.emplace(name, id);
+        return id;
+    }
+
+    // Like Intern but never adds, 0 when the name was never used
+    uint32_t Find(const std::string &name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? 0 : it->second;
+    }
+
+    const std::string& GetName(uint32_t id) const {
+        return id < names.size() ? names[id] : names[0];
+    }
+
+    // Bit mask of a named tag, registers it on first use
+    uint64_t Tag(const char *name) {
+        for (size_t i = 0; i < tags.size(); i++) {
+            if (tags[i] == name)
+                return 1ull << i;
+        }
+        if (tags.size() == 64) {
+            SDL_Log("NameTable: too many tags, '%s' is ignored", name);
+            return 0;
+        }
+        tags.push_back(name);
+        return 1ull << (tags.size() - 1);
+    }
+
+    const std::vector<std::string>& GetTags() const {
+        return tags;
+    }
+};
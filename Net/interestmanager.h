@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include "../CollisionSystem/collisionsystem.h"
+
+// One ring of interest around a viewer. Entities inside radius are sent
+// every interval ticks, tiers are checked nearest first.
+struct InterestTier_t {
+    float radius;
+    int interval;
+};
+
+// Area of interest per viewer, on the collision grid's cells. Entities are
+// only re-bucketed when they cross a cell. A viewer's relevant set is
+// rebuilt when the viewer itself changes cell, otherwise it is patched from
+// the tick's crossings, so the per viewer cost follows what moved and not
+// how many entities there are. Radii are rounded up to whole cells.
+class InterestManager {
+    private:
+    struct Tracked {
+        int32_t cx, cy;
+        uint32_t generation;
+    };
+
+    struct Crossing {
+        uint32_t id;
+        bool hasFrom, hasTo;
+        int32_t fromX, fromY;
+        int32_t toX, toY;
+    };
+
+    struct Viewer {
+        bool active = false;
+        bool placed = false;
+        bool rebuild = true;
+        Vector2 position;
+        int32_t cx = 0, cy = 0;
+        std::unordered_map<uint32_t, uint8_t> relevant;    // id -> tier
+        std::vector<uint32_t> entered;
+        std::vector<uint32_t> left;
+    };
+
+    std::vector<InterestTier_t> tiers;
+    std::vector<int32_t> tierCells;
+    float cellSize = 0.0f;
+
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+    std::unordered_map<uint32_t, Tracked> tracked;
+    std::vector<Crossing> crossings;
+    std::vector<Viewer> viewers;
+    std::unordered_map<uint32_t, uint8_t> rebuildScratch;
+    uint32_t generation = 0;
+    double lastUpdateMs = 0.0;
+
+    static uint64_t CellKey(int32_t cx, int32_t cy) {
+        return ((uint64_t)(uint32_t)cx << 32) | (uint32_t)cy;
+    }
+
+    void RemoveFromCell(uint32_t id, int32_t cx, int32_t cy) {
+        auto it = cells.find(CellKey(cx, cy));
+        if (it == cells.end())
+            return;
+        std::vector<uint32_t> &ids = it->second;
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (ids[i] == id) {
+                ids[i] = ids.back();
+                ids.pop_back();
+                break;
+            }
+        }
+        if (ids.empty())
+            cells.erase(it);
+    }
+
+    // Nearest tier for a cell offset, -1 when out of range
+    int TierOf(int32_t dx, int32_t dy) const {
+        int32_t d = std::max(std::abs(dx), std::abs(dy));
+        for (size_t t = 0; t < tierCells.size(); t++) {
+            if (d <= tierCells[t])
+                return (int)t;
+        }
+        return -1;
+    }
+
+    void Rebuild(Viewer &v) {
+        rebuildScratch.clear();
+        int32_t range = tierCells.empty() ? -1 : tierCells.back();
+        for (int32_t y = v.cy - range; y <= v.cy + range; y++) {
+            for (int32_t x = v.cx - range; x <= v.cx + range; x++) {
+                auto it = cells.find(CellKey(x, y));
+                if (it == cells.end())
+                    continue;
+                uint8_t tier = (uint8_t)TierOf(x - v.cx, y - v.cy);
+                for (uint32_t id : it->second)
+                    rebuildScratch[id] = tier;
+            }
+        }
+
+        for (const auto &[id, tier] : rebuildScratch) {
+            if (!v.relevant.count(id))
+                v.entered.push_back(id);
+        }
+        for (const auto &[id, tier] : v.relevant) {
+            if (!rebuildScratch.count(id))
+                v.left.push_back(id);
+        }
+        v.relevant.swap(rebuildScratch);
+    }
+
+    void Patch(Viewer &v) {
+        for (const Crossing &c : crossings) {
+            int tier = c.hasTo ? TierOf(c.toX - v.cx, c.toY - v.cy) : -1;
+            if (tier >= 0) {
+                auto [it, inserted] = v.relevant.try_emplace(c.id, (uint8_t)tier);
+                if (inserted)
+                    v.entered.push_back(c.id);
+                else
+                    it->second = (uint8_t)tier;
+            } else if (c.hasFrom && v.relevant.erase(c.id)) {
+                v.left.push_back(c.id);
+            }
+        }
+    }
+
+    public:
+    // Replaces the tiers, every viewer is rebuilt on the next Update
+    void SetTiers(std::vector<InterestTier_t> newTiers) {
+        std::sort(newTiers.begin(), newTiers.end(), [](const InterestTier_t &a, const InterestTier_t &b) {
+            return a.radius < b.radius;
+        });
+        tiers = std::move(newTiers);
+        cellSize = 0.0f;
+    }
+
+    const std::vector<InterestTier_t>& GetTiers() const {
+        return tiers;
+    }
+
+    int AddViewer() {
+        for (size_t i = 0; i < viewers.size(); i++) {
+            if (!viewers[i].active) {
+                viewers[i] = Viewer();
+                viewers[i].active = true;
+                return (int)i;
+            }
+        }
+        viewers.emplace_back();
+        viewers.back().active = true;
+        return (int)viewers.size() - 1;
+    }
+
+    void RemoveViewer(int viewer) {
+        viewers[viewer] = Viewer();
+    }
+
+    void SetViewpoint(int viewer, Vector2 position) {
+        viewers[viewer].position = position;
+        viewers[viewer].placed = true;
+    }
+
+    // Re-buckets entities that crossed a cell, then updates every viewer.
+    // Entities without an id are ignored.
+    void Update(const std::vector<Entity*> &entities) {
+        Uint64 start = SDL_GetTicksNS();
+        CollisionSystem &grid = CollisionSystem::GetInstance();
+
+        // Cell size or tiers changed, start over
+        if (cellSize != grid.GetCellSize()) {
+            cellSize = grid.GetCellSize();
+            tierCells.clear();
+            for (const InterestTier_t &t : tiers)
+                tierCells.push_back((int32_t)std::ceil(t.radius / cellSize));
+            cells.clear();
+            tracked.clear();
+            for (Viewer &v : viewers)
+                v.rebuild = true;
+        }
+
+        generation++;
+        crossings.clear();
+        size_t seen = 0;
+        for (Entity *e : entities) {
+            uint32_t id = e->GetId();
+            if (!id)
+                continue;
+            seen++;
+
+            Vector2 p = e->GetPosition();
+            int32_t cx = grid.CellOf(p.x);
+            int32_t cy = grid.CellOf(p.y);
+            auto [it, inserted] = tracked.try_emplace(id, Tracked{cx, cy, generation});
+            if (inserted) {
+                cells[CellKey(cx, cy)].push_back(id);
+                crossings.push_back({id, false, true, 0, 0, cx, cy});
+                continue;
+            }
+
+            Tracked &t = it->second;
+            t.generation = generation;
+            if (t.cx == cx && t.cy == cy)
+                continue;
+            RemoveFromCell(id, t.cx, t.cy);
+            cells[CellKey(cx, cy)].push_back(id);
+            crossings.push_back({id, true, true, t.cx, t.cy, cx, cy});
+            t.cx = cx;
+            t.cy = cy;
+        }
+
+        // Someone left the world
+        if (seen != tracked.size()) {
+            for (auto it = tracked.begin(); it != tracked.end();) {
+                if (it->second.generation == generation) {
+                    ++it;
+                    continue;
+                }
+                RemoveFromCell(it->first, it->second.cx, it->second.cy);
+                crossings.push_back({it->first, true, false, it->second.cx, it->second.cy, 0, 0});
+                it = tracked.erase(it);
+            }
+        }
+
+        for (Viewer &v : viewers) {
+            v.entered.clear();
+            v.left.clear();
+            if (!v.active || !v.placed)
+                continue;
+
+            int32_t cx = grid.CellOf(v.position.x);
+            int32_t cy = grid.CellOf(v.position.y);
+            if (v.rebuild || cx != v.cx || cy != v.cy) {
+                v.cx = cx;
+                v.cy = cy;
+                v.rebuild = false;
+                Rebuild(v);
+            } else {
+                Patch(v);
+            }
+        }
+
+        lastUpdateMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    // Relevant entities of a viewer and their tier
+    const std::unordered_map<uint32_t, uint8_t>& GetRelevant(int viewer) const {
+        return viewers[viewer].relevant;
+    }
+
+    // Entities that became relevant / stopped being relevant in the last Update
+    const std::vector<uint32_t>& GetEntered(int viewer) const {
+        return viewers[viewer].entered;
+    }
+
+    const std::vector<uint32_t>& GetLeft(int viewer) const {
+        return viewers[viewer].left;
+    }
+
+    // Whether an entity of a tier is sent on this tick, spread by id so a
+    // tier's updates don't all land on the same tick
+    bool IsDue(uint8_t tier, uint32_t id, uint32_t tick) const {
+        int interval = tiers[tier].interval;
+        return interval <= 1 || (tick + id) % (uint32_t)interval == 0;
+    }
+
+    size_t GetLastCrossingCount() const {
+        return crossings.size();
+    }
+
+    double GetLastUpdateMs() const {
+        return lastUpdateMs;
+    }
+};
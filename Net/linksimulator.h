@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "udpsocket.h"
+
+struct LinkSettings_t {
+    double latencyMs = 0.0;     // one way
+    double jitterMs = 0.0;      // added uniformly in [0, jitter), reorders packets
+    double loss = 0.0;          // 0..1
+};
+
+// Sits in front of a socket's sends and delays or drops packets, so
+// replication can be tested over loopback under bad network conditions.
+// Time is passed in by the caller, a benchmark can run faster than real
+// time and still see the configured latency in simulation ticks.
+class LinkSimulator {
+    private:
+    struct Packet {
+        uint64_t deliverNS;
+        uint64_t order;
+        NetAddress_t to;
+        std::vector<uint8_t> data;
+    };
+
+    UdpSocket &socket;
+    LinkSettings_t settings;
+    std::vector<Packet> queue;      // min-heap on deliverNS
+    uint64_t rng;
+    uint64_t sendCount = 0;
+    uint64_t dropped = 0;
+
+    double Random() {
+        // xorshift64*, deterministic for a given seed
+        rng ^= rng >> 12;
+        rng ^= rng << 25;
+        rng ^= rng >> 27;
+        return (double)((rng * 2685821657736338717ull) >> 11) / (double)(1ull << 53);
+    }
+
+    static bool Later(const Packet &a, const Packet &b) {
+        return a.deliverNS != b.deliverNS ? a.deliverNS > b.deliverNS : a.order > b.order;
+    }
+
+    public:
+    LinkSimulator(UdpSocket &socket, uint64_t seed = 1) : socket(socket), rng(seed ? seed : 1) {}
+
+    void SetSettings(const LinkSettings_t &s) {
+        settings = s;
+    }
+
+    const LinkSettings_t& GetSettings() const {
+        return settings;
+    }
+
+    void Send(const NetAddress_t &to, const uint8_t *data, size_t size, uint64_t nowNS) {
+        sendCount++;
+        if (settings.loss > 0.0 && Random() < settings.loss) {
+            dropped++;
+            return;
+        }
+
+        double delayMs = settings.latencyMs + settings.jitterMs * Random();
+        if (delayMs <= 0.0) {
+            socket.Send(to, data, size);
+            return;
+        }
+
+        queue.push_back({nowNS + (uint64_t)(delayMs * 1e6), sendCount, to, std::vector<uint8_t>(data, data + size)});
+        std::push_heap(queue.begin(), queue.end(), Later);
+    }
+
+    // Hands every packet that is due to the socket
+    void Pump(uint64_t nowNS) {
+        while (!queue.empty() && queue.front().deliverNS <= nowNS) {
+            std::pop_heap(queue.begin(), queue.end(), Later);
+            Packet &p = queue.back();
+            socket.Send(p.to, p.data.data(), p.data.size());
+            queue.pop_back();
+        }
+    }
+
+    uint64_t GetDropped() const { return dropped; }
+    uint64_t GetSent() const { return sendCount; }
+    size_t GetInFlight() const { return queue.size(); }
+};
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../Entity/entity.h"
+#include "../SpriteEntity/spriteentity.h"
+#include "../Material/materialmanager.h"
+
+// Byte-aligned packet writer with LEB128 varints
+class NetWriter {
+    private:
+    std::vector<uint8_t> &out;
+
+    public:
+    NetWriter(std::vector<uint8_t> &out) : out(out) { out.clear(); }
+
+    void U8(uint8_t v) { out.push_back(v); }
+
+    void U16(uint16_t v) {
+        out.push_back((uint8_t)v);
+        out.push_back((uint8_t)(v >> 8));
+    }
+
+    void U32(uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            out.push_back((uint8_t)(v >> (i * 8)));
+    }
+
+    void U64(uint64_t v) {
+        U32((uint32_t)v);
+        U32((uint32_t)(v >> 32));
+    }
+
+    void Varint(uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    // Zigzag so small negative numbers stay short
+    void SignedVarint(int64_t v) {
+        Varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+    }
+
+    void F32(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        U32(bits);
+    }
+
+    void String(const std::string &s) {
+        Varint(s.size());
+        out.insert(out.end(), s.begin(), s.end());
+    }
+
+    size_t Size() const { return out.size(); }
+
+    // Drops everything written after size
+    void Truncate(size_t size) { out.resize(size); }
+};
+
+class NetReader {
+    private:
+    const uint8_t *data;
+    size_t size;
+    size_t pos = 0;
+    bool ok = true;
+
+    bool Need(size_t bytes) {
+        if (pos + bytes > size)
+            ok = false;
+        return ok;
+    }
+
+    public:
+    NetReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+    uint8_t U8() { return Need(1) ? data[pos++] : 0; }
+
+    uint16_t U16() {
+        if (!Need(2))
+            return 0;
+        uint16_t v = (uint16_t)(data[pos] | (data[pos + 1] << 8));
+        pos += 2;
+        return v;
+    }
+
+    uint32_t U32() {
+        if (!Need(4))
+            return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++)
+            v |= (uint32_t)data[pos + i] << (i * 8);
+        pos += 4;
+        return v;
+    }
+
+    uint64_t U64() {
+        uint64_t low = U32();
+        return low | ((uint64_t)U32() << 32);
+    }
+
+    uint64_t Varint() {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (!Need(1))
+                return 0;
+            uint8_t b = data[pos++];
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t SignedVarint() {
+        uint64_t v = Varint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    float F32() {
+        uint32_t bits = U32();
+        float v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    void String(std::string &s) {
+        uint64_t length = Varint();
+        if (!Need(length))
+            return;
+        s.assign((const char*)data + pos, length);
+        pos += length;
+    }
+
+    bool IsOk() const { return ok; }
+};
+
+// Fields of a replication record, a record carries the ones that changed
+enum NetField_t : uint8_t {
+    NET_NEW = 1,            // entity unknown to the client, all fields absolute
+    NET_POSITION = 2,
+    NET_VELOCITY = 4,
+    NET_SIZE = 8,
+    NET_REGION = 16,
+    NET_LOOK = 32,          // scale, color, flags
+    NET_MATERIAL = 64,
+    NET_ALL = 0x7e
+};
+
+// Packet types, first byte of every datagram
+enum NetMessage_t : uint8_t {
+    NET_MSG_HELLO = 1,      // client -> server, join, optional viewpoint
+    NET_MSG_SNAPSHOT = 2,   // server -> client
+    NET_MSG_ACK = 3         // client -> server, snapshot decoded, optional viewpoint
+};
+
+// Snapshots a delta can be based on. Acks older than this fall back to a
+// full snapshot.
+static constexpr uint32_t NET_HISTORY = 32;
+static constexpr size_t NET_MAX_PACKET = 65000;
+
+enum NetFlags_t : uint8_t {
+    NET_FLAG_STATIC = 1,
+    NET_FLAG_COLLISION = 2,
+    NET_FLAG_FLIPX = 4,
+    NET_FLAG_FLIPY = 8
+};
+
+// Quantized replicated state of one entity. Positions, velocities and sizes
+// are in 1/16 px, scale in 1/256. Server and client hold bit-identical
+// copies, so deltas against an acked state reproduce exactly.
+struct NetEntityState_t {
+    uint32_t id = 0;
+    uint8_t type = 0;
+    uint8_t flags = 0;
+    int32_t x = 0, y = 0;
+    int32_t vx = 0, vy = 0;
+    int32_t w = 0, h = 0;
+    int16_t region[4] = {0, 0, 0, 0};
+    uint16_t scale = 256;
+    Color color;
+    // Each side's own pointer, only ever compared on the server
+    const Material *material = nullptr;
+};
+
+namespace NetState {
+    static constexpr float POSITION_STEPS = 16.0f;
+    static constexpr float SCALE_STEPS = 256.0f;
+
+    // Types that derive from SpriteEntity and replicate its region, flip and
+    // material. Tilemaps only replicate the base entity state, not tiles.
+    inline bool IsSpriteType(uint8_t type) {
+        return type >= (uint8_t)EntityType::SPRITE_ENTITY && type <= (uint8_t)EntityType::PLAYER;
+    }
+
+    inline int32_t Quantize(float v, float steps) {
+        return (int32_t)std::lround(v * steps);
+    }
+
+    inline NetEntityState_t Capture(const Entity *e) {
+        NetEntityState_t s;
+        s.id = e->GetId();
+        s.type = (uint8_t)e->GetType();
+        Vector2 pos = e->GetPosition();
+        Vector2 vel = e->GetVelocity();
+        Vector2 size = e->GetSize();
+        s.x = Quantize(pos.x, POSITION_STEPS);
+        s.y = Quantize(pos.y, POSITION_STEPS);
+        s.vx = Quantize(vel.x, POSITION_STEPS);
+        s.vy = Quantize(vel.y, POSITION_STEPS);
+        s.w = Quantize(size.x, POSITION_STEPS);
+        s.h = Quantize(size.y, POSITION_STEPS);
+        s.scale = (uint16_t)Quantize(e->GetScale(), SCALE_STEPS);
+        s.color = e->GetColor();
+
+        s.flags = (e->IsStatic() ? NET_FLAG_STATIC : 0) | (e->GetHasCollision() ? NET_FLAG_COLLISION : 0);
+
+        if (IsSpriteType(s.type)) {
+            const SpriteEntity *sprite = static_cast<const SpriteEntity*>(e);
+            SDL_FRect r = sprite->GetRegion();
+            s.region[0] = (int16_t)r.x;
+            s.region[1] = (int16_t)r.y;
+            s.region[2] = (int16_t)r.w;
+            s.region[3] = (int16_t)r.h;
+            s.flags |= (sprite->GetFlipX() ? NET_FLAG_FLIPX : 0) | (sprite->GetFlipY() ? NET_FLAG_FLIPY : 0);
+            s.material = sprite->GetMaterial();
+        }
+        return s;
+    }
+
+    inline void Apply(Entity *e, const NetEntityState_t &s) {
+        e->SetPosition({s.x / POSITION_STEPS, s.y / POSITION_STEPS});
+        e->SetVelocity({s.vx / POSITION_STEPS, s.vy / POSITION_STEPS});
+        e->SetSize({s.w / POSITION_STEPS, s.h / POSITION_STEPS});
+        e->SetScale(s.scale / SCALE_STEPS);
+        e->SetColor(s.color);
+        e->SetStatic(s.flags & NET_FLAG_STATIC);
+        e->SetCollision(s.flags & NET_FLAG_COLLISION);
+
+        if (IsSpriteType((uint8_t)e->GetType())) {
+            SpriteEntity *sprite = static_cast<SpriteEntity*>(e);
+            sprite->SetRegion(s.region[0], s.region[1], s.region[2], s.region[3]);
+            sprite->SetFlip(s.flags & NET_FLAG_FLIPX, s.flags & NET_FLAG_FLIPY);
+            sprite->SetMaterial(const_cast<Material*>(s.material));
+        }
+    }
+
+    // Fields that differ between two states of the same entity
+    inline uint8_t Diff(const NetEntityState_t &a, const NetEntityState_t &b) {
+        uint8_t mask = 0;
+        if (a.x != b.x || a.y != b.y)
+            mask |= NET_POSITION;
+        if (a.vx != b.vx || a.vy != b.vy)
+            mask |= NET_VELOCITY;
+        if (a.w != b.w || a.h != b.h)
+            mask |= NET_SIZE;
+        if (std::memcmp(a.region, b.region, sizeof(a.region)) != 0)
+            mask |= NET_REGION;
+        if (a.scale != b.scale || a.flags != b.flags || std::memcmp(&a.color, &b.color, sizeof(Color)) != 0)
+            mask |= NET_LOOK;
+        if (a.material != b.material)
+            mask |= NET_MATERIAL;
+        return mask;
+    }
+
+    // Positions and velocities are written relative to base when there is one
+    inline void WriteFields(NetWriter &w, const NetEntityState_t &s, const NetEntityState_t *base, uint8_t mask) {
+        if (mask & NET_NEW)
+            w.U8(s.type);
+        if (mask & NET_POSITION) {
+            w.SignedVarint((int64_t)s.x - (base ? base->x : 0));
+            w.SignedVarint((int64_t)s.y - (base ? base->y : 0));
+        }
+        if (mask & NET_VELOCITY) {
+            w.SignedVarint((int64_t)s.vx - (base ? base->vx : 0));
+            w.SignedVarint((int64_t)s.vy - (base ? base->vy : 0));
+        }
+        if (mask & NET_SIZE) {
+            w.SignedVarint(s.w);
+            w.SignedVarint(s.h);
+        }
+        if (mask & NET_REGION) {
+            for (int16_t v : s.region)
+                w.SignedVarint(v);
+        }
+        if (mask & NET_LOOK) {
+            w.U16(s.scale);
+            w.U8(s.flags);
+            w.F32(s.color.r);
+            w.F32(s.color.g);
+            w.F32(s.color.b);
+            w.F32(s.color.a);
+        }
+        if (mask & NET_MATERIAL)
+            w.String(s.material ? MaterialManager::GetInstance().GetMaterialName(s.material) : "");
+    }
+
+    // s holds the base state (or defaults for NET_NEW) and is updated in place
+    inline void ReadFields(NetReader &r, NetEntityState_t &s, uint8_t mask, std::string &scratch) {
+        if (mask & NET_NEW)
+            s.type = r.U8();
+        if (mask & NET_POSITION) {
+            s.x = (int32_t)((mask & NET_NEW ? 0 : s.x) + r.SignedVarint());
+            s.y = (int32_t)((mask & NET_NEW ? 0 : s.y) + r.SignedVarint());
+        }
+        if (mask & NET_VELOCITY) {
+            s.vx = (int32_t)((mask & NET_NEW ? 0 : s.vx) + r.SignedVarint());
+            s.vy = (int32_t)((mask & NET_NEW ? 0 : s.vy) + r.SignedVarint());
+        }
+        if (mask & NET_SIZE) {
+            s.w = (int32_t)r.SignedVarint();
+            s.h = (int32_t)r.SignedVarint();
+        }
+        if (mask & NET_REGION) {
+            for (int16_t &v : s.region)
+                v = (int16_t)r.SignedVarint();
+        }
+        if (mask & NET_LOOK) {
+            s.scale = r.U16();
+            s.flags = r.U8();
+            s.color.r = r.F32();
+            s.color.g = r.F32();
+            s.color.b = r.F32();
+            s.color.a = r.F32();
+        }
+        if (mask & NET_MATERIAL) {
+            r.String(scratch);
+            s.material = scratch.empty() ? nullptr : MaterialManager::GetInstance().GetMaterial(scratch);
+        }
+    }
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "../Engine/enginecontext.h"
+#include "replicationserver.h"
+#include "replicationclient.h"
+
+struct ReplicationBenchSettings_t {
+    int clients = 4;
+    int entities = 1000;
+    int seconds = 10;
+    int tickRate = 60;
+    float movingFraction = 0.25f;
+    LinkSettings_t link = {50.0, 10.0, 0.05};
+    float interestRadius = 0.0f;    // 0 sends every entity to every client
+};
+
+// Server and clients in one process, each in its own EngineContext and
+// talking over loopback UDP through a LinkSimulator. Time is simulated, so
+// latency is in ticks and the run goes as fast as the CPU allows. Logs
+// bandwidth and CPU per client per tick, then checks every client ended
+// up with the server's state. With an interest radius each client's
+// viewpoint wanders around the world and it should end up with exactly
+// the entities around it. False when a socket doesn't open or a client
+// ends up out of sync.
+inline bool RunReplicationLoopback(const ReplicationBenchSettings_t &settings) {
+    EngineContext serverContext;
+    std::vector<std::unique_ptr<EngineContext>> clientContexts;
+    std::vector<std::unique_ptr<ReplicationClient>> clients;
+    ReplicationServer server;
+
+    uint32_t rng = 12345;
+    auto random = [&rng]() {
+        rng = rng * 1664525u + 1013904223u;
+        return (float)(rng >> 8) / (float)(1u << 24);
+    };
+
+    std::vector<Entity*> movers;
+    {
+        EngineContext::Scope scope(serverContext);
+        World &world = World::GetInstance();
+        world.SetMaxEntities(settings.entities * 2);
+        for (int i = 0; i < settings.entities; i++) {
+            Entity *e = new Entity();
+            e->SetPosition({random() * 4000.0f, random() * 4000.0f});
+            e->SetSize({16.0f, 16.0f});
+            e->SetColor({random() * 255.0f, random() * 255.0f, random() * 255.0f, 255.0f});
+            if (random() < settings.movingFraction) {
+                e->SetVelocity({(random() - 0.5f) * 200.0f, (random() - 0.5f) * 200.0f});
+                movers.push_back(e);
+            } else {
+                e->SetStatic(true);
+            }
+            world.AddEntity(e);
+        }
+
+        if (!server.Start(0)) {
+            SDL_Log("Replication loopback: couldn't open the server socket");
+            return false;
+        }
+        server.SetLinkSettings(settings.link);
+        if (settings.interestRadius > 0.0f) {
+            float r = settings.interestRadius;
+            server.SetInterest({{r, 1}, {r * 1.5f, 2}, {r * 2.0f, 4}});
+        }
+    }
+
+    std::vector<Vector2> viewpoints, viewVelocities;
+
+    for (int i = 0; i < settings.clients; i++) {
+        clientContexts.push_back(std::make_unique<EngineContext>());
+        clients.push_back(std::make_unique<ReplicationClient>());
+        EngineContext::Scope scope(*clientContexts.back());
+        World::GetInstance().SetMaxEntities(settings.entities * 2);
+        if (!clients.back()->Connect(server.GetAddress())) {
+            SDL_Log("Replication loopback: couldn't open a client socket");
+            return false;
+        }
+        clients.back()->SetLinkSettings(settings.link);
+
+        viewpoints.push_back({random() * 4000.0f, random() * 4000.0f});
+        viewVelocities.push_back({(random() - 0.5f) * 300.0f, (random() - 0.5f) * 300.0f});
+        clients.back()->SetViewpoint(viewpoints.back());
+    }
+
+    SDL_Log("Replication loopback: %d clients, %d entities (%zu moving), %.0f ms latency, %.0f%% loss, interest radius %.0f",
+            settings.clients, settings.entities, movers.size(), settings.link.latencyMs, settings.link.loss * 100.0,
+            settings.interestRadius);
+
+    const uint64_t stepNS = SDL_NS_PER_SECOND / (uint64_t)settings.tickRate;
+    const float dt = 1.0f / (float)settings.tickRate;
+    int totalTicks = settings.seconds * settings.tickRate;
+    int settleTicks = settings.tickRate * 2;   // nothing moves, clients catch up
+
+    double windowBytes = 0.0, windowEncodeMs = 0.0, windowApplyMs = 0.0, windowCaptureMs = 0.0;
+    double windowInterestMs = 0.0, windowRelevant = 0.0, windowEntered = 0.0, windowLeft = 0.0;
+    int windowTicks = 0;
+
+    for (int tick = 1; tick <= totalTicks + settleTicks; tick++) {
+        uint64_t now = (uint64_t)tick * stepNS;
+        bool moving = tick <= totalTicks;
+
+        {
+            EngineContext::Scope scope(serverContext);
+            World &world = World::GetInstance();
+
+            if (moving) {
+                for (Entity *e : movers) {
+                    Vector2 p = e->GetPosition() + e->GetVelocity() * dt;
+                    Vector2 v = e->GetVelocity();
+                    if (p.x < 0.0f || p.x > 4000.0f)
+                        v.x = -v.x;
+                    if (p.y < 0.0f || p.y > 4000.0f)
+                        v.y = -v.y;
+                    e->SetPosition(p);
+                    e->SetVelocity(v);
+                }
+            }
+
+            server.Update(world, now);
+            windowBytes += server.GetStats().bytesPerClient;
+            windowEncodeMs += server.GetStats().encodeMsPerClient;
+            windowCaptureMs += server.GetStats().captureMs;
+            windowInterestMs += server.GetStats().interestMs;
+            windowRelevant += server.GetStats().relevantPerClient;
+            windowEntered += server.GetStats().enteredPerClient;
+            windowLeft += server.GetStats().leftPerClient;
+        }
+
+        Uint64 applyStart = SDL_GetTicksNS();
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (moving) {
+                Vector2 &p = viewpoints[i];
+                Vector2 &v = viewVelocities[i];
+                p = p + v * dt;
+                if (p.x < 0.0f || p.x > 4000.0f)
+                    v.x = -v.x;
+                if (p.y < 0.0f || p.y > 4000.0f)
+                    v.y = -v.y;
+                clients[i]->SetViewpoint(p);
+            }
+
+            EngineContext::Scope scope(*clientContexts[i]);
+            clients[i]->Update(World::GetInstance(), now);
+        }
+        windowApplyMs += (double)(SDL_GetTicksNS() - applyStart) / 1e6 / clients.size();
+        windowTicks++;
+
+        if (windowTicks == settings.tickRate) {
+            SDL_Log("  tick %5d: %7.0f B/client/tick (%6.1f kbit/s), encode %.4f ms/client/tick, capture %.4f ms/tick, client apply %.4f ms/tick",
+                    tick, windowBytes / windowTicks, windowBytes / windowTicks * settings.tickRate * 8.0 / 1000.0,
+                    windowEncodeMs / windowTicks, windowCaptureMs / windowTicks, windowApplyMs / windowTicks);
+            if (settings.interestRadius > 0.0f) {
+                SDL_Log("              %5.0f relevant/client, +%.2f -%.2f per client/tick, interest %.4f ms/tick",
+                        windowRelevant / windowTicks, windowEntered / windowTicks, windowLeft / windowTicks,
+                        windowInterestMs / windowTicks);
+            }
+            windowBytes = windowEncodeMs = windowApplyMs = windowCaptureMs = 0.0;
+            windowInterestMs = windowRelevant = windowEntered = windowLeft = 0.0;
+            windowTicks = 0;
+        }
+    }
+
+    const ReplicationStats_t &stats = server.GetStats();
+    SDL_Log("Server: %llu full, %llu delta snapshots, largest %zu B, %llu truncated, %llu/%llu packets dropped by the link",
+            (unsigned long long)stats.fullSnapshots, (unsigned long long)stats.deltaSnapshots, stats.largestPacket,
+            (unsigned long long)stats.truncated, (unsigned long long)server.GetLink().GetDropped(),
+            (unsigned long long)server.GetLink().GetSent());
+
+    // Every client should now hold the server's quantized state of the
+    // entities relevant to it, every field of it, and nothing else.
+    // Materials are compared by name, each side has its own pointers.
+    std::unordered_map<uint32_t, NetEntityState_t> serverStates;
+    std::unordered_map<uint32_t, std::string> serverMaterials;
+    {
+        EngineContext::Scope scope(serverContext);
+        for (Entity *e : World::GetInstance().GetEntities()) {
+            NetEntityState_t s = NetState::Capture(e);
+            serverStates[e->GetId()] = s;
+            serverMaterials[e->GetId()] = s.material ? MaterialManager::GetInstance().GetMaterialName(s.material) : "";
+        }
+    }
+
+    int clientsInSync = 0;
+    for (size_t i = 0; i < clients.size(); i++) {
+        EngineContext::Scope scope(*clientContexts[i]);
+        const std::unordered_map<uint32_t, uint8_t> *relevant = server.GetRelevant(clients[i]->GetAddress());
+        size_t expected = relevant ? relevant->size() : serverStates.size();
+
+        size_t matching = 0, extra = 0;
+        for (Entity *e : World::GetInstance().GetEntities()) {
+            auto it = serverStates.find(e->GetId());
+            if (it == serverStates.end() || (relevant && !relevant->count(e->GetId()))) {
+                extra++;
+                continue;
+            }
+            const NetEntityState_t &s = it->second;
+            NetEntityState_t c = NetState::Capture(e);
+            std::string material = c.material ? MaterialManager::GetInstance().GetMaterialName(c.material) : "";
+            if (c.type == s.type && (NetState::Diff(c, s) & ~NET_MATERIAL) == 0 && material == serverMaterials[e->GetId()])
+                matching++;
+        }
+        if (matching == expected && extra == 0)
+            clientsInSync++;
+
+        const ReplicationClientStats_t &cs = clients[i]->GetStats();
+        if (i < 8 || matching != expected || extra) {
+            SDL_Log("Client %zu: %zu/%zu entities in sync, %zu extra, %llu snapshots decoded, %llu missing baseline",
+                    i, matching, expected, extra, (unsigned long long)cs.snapshots, (unsigned long long)cs.missingBaseline);
+        }
+    }
+    SDL_Log("%d/%zu clients in sync", clientsInSync, clients.size());
+
+    // Client worlds go away with their contexts, before the sockets close
+    clients.clear();
+    clientContexts.clear();
+    return clientsInSync == (int)settings.clients;
+}
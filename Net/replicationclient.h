@@ -0,0 +1,259 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "udpsocket.h"
+#include "linksimulator.h"
+#include "netentitystate.h"
+#include "../World/world.h"
+
+struct ReplicationClientStats_t {
+    uint64_t bytesReceived = 0;
+    uint64_t snapshots = 0;         // decoded
+    uint64_t applied = 0;
+    uint64_t missingBaseline = 0;   // delta against a state we no longer have
+    uint64_t stale = 0;             // older than the newest decoded one
+    double applyMs = 0.0;           // last applied snapshot
+};
+
+// Mirrors a ReplicationServer's world. Decoded snapshots are kept for
+// NET_HISTORY ticks as baselines, the newest one is applied to the local
+// world and acked. Entities are created with the server's ids and never
+// simulated locally.
+class ReplicationClient {
+    private:
+    UdpSocket socket;
+    LinkSimulator link{socket, 0xc11e};
+    NetAddress_t server;
+
+    std::vector<NetEntityState_t> history[NET_HISTORY];
+    uint32_t historySeq[NET_HISTORY] = {};
+    uint32_t newestSeq = 0;
+
+    std::vector<NetEntityState_t> applied;
+    uint32_t appliedSeq = 0;
+    std::unordered_map<uint32_t, Entity*> entities;
+
+    std::vector<uint8_t> receiveBuffer = std::vector<uint8_t>(NET_MAX_PACKET);
+    std::vector<uint8_t> packet;
+    std::vector<uint32_t> removed;
+    std::string scratch;
+    uint64_t lastHelloNS = 0;
+    Vector2 viewpoint;
+    bool hasViewpoint = false;
+    float snapDistance = 64.0f;
+    ReplicationClientStats_t stats;
+
+    // Returns the decoded sequence, 0 if the packet was dropped
+    uint32_t Decode(const uint8_t *data, size_t size) {
+        NetReader r(data, size);
+        if (r.U8() != NET_MSG_SNAPSHOT)
+            return 0;
+        uint32_t seq = r.U32();
+        uint32_t baseSeq = r.U32();
+        if (!r.IsOk() || seq == 0)
+            return 0;
+
+        if (historySeq[seq % NET_HISTORY] == seq)
+            return 0;
+        if (newestSeq >= seq + NET_HISTORY) {
+            stats.stale++;
+            return 0;
+        }
+
+        static const std::vector<NetEntityState_t> empty;
+        const std::vector<NetEntityState_t> *base = &empty;
+        if (baseSeq) {
+            if (historySeq[baseSeq % NET_HISTORY] != baseSeq) {
+                stats.missingBaseline++;
+                return 0;
+            }
+            base = &history[baseSeq % NET_HISTORY];
+        }
+
+        removed.clear();
+        uint32_t id = 0;
+        while (uint64_t delta = r.Varint()) {
+            id += (uint32_t)delta;
+            removed.push_back(id);
+        }
+
+        std::vector<NetEntityState_t> &out = history[seq % NET_HISTORY];
+        historySeq[seq % NET_HISTORY] = 0;
+        out.clear();
+
+        size_t j = 0, k = 0;
+        auto copyBaseBelow = [&](uint32_t limit) {
+            while (j < base->size() && (*base)[j].id < limit) {
+                while (k < removed.size() && removed[k] < (*base)[j].id)
+                    k++;
+                if (k == removed.size() || removed[k] != (*base)[j].id)
+                    out.push_back((*base)[j]);
+                j++;
+            }
+        };
+
+        id = 0;
+        while (uint64_t delta = r.Varint()) {
+            id += (uint32_t)delta;
+            uint8_t mask = r.U8();
+            copyBaseBelow(id);
+
+            NetEntityState_t s;
+            if (j < base->size() && (*base)[j].id == id) {
+                s = (*base)[j];
+                j++;
+            } else if (!(mask & NET_NEW)) {
+                return 0;
+            }
+            NetState::ReadFields(r, s, mask, scratch);
+            s.id = id;
+            out.push_back(s);
+            if (!r.IsOk())
+                return 0;
+        }
+        copyBaseBelow(UINT32_MAX);
+
+        if (!r.IsOk())
+            return 0;
+
+        historySeq[seq % NET_HISTORY] = seq;
+        stats.snapshots++;
+        if (seq > newestSeq)
+            newestSeq = seq;
+        return seq;
+    }
+
+    void ApplyToWorld(World &world, const std::vector<NetEntityState_t> &target) {
+        Uint64 start = SDL_GetTicksNS();
+
+        size_t i = 0;
+        for (const auto &prev : applied) {
+            while (i < target.size() && target[i].id < prev.id)
+                i++;
+            if (i < target.size() && target[i].id == prev.id)
+                continue;
+
+            auto it = entities.find(prev.id);
+            if (it != entities.end()) {
+                world.RemoveEntity(it->second);
+                entities.erase(it);
+            }
+        }
+
+        for (const auto &s : target) {
+            auto it = entities.find(s.id);
+            if (it != entities.end()) {
+                Entity *e = it->second;
+                // Static entities are re-filed (and re-rendered when cached)
+                // when they moved or their look changed
+                bool wasStatic = e->IsStatic();
+                bool changed = (NetState::Diff(NetState::Capture(e), s) & ~NET_VELOCITY) != 0;
+                Vector2 from = e->GetPosition();
+                NetState::Apply(e, s);
+                // Corrections jump, small moves are blended by the interpolation
+                if ((e->GetPosition() - from).Length() > snapDistance)
+                    e->Teleport(e->GetPosition());
+                if ((changed && (wasStatic || e->IsStatic())) || e->IsDrawCacheable() != e->IsDrawCached())
+                    world.OnStaticChanged(e);
+                continue;
+            }
+
+            Entity *e = World::CreateEntityOfType((EntityType)s.type);
+            e->SetId(s.id);
+            NetState::Apply(e, s);
+            if (!world.AddEntity(e)) {
+                SDL_Log("ReplicationClient: world is full, dropping entity %u", s.id);
+                delete e;
+                continue;
+            }
+            entities[s.id] = e;
+        }
+
+        applied.assign(target.begin(), target.end());
+        stats.applied++;
+        stats.applyMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    void Send(NetWriter &w, uint64_t nowNS) {
+        if (hasViewpoint) {
+            w.F32(viewpoint.x);
+            w.F32(viewpoint.y);
+        }
+        link.Send(server, packet.data(), packet.size(), nowNS);
+    }
+
+    public:
+    bool Connect(const NetAddress_t &serverAddress) {
+        server = serverAddress;
+        return socket.Open(0);
+    }
+
+    void SetLinkSettings(const LinkSettings_t &settings) {
+        link.SetSettings(settings);
+    }
+
+    // Snapshots moving an entity further than this teleport it instead of
+    // letting the interpolation slide it there
+    void SetSnapDistance(float distance) {
+        snapDistance = distance;
+    }
+
+    // Center of this client's area of interest, sent with every ack
+    void SetViewpoint(Vector2 position) {
+        viewpoint = position;
+        hasViewpoint = true;
+    }
+
+    NetAddress_t GetAddress() const {
+        return socket.GetLocalAddress();
+    }
+
+    // Receives, applies the newest snapshot and acks. Call once per tick.
+    void Update(World &world, uint64_t nowNS) {
+        link.Pump(nowNS);
+
+        // Keep knocking until the first snapshot arrives
+        if (appliedSeq == 0 && (lastHelloNS == 0 || nowNS - lastHelloNS > 250 * SDL_NS_PER_MS)) {
+            NetWriter w(packet);
+            w.U8(NET_MSG_HELLO);
+            Send(w, nowNS);
+            lastHelloNS = nowNS ? nowNS : 1;
+        }
+
+        NetAddress_t from;
+        int size;
+        while ((size = socket.Receive(receiveBuffer.data(), receiveBuffer.size(), from)) > 0) {
+            if (!(from == server))
+                continue;
+            stats.bytesReceived += (uint64_t)size;
+
+            uint32_t seq = Decode(receiveBuffer.data(), (size_t)size);
+            if (!seq)
+                continue;
+
+            NetWriter w(packet);
+            w.U8(NET_MSG_ACK);
+            w.U32(seq);
+            Send(w, nowNS);
+        }
+
+        if (newestSeq > appliedSeq && historySeq[newestSeq % NET_HISTORY] == newestSeq) {
+            ApplyToWorld(world, history[newestSeq % NET_HISTORY]);
+            appliedSeq = newestSeq;
+        }
+    }
+
+    uint32_t GetAppliedSeq() const {
+        return appliedSeq;
+    }
+
+    const std::vector<NetEntityState_t>& GetAppliedStates() const {
+        return applied;
+    }
+
+    const ReplicationClientStats_t& GetStats() const {
+        return stats;
+    }
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "udpsocket.h"
+#include "linksimulator.h"
+#include "netentitystate.h"
+#include "interestmanager.h"
+#include "../World/world.h"
+
+struct ReplicationStats_t {
+    int clients = 0;
+    uint32_t tick = 0;
+    double captureMs = 0.0;             // world -> quantized states, shared by all clients
+    double encodeMsPerClient = 0.0;     // last tick, delta encode + send
+    double bytesPerClient = 0.0;        // last tick, UDP payload
+    uint64_t totalBytes = 0;
+    uint64_t fullSnapshots = 0;
+    uint64_t deltaSnapshots = 0;
+    size_t largestPacket = 0;
+    uint64_t truncated = 0;             // snapshots cut at NET_MAX_PACKET, the rest follows later
+    double interestMs = 0.0;            // last tick, area of interest update
+    double relevantPerClient = 0.0;     // last tick, entities each client is sent about
+    double enteredPerClient = 0.0;
+    double leftPerClient = 0.0;
+};
+
+// Authoritative side of snapshot replication. Every Update() captures the
+// world into quantized states and sends each client a delta against the
+// newest snapshot it acked. The server keeps, per client, the last
+// NET_HISTORY states it sent, the client keeps the same ones, so a lost
+// packet just means the next delta is against an older ack.
+//
+// With interest tiers set, each client only gets the entities around the
+// viewpoint it reports, farther tiers at a lower rate. Entities leaving the
+// area go out as removals like any other.
+class ReplicationServer {
+    private:
+    struct Client {
+        NetAddress_t address;
+        uint32_t ackedSeq = 0;
+        std::vector<NetEntityState_t> history[NET_HISTORY];
+        uint32_t historySeq[NET_HISTORY] = {};
+        uint64_t bytesSent = 0;
+        Vector2 viewpoint;
+        bool hasViewpoint = false;
+        int viewer = -1;
+        std::vector<NetEntityState_t> target;   // sorted by id
+    };
+
+    UdpSocket socket;
+    LinkSimulator link{socket, 0x5e12};
+    std::vector<std::unique_ptr<Client>> clients;
+    std::vector<NetEntityState_t> current;  // sorted by id
+    std::vector<uint32_t> removed;
+    std::vector<uint8_t> packet;
+    std::vector<uint8_t> receiveBuffer = std::vector<uint8_t>(2048);
+    uint32_t seq = 0;
+    InterestManager interest;
+    bool interestEnabled = false;
+    ReplicationStats_t stats;
+
+    Client* FindClient(const NetAddress_t &address) const {
+        for (auto &c : clients) {
+            if (c->address == address)
+                return c.get();
+        }
+        return nullptr;
+    }
+
+    static const NetEntityState_t* FindState(const std::vector<NetEntityState_t> &states, uint32_t id) {
+        auto it = std::lower_bound(states.begin(), states.end(), id, [](const NetEntityState_t &s, uint32_t id) {
+            return s.id < id;
+        });
+        return it != states.end() && it->id == id ? &*it : nullptr;
+    }
+
+    // Newest acked snapshot that both sides still hold, nullptr for a full one
+    const std::vector<NetEntityState_t>* FindBase(const Client &c, uint32_t &baseSeq) const {
+        baseSeq = 0;
+        uint32_t slot = c.ackedSeq % NET_HISTORY;
+        if (!c.ackedSeq || seq - c.ackedSeq >= NET_HISTORY || c.historySeq[slot] != c.ackedSeq)
+            return nullptr;
+        baseSeq = c.ackedSeq;
+        return &c.history[slot];
+    }
+
+    // Hello and ack may carry the client's viewpoint
+    static void ReadViewpoint(NetReader &r, Client &c) {
+        float x = r.F32();
+        float y = r.F32();
+        if (r.IsOk()) {
+            c.viewpoint = {x, y};
+            c.hasViewpoint = true;
+        }
+    }
+
+    // Relevant entities of one client. Those not due this tick repeat the
+    // baseline state, so they cost nothing on the wire.
+    void BuildTarget(Client &c) {
+        c.target.clear();
+        uint32_t baseSeq;
+        const std::vector<NetEntityState_t> *base = FindBase(c, baseSeq);
+
+        for (const auto &[id, tier] : interest.GetRelevant(c.viewer)) {
+            const NetEntityState_t *s = FindState(current, id);
+            if (!s)
+                continue;
+            if (base && !interest.IsDue(tier, id, seq)) {
+                if (const NetEntityState_t *b = FindState(*base, id)) {
+                    c.target.push_back(*b);
+                    continue;
+                }
+            }
+            c.target.push_back(*s);
+        }
+        std::sort(c.target.begin(), c.target.end(), [](const NetEntityState_t &a, const NetEntityState_t &b) {
+            return a.id < b.id;
+        });
+    }
+
+    void Receive() {
+        NetAddress_t from;
+        int size;
+        while ((size = socket.Receive(receiveBuffer.data(), receiveBuffer.size(), from)) > 0) {
+            NetReader r(receiveBuffer.data(), (size_t)size);
+            uint8_t type = r.U8();
+
+            if (type == NET_MSG_HELLO) {
+                Client *c = FindClient(from);
+                if (!c) {
+                    clients.push_back(std::make_unique<Client>());
+                    c = clients.back().get();
+                    c->address = from;
+                    SDL_Log("ReplicationServer: client %u joined", from.port);
+                }
+                ReadViewpoint(r, *c);
+            } else if (type == NET_MSG_ACK) {
+                Client *c = FindClient(from);
+                uint32_t acked = r.U32();
+                if (!c || !r.IsOk())
+                    continue;
+                if (acked <= seq && acked > c->ackedSeq)
+                    c->ackedSeq = acked;
+                ReadViewpoint(r, *c);
+            }
+        }
+    }
+
+    // Builds one client's snapshot against its newest usable ack
+    void Encode(Client &c, const std::vector<NetEntityState_t> &target, uint64_t nowNS) {
+        uint32_t baseSeq;
+        const std::vector<NetEntityState_t> *base = FindBase(c, baseSeq);
+
+        NetWriter w(packet);
+        w.U8(NET_MSG_SNAPSHOT);
+        w.U32(seq);
+        w.U32(baseSeq);
+
+        // Removals first, the client needs them while merging records
+        removed.clear();
+        if (base) {
+            size_t i = 0;
+            for (const auto &b : *base) {
+                while (i < target.size() && target[i].id < b.id)
+                    i++;
+                if (i == target.size() || target[i].id != b.id)
+                    removed.push_back(b.id);
+            }
+        }
+        uint32_t prevId = 0;
+        for (uint32_t id : removed) {
+            w.Varint(id - prevId);
+            prevId = id;
+        }
+        w.Varint(0);
+
+        // Changed and new entities, ids ascending and delta coded. What
+        // doesn't fit goes out next tick, history keeps what was sent.
+        std::vector<NetEntityState_t> &sent = c.history[seq % NET_HISTORY];
+        sent.clear();
+        bool full = false;
+        prevId = 0;
+        size_t j = 0;
+        for (const auto &s : target) {
+            const NetEntityState_t *b = nullptr;
+            if (base) {
+                while (j < base->size() && (*base)[j].id < s.id)
+                    j++;
+                if (j < base->size() && (*base)[j].id == s.id)
+                    b = &(*base)[j];
+            }
+
+            uint8_t mask = b ? NetState::Diff(s, *b) : (uint8_t)(NET_NEW | NET_ALL);
+            if (mask && !full) {
+                size_t recordStart = w.Size();
+                w.Varint(s.id - prevId);
+                w.U8(mask);
+                NetState::WriteFields(w, s, b, mask);
+                if (w.Size() < NET_MAX_PACKET) {
+                    prevId = s.id;
+                    sent.push_back(s);
+                    continue;
+                }
+                w.Truncate(recordStart);
+                full = true;
+            }
+            if (!mask)
+                sent.push_back(s);
+            else if (b)
+                sent.push_back(*b);
+        }
+        w.Varint(0);
+        c.historySeq[seq % NET_HISTORY] = seq;
+
+        if (base)
+            stats.deltaSnapshots++;
+        else
+            stats.fullSnapshots++;
+        if (full)
+            stats.truncated++;
+
+        link.Send(c.address, packet.data(), packet.size(), nowNS);
+        c.bytesSent += packet.size();
+        stats.totalBytes += packet.size();
+        stats.largestPacket = std::max(stats.largestPacket, packet.size());
+    }
+
+    public:
+    // Port 0 picks a free one, see GetAddress
+    bool Start(uint16_t port = 0) {
+        return socket.Open(port);
+    }
+
+    NetAddress_t GetAddress() const {
+        return socket.GetLocalAddress();
+    }
+
+    void SetLinkSettings(const LinkSettings_t &settings) {
+        link.SetSettings(settings);
+    }
+
+    // Empty tiers send every entity to every client
+    void SetInterest(const std::vector<InterestTier_t> &tiers) {
+        interest.SetTiers(tiers);
+        interestEnabled = !tiers.empty();
+    }
+
+    // What a client is currently sent about, nullptr without interest tiers
+    const std::unordered_map<uint32_t, uint8_t>* GetRelevant(const NetAddress_t &client) const {
+        Client *c = FindClient(client);
+        if (!interestEnabled || !c || c->viewer < 0)
+            return nullptr;
+        return &interest.GetRelevant(c->viewer);
+    }
+
+    // Once per simulation tick, after the world stepped
+    void Update(World &world, uint64_t nowNS) {
+        link.Pump(nowNS);
+        Receive();
+        seq++;
+
+        Uint64 start = SDL_GetTicksNS();
+        current.clear();
+        for (Entity *e : world.GetEntities())
+            current.push_back(NetState::Capture(e));
+        std::sort(current.begin(), current.end(), [](const NetEntityState_t &a, const NetEntityState_t &b) {
+            return a.id < b.id;
+        });
+        Uint64 captured = SDL_GetTicksNS();
+
+        size_t relevant = 0, entered = 0, left = 0;
+        if (interestEnabled) {
+            for (auto &c : clients) {
+                if (c->viewer < 0)
+                    c->viewer = interest.AddViewer();
+                if (c->hasViewpoint)
+                    interest.SetViewpoint(c->viewer, c->viewpoint);
+            }
+            interest.Update(world.GetEntities());
+            for (auto &c : clients) {
+                relevant += interest.GetRelevant(c->viewer).size();
+                entered += interest.GetEntered(c->viewer).size();
+                left += interest.GetLeft(c->viewer).size();
+            }
+        }
+        Uint64 interested = SDL_GetTicksNS();
+
+        uint64_t bytesBefore = stats.totalBytes;
+        for (auto &c : clients) {
+            if (interestEnabled) {
+                BuildTarget(*c);
+                Encode(*c, c->target, nowNS);
+            } else {
+                Encode(*c, current, nowNS);
+            }
+        }
+        Uint64 end = SDL_GetTicksNS();
+
+        stats.clients = (int)clients.size();
+        stats.tick = seq;
+        stats.captureMs = (double)(captured - start) / 1e6;
+        stats.interestMs = (double)(interested - captured) / 1e6;
+        stats.encodeMsPerClient = clients.empty() ? 0.0 : (double)(end - interested) / 1e6 / clients.size();
+        stats.bytesPerClient = clients.empty() ? 0.0 : (double)(stats.totalBytes - bytesBefore) / clients.size();
+        double perClient = clients.empty() ? 0.0 : 1.0 / clients.size();
+        stats.relevantPerClient = interestEnabled ? relevant * perClient : (double)current.size();
+        stats.enteredPerClient = entered * perClient;
+        stats.leftPerClient = left * perClient;
+    }
+
+    const ReplicationStats_t& GetStats() const {
+        return stats;
+    }
+
+    const LinkSimulator& GetLink() const {
+        return link;
+    }
+};
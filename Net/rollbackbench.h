@@ -0,0 +1,153 @@
+#pragma once
+
+#include <memory>
+#include "../Engine/enginecontext.h"
+#include "../AnimatedEntity/animatedentity.h"
+#include "rollbacksession.h"
+
+struct RollbackBenchSettings_t {
+    int seconds = 20;
+    int tickRate = 60;
+    RollbackSettings_t rollback;
+    LinkSettings_t link = {60.0, 10.0, 0.05};
+    int desyncAt = -1;      // nudges one peer's player on this tick, to check detection
+};
+
+// Two peers in one process, each with its own EngineContext and world,
+// playing over loopback UDP through a LinkSimulator. Inputs are scripted
+// per peer. Logs rollback counts and cost, then whether the confirmed
+// frame checksums ever disagreed. False when a socket doesn't open or
+// either peer saw a desync, including the one desyncAt injects.
+inline bool RunRollbackLoopback(const RollbackBenchSettings_t &settings) {
+    struct Peer {
+        EngineContext context;
+        RollbackSession session;
+        Player *player = nullptr;
+        uint32_t rng = 0;
+        int holdTicks = 0;
+        InputState_t input;
+    };
+    std::unique_ptr<Peer> peers[2] = {std::make_unique<Peer>(), std::make_unique<Peer>()};
+
+    RollbackSettings_t rollback = settings.rollback;
+    rollback.dt = 1.0 / settings.tickRate;
+
+    for (int i = 0; i < 2; i++) {
+        Peer &p = *peers[i];
+        EngineContext::Scope scope(p.context);
+        World &world = World::GetInstance();
+        world.SetMaxEntities(1024);
+
+        // Same arena on both sides, built in the same order
+        Entity *floor = new Entity();
+        floor->SetPosition({0.0f, 200.0f});
+        floor->SetSize({2000.0f, 32.0f});
+        floor->SetStatic(true);
+        world.AddEntity(floor);
+        for (int b = 0; b < 16; b++) {
+            Entity *block = new Entity();
+            block->SetPosition({-600.0f + b * 80.0f, 120.0f - (b % 4) * 40.0f});
+            block->SetSize({48.0f, 16.0f});
+            block->SetStatic(true);
+            world.AddEntity(block);
+        }
+        for (int d = 0; d < 200; d++) {
+            AnimatedEntity *decoration = new AnimatedEntity();
+            decoration->SetPosition({(float)(d % 20) * 40.0f, -2000.0f - (float)(d / 20) * 40.0f});
+            decoration->SetSize({16.0f, 16.0f});
+            decoration->SetStatic(true);
+            world.AddEntity(decoration);
+        }
+        Player *players[2];
+        for (int s = 0; s < 2; s++) {
+            players[s] = new Player();
+            players[s]->InitializeAnimations();
+            players[s]->SetSize({14.0f, 17.0f});
+            players[s]->SetPosition({s == 0 ? -100.0f : 100.0f, 150.0f});
+            players[s]->SetInputSlot(s);
+            players[s]->SetFollowCamera(false);
+            world.AddEntity(players[s]);
+        }
+        p.player = players[i];
+        p.rng = 0x1234u + (uint32_t)i * 0x9e3779b9u;
+
+        if (!p.session.Open(0)) {
+            SDL_Log("Rollback loopback: couldn't open a socket");
+            return false;
+        }
+        p.session.SetLinkSettings(settings.link);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        EngineContext::Scope scope(peers[i]->context);
+        peers[i]->session.Begin(World::GetInstance(), i, peers[1 - i]->session.GetAddress(), rollback);
+    }
+
+    SDL_Log("Rollback loopback: %.0f ms latency, %.0f ms jitter, %.0f%% loss, input delay %d, max rollback %d",
+            settings.link.latencyMs, settings.link.jitterMs, settings.link.loss * 100.0,
+            rollback.inputDelay, rollback.maxRollback);
+
+    static const uint8_t moves[] = {0, INPUT_LEFT, INPUT_RIGHT, INPUT_LEFT | INPUT_JUMP, INPUT_RIGHT | INPUT_JUMP, INPUT_JUMP};
+    const uint64_t stepNS = SDL_NS_PER_SECOND / (uint64_t)settings.tickRate;
+    int playTicks = settings.seconds * settings.tickRate;
+    int settleTicks = settings.tickRate * 2;     // no input, both sides confirm everything
+
+    uint64_t windowRollbacks = 0, windowResim = 0;
+    double windowMaxMs = 0.0;
+
+    for (int tick = 1; tick <= playTicks + settleTicks; tick++) {
+        uint64_t now = (uint64_t)tick * stepNS;
+
+        for (int i = 0; i < 2; i++) {
+            Peer &p = *peers[i];
+            if (tick > playTicks) {
+                p.input = InputState_t();
+            } else if (--p.holdTicks <= 0) {
+                p.rng = p.rng * 1664525u + 1013904223u;
+                p.input.buttons = moves[(p.rng >> 16) % sizeof(moves)];
+                p.holdTicks = 10 + (int)((p.rng >> 8) % 30);
+            }
+
+            EngineContext::Scope scope(p.context);
+            if (tick == settings.desyncAt && i == 1)
+                p.player->SetPosition(p.player->GetPosition() + Vector2{0.5f, 0.0f});
+            p.session.Advance(World::GetInstance(), p.input, now);
+        }
+
+        const RollbackStats_t &a = peers[0]->session.GetStats();
+        windowMaxMs = std::max(windowMaxMs, a.lastRollbackMs);
+        if (tick % settings.tickRate == 0) {
+            uint64_t rollbacks = a.rollbacks - windowRollbacks;
+            uint64_t resim = a.resimulatedFrames - windowResim;
+            SDL_Log("  tick %5d: frame %u (confirmed %u), %llu rollbacks, %.1f frames avg, rollback max %.3f ms, step %.3f ms, save %.3f ms, %llu stalls",
+                    tick, a.frame, a.confirmedFrame, (unsigned long long)rollbacks,
+                    rollbacks ? (double)resim / rollbacks : 0.0, windowMaxMs, a.stepMs, a.saveMs,
+                    (unsigned long long)a.stalls);
+            windowRollbacks = a.rollbacks;
+            windowResim = a.resimulatedFrames;
+            windowMaxMs = 0.0;
+        }
+    }
+
+    double frameBudgetMs = 1000.0 / settings.tickRate;
+    bool ok = true;
+    for (int i = 0; i < 2; i++) {
+        const RollbackStats_t &s = peers[i]->session.GetStats();
+        SDL_Log("Peer %d: frame %u, %llu rollbacks (%llu frames, max %d, max %.3f ms of a %.1f ms frame), %llu stalls, %.1f kbit/s, %llu checksums compared, %llu desyncs",
+                i, s.frame, (unsigned long long)s.rollbacks, (unsigned long long)s.resimulatedFrames,
+                s.maxRollbackFrames, s.maxRollbackMs, frameBudgetMs, (unsigned long long)s.stalls,
+                s.bytesSent * 8.0 / 1000.0 / ((playTicks + settleTicks) / (double)settings.tickRate),
+                (unsigned long long)s.checksumsCompared, (unsigned long long)s.desyncs);
+        if (s.desyncs) {
+            SDL_Log("Peer %d: first desync at frame %u", i, s.firstDesyncFrame);
+            ok = false;
+        }
+    }
+
+    // Entity teardown reaches for per-context services, clear inside each
+    for (auto &p : peers) {
+        EngineContext::Scope scope(p->context);
+        World::GetInstance().ClearEntities();
+    }
+    return ok;
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "udpsocket.h"
+#include "linksimulator.h"
+#include "netentitystate.h"
+#include "../InputSystem/inputsystem.h"
+#include "../Snapshot/snapshot.h"
+#include "../World/world.h"
+
+struct RollbackSettings_t {
+    int inputDelay = 2;         // frames between reading local input and simulating it
+    int maxRollback = 8;        // frames of prediction before waiting for the peer, at most MAX_ROLLBACK
+    double dt = 1.0 / 60.0;
+};
+
+struct RollbackStats_t {
+    uint32_t frame = 0;                 // next frame to simulate
+    uint32_t confirmedFrame = 0;        // frames below this have both inputs
+    uint64_t rollbacks = 0;
+    uint64_t resimulatedFrames = 0;
+    int lastRollbackFrames = 0;
+    int maxRollbackFrames = 0;
+    double lastRollbackMs = 0.0;        // restore + resimulation
+    double maxRollbackMs = 0.0;
+    double saveMs = 0.0;                // last snapshot save
+    double stepMs = 0.0;                // last simulated frame
+    uint64_t stalls = 0;                // ticks spent waiting for the peer
+    uint64_t checksumsCompared = 0;
+    uint64_t desyncs = 0;
+    uint32_t firstDesyncFrame = 0;
+    uint64_t bytesSent = 0;
+};
+
+enum RollbackMessage_t : uint8_t {
+    ROLLBACK_MSG_INPUT = 1
+};
+
+// Two player rollback over UDP, GGPO style. Local input is delayed by a few
+// frames and sent every tick, the peer's input is predicted (last known
+// input repeated) until it arrives. When a prediction turns out wrong the
+// world is restored to that frame and the frames since are simulated again.
+// A snapshot of every frame in the rollback window is kept for that.
+//
+// Both sides checksum each frame once its inputs are confirmed and send the
+// newest one along, a mismatch means the simulations diverged.
+class RollbackSession {
+    public:
+    static constexpr int MAX_ROLLBACK = 8;
+
+    private:
+    static constexpr uint32_t INPUT_HISTORY = 64;
+    static constexpr uint32_t SNAPSHOT_RING = MAX_ROLLBACK + 2;
+    static constexpr uint32_t NO_FRAME = UINT32_MAX;
+
+    UdpSocket socket;
+    LinkSimulator link{socket, 0x7011};
+    NetAddress_t peer;
+    RollbackSettings_t settings;
+    int localSlot = 0;
+    int remoteSlot = 1;
+
+    InputState_t localInputs[INPUT_HISTORY];
+    InputState_t remoteInputs[INPUT_HISTORY];
+    InputState_t usedRemote[INPUT_HISTORY];   // what the last simulation of a frame assumed
+    uint32_t localNext = 0;                   // local inputs known below this frame
+    uint32_t remoteNext = 0;                  // remote inputs known below this frame, no gaps
+    uint32_t peerAcked = 0;                   // the peer has our inputs below this frame
+
+    Snapshot snapshots[SNAPSHOT_RING];        // world at the start of a frame
+    uint32_t snapshotFrame[SNAPSHOT_RING];
+    uint32_t frame = 0;
+    uint32_t rollbackTo = NO_FRAME;
+
+    uint64_t localChecksums[INPUT_HISTORY];
+    uint32_t localChecksumFrame[INPUT_HISTORY];
+    uint64_t remoteChecksums[INPUT_HISTORY];
+    uint32_t remoteChecksumFrame[INPUT_HISTORY];
+    uint32_t checksumNext = 0;                // confirmed frames below this are checksummed
+
+    std::vector<uint8_t> packet;
+    std::vector<uint8_t> receiveBuffer = std::vector<uint8_t>(2048);
+    RollbackStats_t stats;
+
+    void CompareChecksums(uint32_t f) {
+        uint32_t slot = f % INPUT_HISTORY;
+        if (localChecksumFrame[slot] != f || remoteChecksumFrame[slot] != f)
+            return;
+        stats.checksumsCompared++;
+        if (localChecksums[slot] != remoteChecksums[slot]) {
+            if (!stats.desyncs) {
+                stats.firstDesyncFrame = f;
+                SDL_Log("RollbackSession: desync at frame %u", f);
+            }
+            stats.desyncs++;
+        }
+        remoteChecksumFrame[slot] = NO_FRAME;
+    }
+
+    void Receive() {
+        NetAddress_t from;
+        int size;
+        while ((size = socket.Receive(receiveBuffer.data(), receiveBuffer.size(), from)) > 0) {
+            if (!(from == peer))
+                continue;
+            NetReader r(receiveBuffer.data(), (size_t)size);
+            if (r.U8() != ROLLBACK_MSG_INPUT)
+                continue;
+
+            uint32_t acked = r.U32();
+            uint32_t start = r.U32();
+            uint8_t count = r.U8();
+            for (uint32_t f = start; f < start + count; f++) {
+                InputState_t input;
+                input.buttons = r.U8();
+                if (!r.IsOk() || f != remoteNext)
+                    continue;
+
+                // Already simulated with a guess, replay from here if it was wrong
+                if (f < frame && usedRemote[f % INPUT_HISTORY] != input)
+                    rollbackTo = std::min(rollbackTo, f);
+                remoteInputs[f % INPUT_HISTORY] = input;
+                remoteNext++;
+            }
+
+            uint32_t checksumFrame = r.U32();
+            uint64_t checksum = r.U64();
+            if (!r.IsOk())
+                continue;
+            peerAcked = std::max(peerAcked, acked);
+            if (checksumFrame != NO_FRAME) {
+                remoteChecksums[checksumFrame % INPUT_HISTORY] = checksum;
+                remoteChecksumFrame[checksumFrame % INPUT_HISTORY] = checksumFrame;
+                CompareChecksums(checksumFrame);
+            }
+        }
+    }
+
+    void Send(uint64_t nowNS) {
+        // Everything the peer hasn't acked, so a lost packet is covered by the next one
+        uint32_t start = std::max(peerAcked, localNext > INPUT_HISTORY / 2 ? localNext - INPUT_HISTORY / 2 : 0u);
+        uint32_t lastChecksum = checksumNext ? checksumNext - 1 : NO_FRAME;
+
+        NetWriter w(packet);
+        w.U8(ROLLBACK_MSG_INPUT);
+        w.U32(remoteNext);
+        w.U32(start);
+        w.U8((uint8_t)(localNext - start));
+        for (uint32_t f = start; f < localNext; f++)
+            w.U8(localInputs[f % INPUT_HISTORY].buttons);
+        w.U32(lastChecksum);
+        w.U64(lastChecksum != NO_FRAME ? localChecksums[lastChecksum % INPUT_HISTORY] : 0);
+
+        link.Send(peer, packet.data(), packet.size(), nowNS);
+        stats.bytesSent += packet.size();
+    }
+
+    void SaveFrame(World &world, uint32_t f) {
+        Uint64 start = SDL_GetTicksNS();
+        world.SaveSnapshot(snapshots[f % SNAPSHOT_RING]);
+        snapshotFrame[f % SNAPSHOT_RING] = f;
+        stats.saveMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    void SimulateFrame(World &world, uint32_t f) {
+        InputState_t remote;
+        if (f < remoteNext)
+            remote = remoteInputs[f % INPUT_HISTORY];
+        else if (remoteNext > 0)
+            remote = remoteInputs[(remoteNext - 1) % INPUT_HISTORY];
+        usedRemote[f % INPUT_HISTORY] = remote;
+
+        InputSystem &input = InputSystem::GetInstance();
+        input.Set(localSlot, localInputs[f % INPUT_HISTORY]);
+        input.Set(remoteSlot, remote);
+
+        Uint64 start = SDL_GetTicksNS();
+        world.Step(settings.dt);
+        stats.stepMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+
+        SaveFrame(world, f + 1);
+    }
+
+    void Rollback(World &world) {
+        uint32_t target = rollbackTo;
+        rollbackTo = NO_FRAME;
+        if (target >= frame)
+            return;
+
+        Uint64 start = SDL_GetTicksNS();
+        if (snapshotFrame[target % SNAPSHOT_RING] != target || !world.RestoreSnapshot(snapshots[target % SNAPSHOT_RING])) {
+            SDL_Log("RollbackSession: frame %u is outside the rollback window", target);
+            return;
+        }
+        for (uint32_t f = target; f < frame; f++)
+            SimulateFrame(world, f);
+
+        int frames = (int)(frame - target);
+        stats.rollbacks++;
+        stats.resimulatedFrames += (uint64_t)frames;
+        stats.lastRollbackFrames = frames;
+        stats.maxRollbackFrames = std::max(stats.maxRollbackFrames, frames);
+        stats.lastRollbackMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+        stats.maxRollbackMs = std::max(stats.maxRollbackMs, stats.lastRollbackMs);
+    }
+
+    // Frames whose inputs are all known won't be rolled back anymore
+    void ChecksumConfirmed() {
+        uint32_t confirmed = std::min(frame, remoteNext);
+        for (; checksumNext <= confirmed; checksumNext++) {
+            uint32_t f = checksumNext;
+            if (snapshotFrame[f % SNAPSHOT_RING] != f)
+                continue;
+            localChecksums[f % INPUT_HISTORY] = snapshots[f % SNAPSHOT_RING].Checksum();
+            localChecksumFrame[f % INPUT_HISTORY] = f;
+            CompareChecksums(f);
+        }
+    }
+
+    public:
+    // Port 0 picks a free one, see GetAddress
+    bool Open(uint16_t port = 0) {
+        return socket.Open(port);
+    }
+
+    NetAddress_t GetAddress() const {
+        return socket.GetLocalAddress();
+    }
+
+    void SetLinkSettings(const LinkSettings_t &linkSettings) {
+        link.SetSettings(linkSettings);
+    }
+
+    // Both peers must start from the same world with the same settings.
+    // Takes over the InputSystem slots of both players.
+    void Begin(World &world, int slot, const NetAddress_t &peerAddress, const RollbackSettings_t &rollbackSettings) {
+        settings = rollbackSettings;
+        settings.maxRollback = std::clamp(settings.maxRollback, 1, MAX_ROLLBACK);
+        settings.inputDelay = std::clamp(settings.inputDelay, 0, (int)INPUT_HISTORY / 4);
+        localSlot = slot;
+        remoteSlot = slot == 0 ? 1 : 0;
+        peer = peerAddress;
+
+        for (uint32_t i = 0; i < INPUT_HISTORY; i++) {
+            localInputs[i] = remoteInputs[i] = usedRemote[i] = InputState_t();
+            localChecksumFrame[i] = remoteChecksumFrame[i] = NO_FRAME;
+        }
+        for (uint32_t i = 0; i < SNAPSHOT_RING; i++)
+            snapshotFrame[i] = NO_FRAME;
+
+        // The first inputDelay frames run without input on both sides
+        localNext = remoteNext = peerAcked = (uint32_t)settings.inputDelay;
+        frame = 0;
+        checksumNext = 0;
+        rollbackTo = NO_FRAME;
+        stats = RollbackStats_t();
+
+        InputSystem::GetInstance().SetKeyboardEnabled(false);
+        SaveFrame(world, 0);
+    }
+
+    // Once per tick with this tick's local input. Returns false when the
+    // session is too far ahead of the peer and waited instead of simulating.
+    bool Advance(World &world, InputState_t input, uint64_t nowNS) {
+        link.Pump(nowNS);
+        Receive();
+
+        if (localNext <= frame + (uint32_t)settings.inputDelay) {
+            localInputs[localNext % INPUT_HISTORY] = input;
+            localNext++;
+        }
+
+        if (rollbackTo != NO_FRAME)
+            Rollback(world);
+
+        bool advanced = frame < remoteNext + (uint32_t)settings.maxRollback;
+        if (advanced) {
+            SimulateFrame(world, frame);
+            frame++;
+        } else {
+            stats.stalls++;
+        }
+
+        ChecksumConfirmed();
+        Send(nowNS);
+
+        stats.frame = frame;
+        stats.confirmedFrame = std::min(frame, remoteNext);
+        return advanced;
+    }
+
+    uint32_t GetFrame() const {
+        return frame;
+    }
+
+    const RollbackStats_t& GetStats() const {
+        return stats;
+    }
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+struct NetAddress_t {
+    uint32_t ip = 0;        // host byte order
+    uint16_t port = 0;
+
+    bool operator==(const NetAddress_t &other) const {
+        return ip == other.ip && port == other.port;
+    }
+
+    static NetAddress_t Loopback(uint16_t port) {
+        return {INADDR_LOOPBACK, port};
+    }
+};
+
+// Non-blocking IPv4 UDP socket (POSIX)
+class UdpSocket {
+    private:
+    int fd = -1;
+
+    static sockaddr_in ToSockAddr(const NetAddress_t &address) {
+        sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(address.ip);
+        addr.sin_port = htons(address.port);
+        return addr;
+    }
+
+    public:
+    UdpSocket() = default;
+    ~UdpSocket() { Close(); }
+
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // Port 0 picks a free one, see GetLocalAddress
+    bool Open(uint16_t port = 0, bool loopbackOnly = true) {
+        Close();
+
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            SDL_Log("UdpSocket: socket() failed: %s", strerror(errno));
+            return false;
+        }
+
+        // Snapshots for many clients arrive in bursts
+        int bufferSize = 4 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        sockaddr_in addr = ToSockAddr({loopbackOnly ? (uint32_t)INADDR_LOOPBACK : (uint32_t)INADDR_ANY, port});
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+            SDL_Log("UdpSocket: bind to port %u failed: %s", port, strerror(errno));
+            Close();
+            return false;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        return true;
+    }
+
+    void Close() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    bool IsOpen() const {
+        return fd >= 0;
+    }
+
+    NetAddress_t GetLocalAddress() const {
+        sockaddr_in addr;
+        socklen_t length = sizeof(addr);
+        if (fd < 0 || getsockname(fd, (sockaddr*)&addr, &length) < 0)
+            return {};
+        return {ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port)};
+    }
+
+    bool Send(const NetAddress_t &to, const void *data, size_t size) {
+        sockaddr_in addr = ToSockAddr(to);
+        ssize_t sent = sendto(fd, data, size, 0, (sockaddr*)&addr, sizeof(addr));
+        if (sent < 0) {
+            SDL_Log("UdpSocket: sendto failed: %s", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    // Bytes read, or -1 when nothing is waiting
+    int Receive(void *buffer, size_t size, NetAddress_t &from) {
+        sockaddr_in addr;
+        socklen_t length = sizeof(addr);
+        ssize_t received = recvfrom(fd, buffer, size, 0, (sockaddr*)&addr, &length);
+        if (received < 0)
+            return -1;
+        from = {ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port)};
+        return (int)received;
+    }
+};
@@ -3,8 +3,8 @@
 #include "../CollisionSystem/collisionsystem.h"
 #include "../AnimatedEntity/animatedentity.h"
 #include "../Camera/camera.h"
-#include <SDL3/SDL_keyboard.h>
-#include <SDL3/SDL_scancode.h>
+#include "../DeferredWrites/deferredwrites.h"
+#include "../InputSystem/inputsystem.h"
 
 #define GRAVITY 980.0f
 
@@ -14,17 +14,60 @@ enum class PlayerAnimationState_t {
 };
 
 class Player : public AnimatedEntity {
+    DECLARE_POOLED_ENTITY(Player)
+
 private:
     float speed = 200.0f;
     bool isOnGround = false;
     const float groundCheckDistance = 2.0f;
-    PlayerAnimationState_t animState;
+    PlayerAnimationState_t animState = PlayerAnimationState_t::IDLE;
+    uint8_t inputSlot = 0;
+    bool followCamera = true;
 
 public:
+    Player() { type = EntityType::PLAYER; }
+
     bool IsOnGround() {
         return isOnGround;
     }
 
+    // Which InputSystem slot drives this player
+    void SetInputSlot(int slot) {
+        inputSlot = (uint8_t)slot;
+    }
+
+    int GetInputSlot() const {
+        return inputSlot;
+    }
+
+    // Off for players that aren't the one on screen, and for every player
+    // when the camera isn't part of the simulated state (rollback)
+    void SetFollowCamera(bool follow) {
+        followCamera = follow;
+    }
+
+    void SaveState(SnapshotWriter &w) const override {
+        AnimatedEntity::SaveState(w);
+        w.Write(speed);
+        w.Write(isOnGround);
+        w.Write(animState);
+        w.Write(inputSlot);
+        w.Write(followCamera);
+    }
+
+    void LoadState(SnapshotReader &r) override {
+        AnimatedEntity::LoadState(r);
+        r.Read(speed);
+        r.Read(isOnGround);
+        r.Read(animState);
+        r.Read(inputSlot);
+        r.Read(followCamera);
+    }
+
+    // Traces read other entities' positions while they move, players update
+    // serially in list order so the result is deterministic
+    bool IsParallelSafe() const override { return false; }
+
     void InitializeAnimations() override {
         animations["idle"] = {
             {
@@ -66,17 +109,18 @@ public:
             animState = PlayerAnimationState_t::RUN;
         }
 
-        UpdateAnimation(dt, animState == PlayerAnimationState_t::IDLE ? "idle" : "walk");
+        // Frames are ticked by World::TickAnimations
+        SetAnimation(animState == PlayerAnimationState_t::IDLE ? "idle" : "walk");
 
-        const bool* keys = SDL_GetKeyboardState(nullptr);
+        InputState_t input = InputSystem::GetInstance().Get(inputSlot);
         Vector2 moveDir = {0.0f, 0.0f};
 
         // Input
-        if (keys[SDL_SCANCODE_A]) {
+        if (input.Down(INPUT_LEFT)) {
             flipX = true;
             moveDir.x -= 1.0f;
         }
-        if (keys[SDL_SCANCODE_D]) {
+        if (input.Down(INPUT_RIGHT)) {
             flipX = false;
             moveDir.x += 1.0f;
         }
@@ -90,7 +134,7 @@ public:
             velocity.y = 0.0f;
 
         // Jump
-        if (keys[SDL_SCANCODE_W] && isOnGround) {
+        if (input.Down(INPUT_JUMP) && isOnGround) {
             velocity.y = -400.0f; // upward impulse
             isOnGround = false;
         }
@@ -177,9 +221,15 @@ public:
             }
         }
 
+        if (!followCamera)
+            return;
+
         // Follow camera
-        Vector2 oldPos = Camera::GetInstance().GetPosition();
-        oldPos.Lerp(position, 25.0f * dt);
-        Camera::GetInstance().SetPosition(oldPos);
+        Vector2 target = position;
+        DeferredWrites::GetInstance().Push([target, dt]() {
+            Vector2 oldPos = Camera::GetInstance().GetPosition();
+            oldPos.Lerp(target, 25.0f * dt);
+            Camera::GetInstance().SetPosition(oldPos);
+        });
     }
 };
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_render.h>
+#include "../Engine/enginecontext.h"
+#include "../World/world.h"
+#include "../Screen/screen.h"
+#include "../Camera/camera.h"
+#include "../Material/materialmanager.h"
+#include "../SpriteBatch/spritebatch.h"
+#include "../SpriteEntity/spriteentity.h"
+#include "../TiledSpriteEntity/tiledspriteentity.h"
+#include "../Tilemap/tilemap.h"
+#include "../FramePipeline/framepipeline.h"
+
+struct RenderBenchSettings_t {
+    int sprites = 2000;
+    int tiledSprites = 200;     // static, so the chunk cache takes them
+    int rects = 500;
+    int tilemapSize = 128;      // cells per side, 0 for none
+    int frames = 300;
+    bool compareUnbatched = true;   // second run with SpriteBatch off, the pixels must match
+    bool compareThreaded = true;    // chunk cache off, drawn directly and through a FramePipeline, must match
+    uint64_t expectHash = 0;        // run hash to match, 0 to only report it
+};
+
+struct RenderBenchResult_t {
+    double averageMs = 0.0, medianMs = 0.0, p95Ms = 0.0, maxMs = 0.0;
+    double drawCalls = 0.0, textureSwitches = 0.0, quads = 0.0;    // per frame
+    uint64_t lastFrameHash = 0;
+    uint64_t runHash = 0;       // over every frame's hash, in order
+};
+
+namespace RenderBench {
+    inline uint64_t Fnv(uint64_t hash, const uint8_t *data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Row by row, the pitch padding isn't part of the image
+    inline uint64_t HashFrame(SDL_Renderer *renderer) {
+        SDL_Surface *frame = SDL_RenderReadPixels(renderer, nullptr);
+        if (!frame) {
+            SDL_Log("Render bench: couldn't read pixels: %s", SDL_GetError());
+            return 0;
+        }
+        uint64_t hash = 1469598103934665603ull;
+        const uint8_t *pixels = (const uint8_t*)frame->pixels;
+        for (int y = 0; y < frame->h; y++)
+            hash = Fnv(hash, pixels + (size_t)y * frame->pitch, (size_t)frame->w * 4);
+        SDL_DestroySurface(frame);
+        return hash;
+    }
+
+    // Tileset of 8x4 cells of 16 px, each a different colour with a border
+    // so filtering and misplaced texture coordinates show in the hash
+    inline SDL_Surface* MakeSheet(uint32_t seed) {
+        SDL_Surface *sheet = SDL_CreateSurface(128, 64, SDL_PIXELFORMAT_RGBA32);
+        if (!sheet)
+            return nullptr;
+        uint8_t *pixels = (uint8_t*)sheet->pixels;
+        for (int y = 0; y < sheet->h; y++) {
+            for (int x = 0; x < sheet->w; x++) {
+                uint32_t cell = (uint32_t)((y / 16) * 8 + x / 16) * 2654435761u + seed;
+                bool border = x % 16 == 0 || y % 16 == 0;
+                uint8_t *p = pixels + (size_t)y * sheet->pitch + x * 4;
+                p[0] = border ? 0 : (uint8_t)(cell >> 8);
+                p[1] = border ? 0 : (uint8_t)(cell >> 16);
+                p[2] = border ? 0 : (uint8_t)(cell >> 24);
+                p[3] = (x % 16 == 8 && y % 16 == 8) ? 0 : 255;   // one see-through texel per cell
+            }
+        }
+        return sheet;
+    }
+
+    // Same scene for the same settings, every entity drawn through its own Draw
+    inline bool BuildScene(const RenderBenchSettings_t &settings) {
+        MaterialManager &materials = MaterialManager::GetInstance();
+        Material *sheets[3] = {};
+        for (int i = 0; i < 3; i++) {
+            SDL_Surface *image = MakeSheet(0x9e3779b9u * (uint32_t)(i + 1));
+            if (image) {
+                sheets[i] = materials.AddMaterial("bench" + std::to_string(i), image);
+                SDL_DestroySurface(image);
+            }
+            if (!sheets[i])
+                return false;
+        }
+
+        World &world = World::GetInstance();
+        world.SetMaxEntities(settings.sprites + settings.tiledSprites + settings.rects + 1);
+        uint32_t rng = 12345;
+        auto next = [&rng]() {
+            rng = rng * 1664525u + 1013904223u;
+            return rng >> 8;
+        };
+        auto place = [&next](Entity *e) {
+            e->SetPosition({(float)(next() % 2400) - 1200.0f, (float)(next() % 2400) - 1200.0f});
+        };
+
+        if (settings.tilemapSize > 0) {
+            Tilemap *tilemap = new Tilemap();
+            tilemap->SetMaterial(sheets[0]);
+            tilemap->SetTileSize(16);
+            tilemap->Resize(settings.tilemapSize, settings.tilemapSize);
+            for (int y = 0; y < settings.tilemapSize; y++) {
+                for (int x = 0; x < settings.tilemapSize; x++)
+                    tilemap->SetTile(x, y, (uint16_t)((x / 4 + y / 3) % 33));   // 0 leaves holes
+            }
+            world.AddEntity(tilemap);
+        }
+        for (int i = 0; i < settings.tiledSprites; i++) {
+            TiledSpriteEntity *tiled = new TiledSpriteEntity();
+            tiled->SetMaterial(sheets[1]);
+            tiled->SetRegion((float)(next() % 8) * 16.0f, (float)(next() % 4) * 16.0f, 16.0f, 16.0f);
+            tiled->SetSize({(float)(16 + next() % 96), (float)(16 + next() % 48)});
+            tiled->SetStatic(true);
+            tiled->SetRenderLayer(1);
+            place(tiled);
+            world.AddEntity(tiled);
+        }
+        for (int i = 0; i < settings.sprites; i++) {
+            SpriteEntity *sprite = new SpriteEntity();
+            sprite->SetMaterial(sheets[next() % 3]);
+            sprite->SetRegion((float)(next() % 8) * 16.0f, (float)(next() % 4) * 16.0f, 16.0f, 16.0f);
+            sprite->SetFlip(next() % 2, next() % 2);
+            sprite->SetScale(1.0f + (float)(next() % 3));
+            sprite->SetRenderLayer(2);
+            place(sprite);
+            world.AddEntity(sprite);
+        }
+        for (int i = 0; i < settings.rects; i++) {
+            Entity *rect = new Entity();
+            rect->SetSize({(float)(4 + next() % 40), (float)(4 + next() % 40)});
+            rect->SetColor({(float)(next() % 256), (float)(next() % 256), (float)(next() % 256), 255});
+            rect->SetRenderLayer(2);
+            place(rect);
+            world.AddEntity(rect);
+        }
+        world.FlushCommands();
+        return true;
+    }
+
+    struct RunMode_t {
+        bool batched = true;
+        bool drawCache = true;
+        bool threaded = false;      // recorded on a FramePipeline thread, pipelined
+    };
+
+    // Pans a square and zooms in and out
+    inline void MoveCamera(int frame) {
+        Camera &camera = Camera::GetInstance();
+        int phase = frame % 240;
+        float t = (float)(phase < 120 ? phase : 240 - phase) / 120.0f;
+        camera.SetPosition({-600.0f + 1200.0f * t, -300.0f + 600.0f * (float)((frame / 60) % 2)});
+        camera.SetZoom(0.75f + t);
+        camera.SavePreviousPosition();
+    }
+
+    // One run in a fresh context with its own offscreen renderer
+    inline bool Run(const RenderBenchSettings_t &settings, RunMode_t mode, RenderBenchResult_t &result) {
+        EngineContext context;
+        EngineContext::Scope scope(context);
+        Screen &screen = Screen::GetInstance();
+        if (!screen.InitOffscreen() || !BuildScene(settings)) {
+            World::GetInstance().ClearEntities();
+            MaterialManager::GetInstance().UnloadAll();
+            return false;
+        }
+
+        SDL_Renderer *renderer = screen.GetRenderer();
+        World &world = World::GetInstance();
+        SpriteBatch &batch = SpriteBatch::GetInstance();
+        batch.SetEnabled(mode.batched);
+        world.SetDrawCache(mode.drawCache);
+
+        // Threaded, the frame drawn is the one recorded during the last
+        // frame, like a game with --render-thread
+        FramePipeline pipeline;
+        int recorded = 0;
+        if (mode.threaded) {
+            pipeline.Start([&world, &recorded](DrawList_t &list) {
+                MoveCamera(recorded++);
+                world.Interpolate(1.0f);
+                world.RecordEntities(list);
+            });
+        }
+
+        std::vector<double> frameMs;
+        frameMs.reserve(settings.frames);
+        uint64_t runHash = 1469598103934665603ull;
+        for (int frame = 0; frame < settings.frames; frame++) {
+            if (!mode.threaded) {
+                MoveCamera(frame);
+                world.Interpolate(1.0f);
+            }
+
+            // Includes the rasterization, SDL would otherwise defer it to the read back
+            Uint64 start = SDL_GetTicksNS();
+            if (mode.threaded) {
+                pipeline.Sync();
+                pipeline.Kick();
+            }
+            SDL_SetRenderDrawColor(renderer, 20, 24, 32, 255);
+            SDL_RenderClear(renderer);
+            if (mode.threaded) {
+                batch.Begin();
+                RenderQueue::Draw(pipeline.GetFront(), batch);
+                batch.End();
+            } else {
+                world.DrawEntities();
+            }
+            SDL_FlushRenderer(renderer);
+            frameMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+
+            const SpriteBatchStats_t &stats = batch.GetStats();
+            result.drawCalls += stats.drawCalls;
+            result.textureSwitches += stats.textureSwitches;
+            result.quads += stats.quads;
+
+            result.lastFrameHash = HashFrame(renderer);
+            runHash = Fnv(runHash, (const uint8_t*)&result.lastFrameHash, sizeof(result.lastFrameHash));
+        }
+        result.runHash = runHash;
+        pipeline.Stop();
+
+        int frames = std::max(settings.frames, 1);
+        result.drawCalls /= frames;
+        result.textureSwitches /= frames;
+        result.quads /= frames;
+        if (!frameMs.empty()) {
+            for (double ms : frameMs)
+                result.averageMs += ms;
+            result.averageMs /= frameMs.size();
+            std::sort(frameMs.begin(), frameMs.end());
+            result.medianMs = frameMs[frameMs.size() / 2];
+            result.p95Ms = frameMs[std::min(frameMs.size() - 1, frameMs.size() * 95 / 100)];
+            result.maxMs = frameMs.back();
+        }
+
+        // Textures go before the renderer does, and entity teardown reaches
+        // for per-context services, so clear inside the scope
+        world.ClearEntities();
+        MaterialManager::GetInstance().UnloadAll();
+        return true;
+    }
+
+    inline void Log(const char *name, const RenderBenchResult_t &r) {
+        SDL_Log("  %-9s avg %.3f ms, median %.3f, p95 %.3f, max %.3f | %.1f draw calls, %.1f texture switches, %.0f quads | hash %016llx",
+                name, r.averageMs, r.medianMs, r.p95Ms, r.maxMs, r.drawCalls, r.textureSwitches, r.quads,
+                (unsigned long long)r.runHash);
+    }
+}
+
+// Draws a scripted scene with the software renderer for a number of frames
+// and hashes every frame read back with SDL_RenderReadPixels. The run hash
+// changes with any pixel, so a renderer change can be checked for speed and
+// for identical output (--render-bench-expect). False if a run failed or
+// the hashes disagree.
+inline bool RunRenderBench(const RenderBenchSettings_t &settings) {
+    SDL_Log("Render bench: %d sprites, %d tiled sprites, %d rects, %dx%d tilemap, %d frames",
+            settings.sprites, settings.tiledSprites, settings.rects, settings.tilemapSize, settings.tilemapSize,
+            settings.frames);
+
+    RenderBenchResult_t batched;
+    if (!RenderBench::Run(settings, {}, batched)) {
+        SDL_Log("Render bench: couldn't set up the offscreen renderer");
+        return false;
+    }
+    RenderBench::Log("batched", batched);
+
+    bool ok = true;
+    if (settings.compareUnbatched) {
+        RenderBenchResult_t unbatched;
+        if (RenderBench::Run(settings, {false, true, false}, unbatched)) {
+            RenderBench::Log("unbatched", unbatched);
+            if (unbatched.runHash != batched.runHash) {
+                SDL_Log("Render bench: batched and unbatched frames differ");
+                ok = false;
+            }
+        } else {
+            SDL_Log("Render bench: the unbatched run failed");
+            ok = false;
+        }
+    }
+
+    // Recording bypasses the chunk cache, so the reference doesn't cache either
+    if (settings.compareThreaded) {
+        RenderBenchResult_t uncached, threaded;
+        if (RenderBench::Run(settings, {true, false, false}, uncached) &&
+            RenderBench::Run(settings, {true, false, true}, threaded)) {
+            RenderBench::Log("uncached", uncached);
+            RenderBench::Log("threaded", threaded);
+            if (threaded.runHash != uncached.runHash) {
+                SDL_Log("Render bench: threaded and direct frames differ");
+                ok = false;
+            }
+        } else {
+            SDL_Log("Render bench: the uncached or threaded run failed");
+            ok = false;
+        }
+    }
+
+    if (settings.expectHash && settings.expectHash != batched.runHash) {
+        SDL_Log("Render bench: hash %016llx, expected %016llx", (unsigned long long)batched.runHash,
+                (unsigned long long)settings.expectHash);
+        ok = false;
+    }
+    SDL_Log("Render bench: %s", ok ? "ok" : "FAILED");
+    return ok;
+}
@@ -0,0 +1,420 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+#include <SDL3/SDL.h>
+#include "../SpriteBatch/spritebatch.h"
+#include "../Engine/enginecontext.h"
+
+// How a layer orders its items, layers themselves always draw in ascending
+// order
+enum class LayerSort_t : uint8_t {
+    SUBMISSION,     // insertion order, items that don't overlap grouped by texture
+    MATERIAL,       // grouped by texture, for layers whose items don't overlap
+    Y               // bottom edge top to bottom, top-down scenes
+};
+
+enum class RenderItemKind_t : uint8_t {
+    SPRITE,
+    TILED,
+    RECT,
+    QUADS
+};
+
+// One queued draw, what the matching SpriteBatch call takes
+struct RenderItem_t {
+    SDL_Texture *texture;
+    SDL_FRect src;
+    SDL_FRect dst;
+    SDL_FColor color;
+    float scale;            // tiled and quads
+    RenderItemKind_t kind;
+    bool flipX, flipY;
+    const SDL_Vertex *quads;    // quads only, dst.x/y is the offset
+    int quadCount;
+};
+
+// A frame's items in draw order with their own copy of the quad vertices,
+// so it stays valid while entities and tilemaps move on to the next frame.
+// Recorded with RenderQueue::Record, drawn with RenderQueue::Draw.
+struct DrawList_t {
+    std::vector<RenderItem_t> items;
+    std::vector<SDL_Vertex> vertices;   // the items' quads point in here
+};
+
+struct RenderQueueStats_t {
+    int items = 0;
+    double sortMs = 0.0;
+    bool incremental = false;   // last frame's order was reused
+    int shifts = 0;             // insertion sort moves when incremental
+    int grouped = 0;            // items drawn earlier to join their texture's run
+};
+
+// Collects the draw calls of a frame as items with a 64-bit key, sorts them
+// and hands them to the SpriteBatch in order, or records them into a
+// DrawList_t for drawing later. Key, high to low:
+//
+//   layer (8) | depth (40) | material (16)
+//
+// depth is the submission order, one or the y position depending on the
+// layer's LayerSort_t, zero for background owners (cached chunks) in
+// SUBMISSION and MATERIAL layers. Items with equal keys keep submission
+// order.
+//
+// After sorting, SUBMISSION layers are grouped by texture: an item moves
+// back to the last run of its texture when nothing drawn in between
+// overlaps it, so what ends up on screen doesn't change.
+//
+// When the same owners are submitted in the same order as last frame (the
+// usual case with a still camera), the sort starts from last frame's order
+// and only fixes what moved, so y-sorted scenes with a few walkers cost
+// close to a copy. Anything else goes through an LSD radix sort.
+class RenderQueue {
+    private:
+    struct SortEntry_t {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    static constexpr int DEPTH_BITS = 40;
+    static constexpr uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+    static constexpr int GROUP_WINDOW = 16;     // runs an item may move back over
+
+    // A run of one texture while grouping a layer
+    struct TextureRun_t {
+        SDL_Texture *texture;
+        SDL_FRect bounds;
+        bool barrier;       // holds quads, whose bounds aren't known
+    };
+
+    LayerSort_t layerSort[256] = {};
+    uint32_t sortGeneration = 0;    // bumped when a layer's sort changes
+    std::vector<RenderItem_t> items;
+    std::vector<SortEntry_t> entries;
+    std::vector<SortEntry_t> scratch;
+    std::vector<const void*> owners;
+    uint64_t ownerKey = 0;          // layer and depth of the current owner
+    const void *owner = nullptr;
+
+    // Coherence with last frame
+    std::vector<const void*> previousOwners;
+    std::vector<uint32_t> previousOrder;
+
+    // Scratch for GroupTextures
+    std::vector<TextureRun_t> runs;
+    std::vector<uint32_t> runOf;
+    std::vector<uint32_t> runStart;
+
+    // Small ids for the material part of the key, handed out in order of
+    // first use since Begin. Reset every Begin so destroyed textures don't
+    // pile up and a reused address never keeps an old id.
+    std::unordered_map<SDL_Texture*, uint16_t> textureIds;
+
+    RenderQueueStats_t stats;
+
+    RenderQueue(const RenderQueue&) = delete;
+    RenderQueue& operator=(const RenderQueue&) = delete;
+
+    friend class EngineContext;
+    RenderQueue() {}
+
+    // Float bits reordered so unsigned comparison matches float order
+    static uint32_t OrderedFloat(float f) {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+    }
+
+    uint16_t TextureId(SDL_Texture *texture) {
+        if (!texture)
+            return 0;
+        auto it = textureIds.find(texture);
+        if (it != textureIds.end())
+            return it->second;
+        // More textures than ids in one frame: later ones share ids, which
+        // only costs batching
+        if (textureIds.size() >= 0xfffe)
+            return 0xffff;
+        uint16_t id = (uint16_t)(textureIds.size() + 1);
+        textureIds[texture] = id;
+        return id;
+    }
+
+    void Push(const RenderItem_t &item) {
+        entries.push_back({ownerKey | TextureId(item.texture), (uint32_t)items.size()});
+        items.push_back(item);
+        owners.push_back(owner);
+    }
+
+    void RadixSort() {
+        size_t n = entries.size();
+        scratch.resize(n);
+
+        // All eight histograms in one pass, digits every key shares are skipped
+        uint32_t counts[8][256] = {};
+        for (const SortEntry_t &e : entries) {
+            for (int d = 0; d < 8; d++)
+                counts[d][(e.key >> (d * 8)) & 0xff]++;
+        }
+
+        SortEntry_t *from = entries.data(), *to = scratch.data();
+        for (int d = 0; d < 8; d++) {
+            uint32_t *count = counts[d];
+            if (count[(entries[0].key >> (d * 8)) & 0xff] == n)
+                continue;
+            uint32_t offset = 0;
+            for (int b = 0; b < 256; b++) {
+                uint32_t c = count[b];
+                count[b] = offset;
+                offset += c;
+            }
+            for (size_t i = 0; i < n; i++)
+                to[count[(from[i].key >> (d * 8)) & 0xff]++] = from[i];
+            std::swap(from, to);
+        }
+        if (from != entries.data())
+            entries.swap(scratch);
+    }
+
+    // Starts from last frame's order, gives up past a budget of moves
+    bool IncrementalSort() {
+        size_t n = entries.size();
+        if (n == 0 || previousOwners.size() != n || previousOwners != owners)
+            return false;
+
+        scratch.resize(n);
+        for (size_t i = 0; i < n; i++)
+            scratch[i] = entries[previousOrder[i]];
+
+        size_t budget = n * 4, shifts = 0;
+        for (size_t i = 1; i < n; i++) {
+            SortEntry_t e = scratch[i];
+            size_t j = i;
+            while (j > 0 && (scratch[j - 1].key > e.key ||
+                             (scratch[j - 1].key == e.key && scratch[j - 1].item > e.item))) {
+                scratch[j] = scratch[j - 1];
+                j--;
+                if (++shifts > budget)
+                    return false;
+            }
+            scratch[j] = e;
+        }
+        entries.swap(scratch);
+        stats.shifts = (int)shifts;
+        return true;
+    }
+
+    // Touching counts, edge pixels may be shared
+    static bool Overlaps(const SDL_FRect &a, const SDL_FRect &b) {
+        return a.x <= b.x + b.w + 1.0f && b.x <= a.x + a.w + 1.0f &&
+               a.y <= b.y + b.h + 1.0f && b.y <= a.y + a.h + 1.0f;
+    }
+
+    // Groups entries[begin, end), one SUBMISSION layer, by texture. Each
+    // item joins the nearest earlier run of its texture unless a run in
+    // between overlaps it, the runs are then written out in order.
+    void GroupLayer(size_t begin, size_t end) {
+        runs.clear();
+        runOf.resize(end - begin);
+        int moved = 0;
+        for (size_t i = begin; i < end; i++) {
+            const RenderItem_t &item = items[entries[i].item];
+            bool barrier = item.kind == RenderItemKind_t::QUADS;
+            int target = -1;
+            if (!barrier) {
+                int last = (int)runs.size() - 1;
+                for (int r = last; r >= 0 && r > last - GROUP_WINDOW; r--) {
+                    if (runs[r].texture == item.texture && !runs[r].barrier) {
+                        target = r;
+                        break;
+                    }
+                    if (runs[r].barrier || Overlaps(runs[r].bounds, item.dst))
+                        break;
+                }
+            }
+            if (target < 0) {
+                target = (int)runs.size();
+                runs.push_back({item.texture, item.dst, barrier});
+            } else {
+                SDL_FRect &b = runs[target].bounds;
+                float x1 = std::max(b.x + b.w, item.dst.x + item.dst.w);
+                float y1 = std::max(b.y + b.h, item.dst.y + item.dst.h);
+                b.x = std::min(b.x, item.dst.x);
+                b.y = std::min(b.y, item.dst.y);
+                b.w = x1 - b.x;
+                b.h = y1 - b.y;
+                if (target != (int)runs.size() - 1)
+                    moved++;
+            }
+            runOf[i - begin] = (uint32_t)target;
+        }
+        if (moved == 0)
+            return;
+
+        // Counting sort by run, stable within a run
+        runStart.assign(runs.size() + 1, 0);
+        for (uint32_t r : runOf)
+            runStart[r + 1]++;
+        for (size_t r = 1; r < runStart.size(); r++)
+            runStart[r] += runStart[r - 1];
+        scratch.resize(end - begin);
+        for (size_t i = begin; i < end; i++)
+            scratch[runStart[runOf[i - begin]]++] = entries[i];
+        std::copy(scratch.begin(), scratch.begin() + (end - begin), entries.begin() + begin);
+        stats.grouped += moved;
+    }
+
+    void GroupTextures() {
+        size_t n = entries.size();
+        for (size_t begin = 0; begin < n; ) {
+            uint8_t layer = (uint8_t)(entries[begin].key >> 56);
+            size_t end = begin + 1;
+            while (end < n && (uint8_t)(entries[end].key >> 56) == layer)
+                end++;
+            if (layerSort[layer] == LayerSort_t::SUBMISSION && end - begin > 2)
+                GroupLayer(begin, end);
+            begin = end;
+        }
+    }
+
+    // Orders entries, remembers the order for next frame's IncrementalSort
+    void Sort() {
+        Uint64 start = SDL_GetTicksNS();
+        stats.items = (int)entries.size();
+        stats.shifts = 0;
+        stats.grouped = 0;
+        stats.incremental = IncrementalSort();
+        if (!stats.incremental && !entries.empty())
+            RadixSort();
+
+        // Remember the order as positions in this frame's submission. The
+        // key order, before grouping, which the keys don't describe.
+        previousOwners.swap(owners);
+        previousOrder.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+            previousOrder[i] = entries[i].item;
+        GroupTextures();
+        stats.sortMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    static void Replay(const RenderItem_t &item, SpriteBatch &batch) {
+        switch (item.kind) {
+            case RenderItemKind_t::SPRITE: batch.AddSprite(item.texture, item.src, item.dst, item.flipX, item.flipY, item.color); break;
+            case RenderItemKind_t::TILED: batch.AddTiled(item.texture, item.src, item.scale, item.dst, item.flipX, item.flipY, item.color); break;
+            case RenderItemKind_t::RECT: batch.AddRect(item.dst, item.color); break;
+            case RenderItemKind_t::QUADS: batch.AddQuads(item.texture, item.quads, item.quadCount, item.dst.x, item.dst.y, item.scale); break;
+        }
+    }
+
+    public:
+    static RenderQueue& GetInstance() {
+        return EngineContext::Current().Get<RenderQueue>();
+    }
+
+    void Begin() {
+        items.clear();
+        entries.clear();
+        owners.clear();
+        textureIds.clear();
+        owner = nullptr;
+        ownerKey = 0;
+    }
+
+    // Items added until the next call belong to owner. order is used by
+    // SUBMISSION layers, y (bottom edge) by Y layers.
+    void SetOwner(const void *who, uint8_t layer, uint64_t order, float y) {
+        owner = who;
+        uint64_t depth = 0;
+        switch (layerSort[layer]) {
+            case LayerSort_t::SUBMISSION: depth = (order + 1) & DEPTH_MASK; break;
+            case LayerSort_t::MATERIAL: depth = 1; break;
+            case LayerSort_t::Y: depth = (uint64_t)OrderedFloat(y) << 8; break;
+        }
+        ownerKey = ((uint64_t)layer << 56) | (depth << 16);
+    }
+
+    // Items drawn beneath everything else in the layer, unless it's y-sorted
+    void SetBackgroundOwner(const void *who, uint8_t layer) {
+        owner = who;
+        ownerKey = (uint64_t)layer << 56;
+    }
+
+    void AddSprite(SDL_Texture *texture, const SDL_FRect &src, const SDL_FRect &dst, bool flipX = false, bool flipY = false,
+                   SDL_FColor color = {1.0f, 1.0f, 1.0f, 1.0f}) {
+        Push({texture, src, dst, color, 1.0f, RenderItemKind_t::SPRITE, flipX, flipY, nullptr, 0});
+    }
+
+    void AddTiled(SDL_Texture *texture, const SDL_FRect &src, float scale, const SDL_FRect &dst,
+                  bool flipX = false, bool flipY = false, SDL_FColor color = {1.0f, 1.0f, 1.0f, 1.0f}) {
+        Push({texture, src, dst, color, scale, RenderItemKind_t::TILED, flipX, flipY, nullptr, 0});
+    }
+
+    void AddRect(const SDL_FRect &dst, SDL_FColor color) {
+        Push({nullptr, {0, 0, 0, 0}, dst, color, 1.0f, RenderItemKind_t::RECT, false, false, nullptr, 0});
+    }
+
+    // See SpriteBatch::AddQuads. The vertices aren't copied, they have to
+    // stay valid until Submit.
+    void AddQuads(SDL_Texture *texture, const SDL_Vertex *quads, int count, float x, float y, float scale) {
+        Push({texture, {0, 0, 0, 0}, {x, y, 0, 0}, {1.0f, 1.0f, 1.0f, 1.0f}, scale, RenderItemKind_t::QUADS, false, false, quads, count});
+    }
+
+    // Sorts and draws everything queued since Begin into an open batch
+    void Submit(SpriteBatch &batch) {
+        Sort();
+        for (const SortEntry_t &e : entries)
+            Replay(items[e.item], batch);
+    }
+
+    // Sorts like Submit but keeps the result in list instead of drawing it.
+    // Doesn't touch the renderer, the list can be drawn later on another
+    // thread.
+    void Record(DrawList_t &list) {
+        Sort();
+        size_t vertexCount = 0;
+        for (const RenderItem_t &item : items)
+            vertexCount += item.kind == RenderItemKind_t::QUADS ? (size_t)item.quadCount * 4 : 0;
+
+        // Reserved up front so the quad pointers stay put
+        list.items.clear();
+        list.vertices.clear();
+        list.items.reserve(entries.size());
+        list.vertices.reserve(vertexCount);
+        for (const SortEntry_t &e : entries) {
+            RenderItem_t item = items[e.item];
+            if (item.kind == RenderItemKind_t::QUADS) {
+                const SDL_Vertex *copy = list.vertices.data() + list.vertices.size();
+                list.vertices.insert(list.vertices.end(), item.quads, item.quads + (size_t)item.quadCount * 4);
+                item.quads = copy;
+            }
+            list.items.push_back(item);
+        }
+    }
+
+    // Draws a recorded list into an open batch
+    static void Draw(const DrawList_t &list, SpriteBatch &batch) {
+        for (const RenderItem_t &item : list.items)
+            Replay(item, batch);
+    }
+
+    void SetLayerSort(uint8_t layer, LayerSort_t sort) {
+        if (layerSort[layer] != sort)
+            sortGeneration++;
+        layerSort[layer] = sort;
+    }
+
+    LayerSort_t GetLayerSort(uint8_t layer) const {
+        return layerSort[layer];
+    }
+
+    uint32_t GetSortGeneration() const {
+        return sortGeneration;
+    }
+
+    const RenderQueueStats_t& GetStats() const {
+        return stats;
+    }
+};
@@ -6,11 +6,13 @@
 #include <SDL3/SDL_video.h>
 
 #include "../Vector2/vector2.h"
+#include "../Engine/enginecontext.h"
 
 class Screen {
     private:
-    SDL_Window *window;
-    SDL_Renderer *renderer;
+    SDL_Window *window = nullptr;
+    SDL_Renderer *renderer = nullptr;
+    SDL_Surface *offscreen = nullptr;   // target of the software renderer, see InitOffscreen
 
     Screen(const Screen&) = delete;
     Screen& operator=(const Screen&) = delete;
@@ -18,30 +20,62 @@ class Screen {
     static constexpr int WINDOW_WIDTH = 768;
     static constexpr int WINDOW_HEIGHT = 768;
 
-    Screen() {
+    friend class EngineContext;
+    Screen() {}
+
+    // Only the offscreen renderer is owned here, the window lives until SDL_Quit
+    ~Screen() {
+        if (offscreen) {
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroySurface(offscreen);
+        }
+    }
+
+    public:
+
+    static Screen& GetInstance() {
+        return EngineContext::Current().Get<Screen>();
+    };
+
+    // Opens the window. Contexts that only simulate never call this and
+    // have no renderer. Headless skips the video subsystem entirely.
+    bool Init(bool headless = false) {
         SDL_SetAppMetadata("Game", "1.0", "com.navet.game");
 
-        if (!SDL_Init(SDL_INIT_VIDEO)) {
+        if (!SDL_Init(headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO)) {
             SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
-            return;
+            return false;
         }
 
-        float main_scale = SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay());
+        if (headless)
+            return true;
 
         if (!SDL_CreateWindowAndRenderer("Game", WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_RESIZABLE, &window, &renderer)) {
             SDL_Log("Couldn't create window/renderer: %s", SDL_GetError());
-            return;
+            return false;
         }
 
         SDL_SetRenderLogicalPresentation(renderer, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_LOGICAL_PRESENTATION_INTEGER_SCALE);
-    };
-
-    public:
+        return true;
+    }
 
-    static Screen& GetInstance() {
-        static Screen instance;
-        return instance;
-    };
+    // Software renderer drawing into a surface of GetSize, no window and no
+    // GPU. Renders the same on every machine, for benchmarks and pixel
+    // comparisons.
+    bool InitOffscreen() {
+        if (renderer)
+            return false;
+        offscreen = SDL_CreateSurface(WINDOW_WIDTH, WINDOW_HEIGHT, SDL_PIXELFORMAT_RGBA32);
+        renderer = offscreen ? SDL_CreateSoftwareRenderer(offscreen) : nullptr;
+        if (!renderer) {
+            SDL_Log("Couldn't create the offscreen renderer: %s", SDL_GetError());
+            if (offscreen)
+                SDL_DestroySurface(offscreen);
+            offscreen = nullptr;
+            return false;
+        }
+        return true;
+    }
 
     SDL_Window* GetWindow() {
         return window;
@@ -51,6 +85,10 @@ class Screen {
         return renderer;
     }
 
+    bool IsHeadless() const {
+        return renderer == nullptr;
+    }
+
     Vector2 GetSize() {
         return {WINDOW_WIDTH, WINDOW_HEIGHT};
     }
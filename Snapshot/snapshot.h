@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Raw binary writer for simulation state. Values are copied as-is, so a
+// snapshot is only meant to be read back by the same build on the same
+// machine (rollback, instant retry, perf repro), not saved as a file format.
+//
+// Constructed with a hash instead of a buffer it folds every value into the
+// hash and stores nothing, see World::Checksum.
+class SnapshotWriter {
+    private:
+    std::vector<uint8_t> *buffer = nullptr;
+    size_t used = 0;
+    uint64_t *hash = nullptr;
+
+    // Grows geometrically so single field writes are just a memcpy
+    uint8_t* Reserve(size_t bytes) {
+        if (used + bytes > buffer->size())
+            buffer->resize(std::max(buffer->size() * 2, used + bytes + 256));
+        uint8_t *out = buffer->data() + used;
+        used += bytes;
+        return out;
+    }
+
+    // A word at a time, most fields are one or two words
+    void Mix(const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t*)data;
+        uint64_t h = *hash;
+        while (size > 0) {
+            uint64_t word = 0;
+            size_t n = std::min(size, sizeof(word));
+            std::memcpy(&word, bytes, n);
+            h = (h ^ word) * 1099511628211ull;
+            h ^= h >> 32;
+            bytes += n;
+            size -= n;
+        }
+        *hash = h;
+    }
+
+    public:
+    static constexpr uint64_t HASH_SEED = 1469598103934665603ull;
+
+    // Overwrites buffer from the start, reusing its size as scratch space.
+    // With append it writes after the existing contents instead.
+    SnapshotWriter(std::vector<uint8_t> &buffer, bool append = false)
+        : buffer(&buffer), used(append ? buffer.size() : 0) {}
+    // Start hash at HASH_SEED
+    explicit SnapshotWriter(uint64_t &hash) : hash(&hash) {}
+    ~SnapshotWriter() {
+        if (buffer)
+            buffer->resize(used);
+    }
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    template <typename T>
+    void Write(const T &value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        if (hash)
+            Mix(&value, sizeof(T));
+        else
+            std::memcpy(Reserve(sizeof(T)), &value, sizeof(T));
+    }
+
+    void WriteString(const std::string &value) {
+        Write((uint32_t)value.size());
+        if (value.empty())
+            return;
+        if (hash)
+            Mix(value.data(), value.size());
+        else
+            std::memcpy(Reserve(value.size()), value.data(), value.size());
+    }
+};
+
+class SnapshotReader {
+    private:
+    const uint8_t *data;
+    size_t size;
+    size_t offset = 0;
+    bool ok = true;
+
+    public:
+    SnapshotReader(const std::vector<uint8_t> &buffer) : data(buffer.data()), size(buffer.size()) {}
+
+    template <typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values must be trivially copyable");
+        T value{};
+        if (offset + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    template <typename T>
+    void Read(T &out) {
+        out = Read<T>();
+    }
+
+    void ReadString(std::string &out) {
+        uint32_t length = Read<uint32_t>();
+        if (offset + length > size) {
+            ok = false;
+            return;
+        }
+        // assign() reuses the string's capacity, no allocation once warmed up
+        out.assign((const char*)data + offset, length);
+        offset += length;
+    }
+
+    bool IsOk() const { return ok; }
+    bool AtEnd() const { return offset == size; }
+};
+
+// Contiguous buffer holding the full simulation state, see
+// World::SaveSnapshot / RestoreSnapshot.
+struct Snapshot {
+    std::vector<uint8_t> data;
+
+    // FNV-1a over the whole buffer, for desync and regression checks
+    uint64_t Checksum() const {
+        uint64_t hash = 1469598103934665603ull;
+        for (uint8_t b : data) {
+            hash ^= b;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Delta against a base snapshot: the two buffers are XORed and the
+    // result is stored as alternating runs of zero bytes (skipped) and
+    // literal bytes, with varint lengths. Snapshots of consecutive frames
+    // share their layout, so most of the XOR is zero.
+    void EncodeDelta(const Snapshot &base, std::vector<uint8_t> &out) const {
+        out.clear();
+        WriteVarint(out, data.size());
+
+        size_t i = 0;
+        size_t count = data.size();
+        while (i < count) {
+            size_t zeros = 0;
+            while (i + zeros < count && XorAt(base, i + zeros) == 0)
+                zeros++;
+            i += zeros;
+
+            size_t literals = 0;
+            while (i + literals < count && XorAt(base, i + literals) != 0)
+                literals++;
+
+            WriteVarint(out, zeros);
+            WriteVarint(out, literals);
+            for (size_t n = 0; n < literals; n++)
+                out.push_back(XorAt(base, i + n));
+            i += literals;
+        }
+    }
+
+    // Rebuilds this snapshot from base + a delta made by EncodeDelta
+    bool DecodeDelta(const Snapshot &base, const std::vector<uint8_t> &delta) {
+        size_t pos = 0;
+        uint64_t count;
+        if (!ReadVarint(delta, pos, count))
+            return false;
+
+        data.resize(count);
+        for (size_t i = 0; i < count; i++)
+            data[i] = i < base.data.size() ? base.data[i] : 0;
+
+        size_t i = 0;
+        while (pos < delta.size()) {
+            uint64_t zeros, literals;
+            if (!ReadVarint(delta, pos, zeros) || !ReadVarint(delta, pos, literals))
+                return false;
+            i += zeros;
+            if (i + literals > count || pos + literals > delta.size())
+                return false;
+            for (size_t n = 0; n < literals; n++)
+                data[i + n] ^= delta[pos + n];
+            i += literals;
+            pos += literals;
+        }
+        return true;
+    }
+
+    private:
+    uint8_t XorAt(const Snapshot &base, size_t i) const {
+        return data[i] ^ (i < base.data.size() ? base.data[i] : 0);
+    }
+
+    static void WriteVarint(std::vector<uint8_t> &out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    static bool ReadVarint(const std::vector<uint8_t> &in, size_t &pos, uint64_t &value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= in.size())
+                return false;
+            uint8_t b = in[pos++];
+            value |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+#include <vector>
+#include <SDL3/SDL.h>
+#include <SDL3/SDL_render.h>
+#include "../Screen/screen.h"
+#include "../Engine/enginecontext.h"
+
+struct SpriteBatchStats_t {
+    int drawCalls = 0;
+    int vertices = 0;
+    int quads = 0;
+    int textureSwitches = 0;    // texture changes between quads
+};
+
+// Collects quads into one vertex buffer and submits them with a single
+// SDL_RenderGeometry call per run of the same texture, instead of one
+// SDL_RenderTexture/SDL_RenderFillRect per entity. Quads keep their
+// submission order, so overlapping sprites draw exactly as before; a
+// texture change (or a plain rect between sprites) starts a new batch.
+class SpriteBatch {
+    private:
+    SDL_Renderer *renderer = nullptr;
+    SDL_Texture *texture = nullptr;     // of the open batch, null for plain rects
+    float texelW = 1.0f, texelH = 1.0f; // 1 / texture size
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;           // same pattern for every batch, grown on demand
+    bool enabled = true;
+    bool open = false;
+    SpriteBatchStats_t stats;
+    SpriteBatchStats_t frameStats;
+
+    SpriteBatch(const SpriteBatch&) = delete;
+    SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+    friend class EngineContext;
+    SpriteBatch() {}
+
+    void Use(SDL_Texture *t) {
+        if (t == texture)
+            return;
+        if (stats.quads > 0)
+            stats.textureSwitches++;
+        Flush();
+        texture = t;
+        if (t) {
+            float w = 1.0f, h = 1.0f;
+            SDL_GetTextureSize(t, &w, &h);
+            texelW = 1.0f / w;
+            texelH = 1.0f / h;
+        }
+    }
+
+    void Push(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, SDL_FColor color) {
+        vertices.push_back({{x0, y0}, color, {u0, v0}});
+        vertices.push_back({{x1, y0}, color, {u1, v0}});
+        vertices.push_back({{x1, y1}, color, {u1, v1}});
+        vertices.push_back({{x0, y1}, color, {u0, v1}});
+        stats.quads++;
+        if (!enabled)
+            Flush();
+    }
+
+    public:
+    static SpriteBatch& GetInstance() {
+        return EngineContext::Current().Get<SpriteBatch>();
+    }
+
+    void Begin() {
+        renderer = Screen::GetInstance().GetRenderer();
+        vertices.clear();
+        texture = nullptr;
+        stats = SpriteBatchStats_t();
+        open = true;
+    }
+
+    // Submits what is left, the counts of this frame go to GetStats
+    void End() {
+        Flush();
+        open = false;
+        frameStats = stats;
+    }
+
+    void Flush() {
+        if (vertices.empty())
+            return;
+
+        size_t quads = vertices.size() / 4;
+        if (indices.size() < quads * 6) {
+            size_t first = indices.size() / 6;
+            indices.resize(quads * 6);
+            for (size_t q = first; q < quads; q++) {
+                int base = (int)(q * 4);
+                int *i = &indices[q * 6];
+                i[0] = base; i[1] = base + 1; i[2] = base + 2;
+                i[3] = base; i[4] = base + 2; i[5] = base + 3;
+            }
+        }
+
+        SDL_RenderGeometry(renderer, texture, vertices.data(), (int)vertices.size(), indices.data(), (int)(quads * 6));
+        stats.drawCalls++;
+        stats.vertices += (int)vertices.size();
+        vertices.clear();
+    }
+
+    // src in texels, dst in screen pixels. Flip mirrors the texture
+    // coordinates, dst stays as is.
+    void AddSprite(SDL_Texture *t, const SDL_FRect &src, const SDL_FRect &dst, bool flipX = false, bool flipY = false,
+                   SDL_FColor color = {1.0f, 1.0f, 1.0f, 1.0f}) {
+        if (!open) {
+            SDL_Log("SpriteBatch: AddSprite outside Begin/End");
+            return;
+        }
+        Use(t);
+        float u0 = src.x * texelW, v0 = src.y * texelH;
+        float u1 = (src.x + src.w) * texelW, v1 = (src.y + src.h) * texelH;
+        if (flipX)
+            std::swap(u0, u1);
+        if (flipY)
+            std::swap(v0, v1);
+        Push(dst.x, dst.y, dst.x + dst.w, dst.y + dst.h, u0, v0, u1, v1, color);
+    }
+
+    // Same result as SDL_RenderTextureTiled: src repeated at scale from the
+    // top left of dst, the last row and column cut to fit
+    void AddTiled(SDL_Texture *t, const SDL_FRect &src, float scale, const SDL_FRect &dst,
+                  bool flipX = false, bool flipY = false, SDL_FColor color = {1.0f, 1.0f, 1.0f, 1.0f}) {
+        float tileW = src.w * scale, tileH = src.h * scale;
+        if (tileW <= 0.0f || tileH <= 0.0f)
+            return;
+
+        SDL_FRect tileSrc, tileDst;
+        for (float y = 0.0f; y < dst.h; y += tileH) {
+            float h = std::fmin(tileH, dst.h - y);
+            tileSrc.y = src.y;
+            tileSrc.h = src.h * (h / tileH);
+            tileDst.y = dst.y + y;
+            tileDst.h = h;
+            for (float x = 0.0f; x < dst.w; x += tileW) {
+                float w = std::fmin(tileW, dst.w - x);
+                tileSrc.x = src.x;
+                tileSrc.w = src.w * (w / tileW);
+                tileDst.x = dst.x + x;
+                tileDst.w = w;
+                AddSprite(t, tileSrc, tileDst, flipX, flipY, color);
+            }
+        }
+    }
+
+    // Prebuilt quads (4 vertices each, normalized texture coordinates),
+    // positions scaled by scale and moved by (x, y). For geometry that is
+    // built once and drawn many frames, like Tilemap chunks.
+    void AddQuads(SDL_Texture *t, const SDL_Vertex *quads, int count, float x, float y, float scale) {
+        if (!open) {
+            SDL_Log("SpriteBatch: AddQuads outside Begin/End");
+            return;
+        }
+        Use(t);
+        for (int q = 0; q < count; q++) {
+            for (int v = 0; v < 4; v++) {
+                SDL_Vertex vertex = quads[q * 4 + v];
+                vertex.position.x = vertex.position.x * scale + x;
+                vertex.position.y = vertex.position.y * scale + y;
+                vertices.push_back(vertex);
+            }
+            stats.quads++;
+            if (!enabled)
+                Flush();
+        }
+    }
+
+    // Untextured, what SDL_RenderFillRect would draw
+    void AddRect(const SDL_FRect &dst, SDL_FColor color) {
+        if (!open) {
+            SDL_Log("SpriteBatch: AddRect outside Begin/End");
+            return;
+        }
+        Use(nullptr);
+        Push(dst.x, dst.y, dst.x + dst.w, dst.y + dst.h, 0.0f, 0.0f, 0.0f, 0.0f, color);
+    }
+
+    // Disabled submits every quad on its own, for comparing
+    void SetEnabled(bool enable) {
+        enabled = enable;
+    }
+
+    bool IsEnabled() const {
+        return enabled;
+    }
+
+    // Counts of the last finished frame
+    const SpriteBatchStats_t& GetStats() const {
+        return frameStats;
+    }
+};
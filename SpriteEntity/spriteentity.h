@@ -1,9 +1,12 @@
 #pragma once
 
 #include "../Entity/entity.h"
+#include "../Material/materialmanager.h"
 #include <SDL3/SDL_render.h>
 
-class SpriteEntity: public Entity {    
+class SpriteEntity: public Entity {
+    DECLARE_POOLED_ENTITY(SpriteEntity)
+
     protected:
     bool flipX = false, flipY = false;
     Material* material = nullptr;
@@ -12,6 +15,8 @@ class SpriteEntity: public Entity {
     SDL_FRect srcRect = {0, 0, 0, 0};
 
     public:
+    SpriteEntity() { type = EntityType::SPRITE_ENTITY; }
+
     void SetMaterial(Material* m) { material = m; }
     Material* GetMaterial() const { return material; }
 
@@ -22,6 +27,33 @@ class SpriteEntity: public Entity {
         srcRect.w = w;
         srcRect.h = h;
     }
+    SDL_FRect GetRegion() const { return srcRect; }
+
+    Vector2 GetDrawSize() const override { return {srcRect.w, srcRect.h}; }
+
+    void SetFlip(bool x, bool y) {
+        flipX = x;
+        flipY = y;
+    }
+    bool GetFlipX() const { return flipX; }
+    bool GetFlipY() const { return flipY; }
+
+    void SaveState(SnapshotWriter &w) const override {
+        Entity::SaveState(w);
+        w.Write(flipX);
+        w.Write(flipY);
+        // Load order index so checksums match between processes
+        w.Write(MaterialManager::GetInstance().GetMaterialIndex(material));
+        w.Write(srcRect);
+    }
+
+    void LoadState(SnapshotReader &r) override {
+        Entity::LoadState(r);
+        r.Read(flipX);
+        r.Read(flipY);
+        material = MaterialManager::GetInstance().GetMaterialByIndex(r.Read<int32_t>());
+        r.Read(srcRect);
+    }
 
     void Draw() override {
         if (!material || !material->GetTexture()) {
@@ -29,22 +61,15 @@ class SpriteEntity: public Entity {
             return;
         }
 
-        SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
         Camera& camera = Camera::GetInstance();
-        Vector2 screenPos = camera.WorldToScreen(position);
+        Vector2 screenPos = camera.WorldToScreen(renderPosition);
 
         SDL_FRect rect;
-        rect.w = (flipX ? -1.0f : 1.0f) * srcRect.w * camera.GetZoomOnScreen(scale);
-        rect.h = (flipY ? -1.0f : 1.0f) * srcRect.h * camera.GetZoomOnScreen(scale);
+        rect.w = srcRect.w * camera.GetZoomOnScreen(scale);
+        rect.h = srcRect.h * camera.GetZoomOnScreen(scale);
         rect.x = screenPos.x - (rect.w * 0.5f);
         rect.y = screenPos.y - (rect.h * 0.5f);
 
-        /* debug */
-        //SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-        //SDL_RenderFillRect(renderer, &rect);
-        /**/
-
-        // Use srcRect only if useRegion is true, otherwise use entire texture
-        SDL_RenderTexture(renderer, material->GetTexture(), &srcRect, &rect);
+        RenderQueue::GetInstance().AddSprite(material->GetDrawTexture(), material->DrawRegion(srcRect), rect, flipX, flipY);
     }
 };
\ No newline at end of file
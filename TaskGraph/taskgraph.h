@@ -0,0 +1,184 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../ThreadPool/threadpool.h"
+
+struct TaskNode_t {
+    std::string name;
+    std::function<void()> fn;
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    bool mainThread = false;        // must run on the thread calling Run()
+    std::vector<int> dependencies;
+    std::vector<int> dependents;
+
+    // Profiling data from the last Run(), relative to its start
+    double startMs = 0.0;
+    double durationMs = 0.0;
+    bool ranOnMain = false;
+
+    std::atomic<int> waiting{0};
+};
+
+// Frame scheduler. Tasks declare which resources they read and write, and
+// a task depends on every earlier task it conflicts with (write/read,
+// read/write or write/write on the same resource). Run() executes the graph
+// on the ThreadPool, so tasks without a conflict overlap.
+class TaskGraph {
+    private:
+    std::vector<std::unique_ptr<TaskNode_t>> nodes;
+    std::vector<std::string> resources;
+
+    TaskGroup group;
+    std::vector<int> mainReady;
+    std::mutex mainMutex;
+    std::atomic<int> remaining{0};
+    Uint64 runStart = 0;
+    double lastFrameMs = 0.0;
+
+    uint64_t Mask(const std::vector<const char*> &names) {
+        uint64_t mask = 0;
+        for (const char *name : names)
+            mask |= 1ull << Resource(name);
+        return mask;
+    }
+
+    void Execute(int index, bool onMain) {
+        TaskNode_t &node = *nodes[index];
+        Uint64 start = SDL_GetTicksNS();
+        node.fn();
+        Uint64 end = SDL_GetTicksNS();
+        node.startMs = (double)(start - runStart) / 1e6;
+        node.durationMs = (double)(end - start) / 1e6;
+        node.ranOnMain = onMain;
+
+        for (int next : node.dependents) {
+            if (--nodes[next]->waiting == 0)
+                Schedule(next);
+        }
+        remaining--;
+    }
+
+    void Schedule(int index) {
+        if (nodes[index]->mainThread) {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            mainReady.push_back(index);
+            return;
+        }
+
+        ThreadPool::GetInstance().Submit(group, [this, index]() { Execute(index, false); });
+    }
+
+    public:
+    // Returns the bit used for a named resource, at most 64 of them
+    int Resource(const char *name) {
+        for (int i = 0; i < (int)resources.size(); i++) {
+            if (resources[i] == name)
+                return i;
+        }
+        if (resources.size() == 64) {
+            SDL_Log("TaskGraph: too many resources, '%s' aliases the last one", name);
+            return 63;
+        }
+        resources.push_back(name);
+        return (int)resources.size() - 1;
+    }
+
+    int AddTask(const char *name,
+                const std::vector<const char*> &reads,
+                const std::vector<const char*> &writes,
+                std::function<void()> fn,
+                bool mainThread = false) {
+        auto node = std::make_unique<TaskNode_t>();
+        node->name = name;
+        node->fn = std::move(fn);
+        node->reads = Mask(reads);
+        node->writes = Mask(writes);
+        node->mainThread = mainThread;
+
+        int index = (int)nodes.size();
+        for (int i = 0; i < index; i++) {
+            TaskNode_t &prev = *nodes[i];
+            bool conflict = (prev.writes & (node->reads | node->writes)) || (prev.reads & node->writes);
+            if (conflict) {
+                node->dependencies.push_back(i);
+                prev.dependents.push_back(index);
+            }
+        }
+
+        nodes.push_back(std::move(node));
+        return index;
+    }
+
+    // Extra ordering that isn't expressed through resources
+    void AddDependency(int before, int after) {
+        nodes[after]->dependencies.push_back(before);
+        nodes[before]->dependents.push_back(after);
+    }
+
+    // Blocks until every task ran. The calling thread runs the main-thread
+    // tasks and helps the pool with the rest.
+    void Run() {
+        runStart = SDL_GetTicksNS();
+        remaining = (int)nodes.size();
+
+        for (auto &node : nodes)
+            node->waiting = (int)node->dependencies.size();
+
+        for (int i = 0; i < (int)nodes.size(); i++) {
+            if (nodes[i]->dependencies.empty())
+                Schedule(i);
+        }
+
+        ThreadPool &pool = ThreadPool::GetInstance();
+        while (remaining > 0) {
+            int next = -1;
+            {
+                std::lock_guard<std::mutex> lock(mainMutex);
+                if (!mainReady.empty()) {
+                    next = mainReady.back();
+                    mainReady.pop_back();
+                }
+            }
+
+            if (next >= 0)
+                Execute(next, true);
+            else if (!pool.RunPending())
+                std::this_thread::yield();
+        }
+
+        // Tasks are done but their wrappers may still be decrementing the group
+        pool.Wait(group);
+        lastFrameMs = (double)(SDL_GetTicksNS() - runStart) / 1e6;
+    }
+
+    const std::vector<std::unique_ptr<TaskNode_t>>& GetNodes() const {
+        return nodes;
+    }
+
+    const std::vector<std::string>& GetResources() const {
+        return resources;
+    }
+
+    double GetLastFrameMs() const {
+        return lastFrameMs;
+    }
+
+    void LogGraph() {
+        SDL_Log("TaskGraph: %zu tasks, last run %.3f ms", nodes.size(), lastFrameMs);
+        for (auto &node : nodes) {
+            std::string deps;
+            for (int d : node->dependencies)
+                deps += (deps.empty() ? "" : ", ") + nodes[d]->name;
+            SDL_Log("  %-12s start %7.3f ms  took %7.3f ms  %s  after [%s]",
+                    node->name.c_str(), node->startMs, node->durationMs,
+                    node->ranOnMain ? "main  " : "worker", deps.c_str());
+        }
+    }
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../Engine/enginecontext.h"
+
+// Counts outstanding tasks so a caller can wait for a batch it submitted
+struct TaskGroup {
+    std::atomic<int> remaining{0};
+};
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own work
+// from the back and steals from the front of the others when it runs dry.
+// Threads that aren't workers (the main thread) use slot 0 and help out
+// while they wait on a TaskGroup, so a pool with zero workers still works.
+class ThreadPool {
+    private:
+    struct Queue {
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{true};
+    std::atomic<int> pending{0};
+    std::atomic<unsigned> nextQueue{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ThreadPool() {
+        int cores = SDL_GetNumLogicalCPUCores();
+        Start(cores > 1 ? cores - 1 : 0);
+    }
+
+    ~ThreadPool() {
+        Stop();
+    }
+
+    static int& CurrentIndex() {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    void Start(int workerCount) {
+        running = true;
+        queues.clear();
+        for (int i = 0; i <= workerCount; i++)
+            queues.emplace_back(new Queue());
+
+        for (int i = 1; i <= workerCount; i++) {
+            workers.emplace_back([this, i]() {
+                CurrentIndex() = i;
+                WorkerLoop(i);
+            });
+        }
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        wake.notify_all();
+        for (auto &t : workers)
+            t.join();
+        workers.clear();
+    }
+
+    bool PopLocal(int index, std::function<void()> &out) {
+        Queue &q = *queues[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            return false;
+        out = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool Steal(int thief, std::function<void()> &out) {
+        int count = (int)queues.size();
+        for (int n = 1; n < count; n++) {
+            Queue &q = *queues[(thief + n) % count];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty())
+                continue;
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool RunOne(int index) {
+        std::function<void()> task;
+        if (!PopLocal(index, task) && !Steal(index, task))
+            return false;
+        pending--;
+        task();
+        return true;
+    }
+
+    void WorkerLoop(int index) {
+        while (running) {
+            if (RunOne(index))
+                continue;
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return !running || pending > 0; });
+        }
+    }
+
+    public:
+    static ThreadPool& GetInstance() {
+        static ThreadPool instance;
+        return instance;
+    }
+
+    int GetWorkerCount() const {
+        return (int)workers.size();
+    }
+
+    // Rebuilds the pool, don't call while tasks are in flight
+    void SetWorkerCount(int count) {
+        Stop();
+        Start(count < 0 ? 0 : count);
+    }
+
+    // The task runs in the submitting thread's EngineContext
+    void Submit(TaskGroup &group, std::function<void()> fn) {
+        group.remaining++;
+        EngineContext *context = &EngineContext::Current();
+        auto task = [&group, context, fn = std::move(fn)]() {
+            EngineContext::Scope scope(*context);
+            fn();
+            group.remaining--;
+        };
+
+        // Workers push onto their own deque, outside threads spread the work
+        int index = CurrentIndex();
+        if (index == 0 && queues.size() > 1)
+            index = 1 + (int)(nextQueue++ % (queues.size() - 1));
+
+        {
+            Queue &q = *queues[index];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.tasks.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    // Runs one queued task on the calling thread, false if there was none
+    bool RunPending() {
+        return RunOne(CurrentIndex());
+    }
+
+    // Runs queued tasks on the calling thread until the group is done
+    void Wait(TaskGroup &group) {
+        int index = CurrentIndex();
+        while (group.remaining > 0) {
+            if (!RunOne(index))
+                std::this_thread::yield();
+        }
+    }
+
+    // Splits [0, count) into chunks of at least grain items and blocks until
+    // every chunk ran. fn receives a half open range.
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn) {
+        if (count == 0)
+            return;
+
+        size_t threads = workers.size() + 1;
+        size_t chunk = std::max(grain, (count + threads * 4 - 1) / (threads * 4));
+        if (chunk >= count || workers.empty()) {
+            fn(0, count);
+            return;
+        }
+
+        TaskGroup group;
+        for (size_t begin = chunk; begin < count; begin += chunk) {
+            size_t end = std::min(begin + chunk, count);
+            Submit(group, [&fn, begin, end]() { fn(begin, end); });
+        }
+
+        // The caller takes the first chunk itself
+        fn(0, chunk);
+        Wait(group);
+    }
+};
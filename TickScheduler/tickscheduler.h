@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include "../Entity/entity.h"
+#include "../Camera/camera.h"
+
+struct UpdateTier_t {
+    float maxDistance;  // entities closer than this to an interest point use the tier
+    int interval;       // update every Nth frame
+};
+
+struct TickStats_t {
+    std::vector<int> tierCounts;
+    int updated = 0;
+    int skipped = 0;
+    int animationsSkipped = 0;
+};
+
+// Decides which entities run Process this frame based on their distance to
+// the camera and any extra interest points. Far tiers run every Nth frame
+// with the skipped time added to their dt. Runs serially before the update
+// so parallel buckets only read the result.
+class TickScheduler {
+    private:
+    std::vector<UpdateTier_t> tiers = {
+        {800.0f, 1},
+        {2000.0f, 4},
+        {1e30f, 16},
+    };
+    std::vector<Vector2> interestPoints;
+    bool enabled = false;
+    bool skipOffscreenAnimations = true;
+    float viewMargin = 64.0f;
+    uint64_t frame = 0;
+    uint32_t nextPhase = 0;
+    TickStats_t stats;
+
+    int TierFor(float distanceSq) const {
+        for (int i = 0; i < (int)tiers.size(); i++) {
+            if (distanceSq <= tiers[i].maxDistance * tiers[i].maxDistance)
+                return i;
+        }
+        return (int)tiers.size() - 1;
+    }
+
+    public:
+    void SetEnabled(bool enabled) { this->enabled = enabled; }
+    bool IsEnabled() const { return enabled; }
+
+    // Tiers must be sorted by maxDistance, the last one catches everything
+    void SetTiers(const std::vector<UpdateTier_t> &tiers) {
+        if (!tiers.empty())
+            this->tiers = tiers;
+    }
+    const std::vector<UpdateTier_t>& GetTiers() const { return tiers; }
+
+    void AddInterestPoint(Vector2 point) { interestPoints.push_back(point); }
+    void ClearInterestPoints() { interestPoints.clear(); }
+
+    void SetSkipOffscreenAnimations(bool skip) { skipOffscreenAnimations = skip; }
+    void SetViewMargin(float margin) { viewMargin = margin; }
+
+    const TickStats_t& GetStats() const { return stats; }
+
+    // Staggers new entities so one tier's updates are spread across frames
+    void AssignPhase(Entity *entity) {
+        entity->GetTickState().phase = nextPhase++;
+        entity->GetTickState().pendingDt = 0.0;
+    }
+
+    void Schedule(const std::vector<Entity*> &entities, double dt) {
+        frame++;
+        stats.tierCounts.assign(tiers.size(), 0);
+        stats.updated = 0;
+        stats.skipped = 0;
+
+        Vector2 cameraPos = Camera::GetInstance().GetPosition();
+
+        for (Entity *e : entities) {
+            TickState_t &tick = e->GetTickState();
+
+            if (!enabled || tick.alwaysUpdate) {
+                tick.tier = 0;
+                tick.update = true;
+                tick.stepDt = dt + tick.pendingDt;
+                tick.pendingDt = 0.0;
+                stats.tierCounts[0]++;
+                stats.updated++;
+                continue;
+            }
+
+            Vector2 pos = e->GetPosition();
+            Vector2 d = pos - cameraPos;
+            float best = d.Dot(d);
+            for (const Vector2 &p : interestPoints) {
+                Vector2 dp = pos - p;
+                best = std::min(best, dp.Dot(dp));
+            }
+
+            tick.tier = TierFor(best);
+            stats.tierCounts[tick.tier]++;
+
+            int interval = tiers[tick.tier].interval;
+            tick.pendingDt += dt;
+            tick.update = interval <= 1 || (frame + tick.phase) % (uint64_t)interval == 0;
+
+            if (tick.update) {
+                tick.stepDt = tick.pendingDt;
+                tick.pendingDt = 0.0;
+                stats.updated++;
+            } else {
+                stats.skipped++;
+            }
+        }
+    }
+
+    // World rectangle seen by the camera, grown by the view margin
+    void GetViewBounds(Vector2 &minOut, Vector2 &maxOut) {
+        Camera &camera = Camera::GetInstance();
+        Vector2 half = Screen::GetInstance().GetSize() / (2.0f * camera.GetZoom());
+        Vector2 margin = {viewMargin, viewMargin};
+        minOut = camera.GetPosition() - half - margin;
+        maxOut = camera.GetPosition() + half + margin;
+    }
+
+    bool ShouldTickAnimation(Entity *e, const Vector2 &viewMin, const Vector2 &viewMax) const {
+        if (!skipOffscreenAnimations || e->GetTickState().alwaysUpdate)
+            return true;
+
+        Vector2 pos = e->GetPosition();
+        Vector2 half = e->GetSize() * (e->GetScale() * 0.5f);
+        return pos.x + half.x >= viewMin.x && pos.x - half.x <= viewMax.x &&
+               pos.y + half.y >= viewMin.y && pos.y - half.y <= viewMax.y;
+    }
+
+    void SetAnimationsSkipped(int count) { stats.animationsSkipped = count; }
+};
@@ -3,24 +3,29 @@
 #include "../SpriteEntity/spriteentity.h"
 
 class TiledSpriteEntity: public SpriteEntity {
+    DECLARE_POOLED_ENTITY(TiledSpriteEntity)
+
     public:
+    TiledSpriteEntity() { type = EntityType::TILED_SPRITE_ENTITY; }
+
+    Vector2 GetDrawSize() const override { return size; }
+
     void Draw() override {
         if (!material || !material->GetTexture()) {
             SDL_Log("RepeatedSpriteEntity: Couldn't find material/texture!");
             return;
         }
 
-        SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
         Camera& camera = Camera::GetInstance();
-        Vector2 screenPos = camera.WorldToScreen(position);
+        Vector2 screenPos = camera.WorldToScreen(renderPosition);
 
         SDL_FRect rect;
-        rect.w = (flipX ? -1.0f : 1.0f) * size.x * camera.GetZoomOnScreen(scale);
-        rect.h = (flipY ? -1.0f : 1.0f) * size.y * camera.GetZoomOnScreen(scale);
+        rect.w = size.x * camera.GetZoomOnScreen(scale);
+        rect.h = size.y * camera.GetZoomOnScreen(scale);
         rect.x = screenPos.x - (rect.w * 0.5f);
         rect.y = screenPos.y - (rect.h * 0.5f);
 
-        SDL_RenderTextureTiled(renderer, material->GetTexture(), &srcRect, camera.GetZoom(), &rect);
+        RenderQueue::GetInstance().AddTiled(material->GetDrawTexture(), material->DrawRegion(srcRect), camera.GetZoom(), rect, flipX, flipY);
 
         // compute tile size to fill exactly tileCountX and tileCountY
         /*float tileW = rect.w / tileCountX;
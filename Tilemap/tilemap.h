@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../Entity/entity.h"
+#include "../Material/materialmanager.h"
+#include <SDL3/SDL_render.h>
+
+struct TilemapStats_t {
+    int chunksDrawn = 0;
+    int chunksRebuilt = 0;
+    int quads = 0;
+};
+
+// Grid of tiles from one tileset material, drawn as a single entity. Tiles
+// are indices into the tileset, counted left to right and top to bottom
+// starting at 1, 0 is an empty cell. The map is split into chunks of
+// CHUNK_TILES x CHUNK_TILES, each with its own prebuilt quads. Draw only
+// queues the chunks on screen and only rebuilds the ones whose tiles changed.
+//
+// Tilemaps don't collide, use invisible static entities for solid areas.
+class Tilemap: public Entity {
+    DECLARE_POOLED_ENTITY(Tilemap)
+
+    public:
+    static constexpr int CHUNK_TILES = 16;
+
+    protected:
+    struct Chunk_t {
+        std::vector<SDL_Vertex> vertices;   // 4 per tile, map pixels from the top left
+        bool dirty = true;
+    };
+
+    Material* material = nullptr;
+    int tileSize = 16;                      // in tileset pixels, also the world size at scale 1
+    int columns = 0, rows = 0;
+    std::vector<uint16_t> tiles;            // row major
+    std::vector<Chunk_t> chunks;
+    int chunkColumns = 0, chunkRows = 0;
+    SDL_Texture *builtTexture = nullptr;    // the vertices' texture coordinates are for this one
+    TilemapStats_t stats;
+
+    void MarkAllDirty() {
+        for (Chunk_t &chunk : chunks)
+            chunk.dirty = true;
+    }
+
+    Chunk_t& ChunkAt(int x, int y) {
+        return chunks[(y / CHUNK_TILES) * chunkColumns + x / CHUNK_TILES];
+    }
+
+    void BuildChunk(int cx, int cy) {
+        Chunk_t &chunk = chunks[cy * chunkColumns + cx];
+        chunk.vertices.clear();
+        chunk.dirty = false;
+        stats.chunksRebuilt++;
+
+        // Cached sizes, this runs on the simulation thread with the pipeline on
+        float textureW = 1.0f, textureH = 1.0f;
+        material->GetDrawTextureSize(textureW, textureH);
+        textureW = std::max(textureW, 1.0f);
+        textureH = std::max(textureH, 1.0f);
+        int tilesetColumns = std::max((int)material->GetWidth() / tileSize, 1);
+        float t = (float)tileSize;
+        SDL_FColor white = {1.0f, 1.0f, 1.0f, 1.0f};
+
+        int endX = std::min((cx + 1) * CHUNK_TILES, columns);
+        int endY = std::min((cy + 1) * CHUNK_TILES, rows);
+        for (int y = cy * CHUNK_TILES; y < endY; y++) {
+            for (int x = cx * CHUNK_TILES; x < endX; x++) {
+                uint16_t tile = tiles[y * columns + x];
+                if (tile == 0)
+                    continue;
+                int index = tile - 1;
+                SDL_FRect src = {(float)(index % tilesetColumns) * t, (float)(index / tilesetColumns) * t, t, t};
+                SDL_FRect region = material->DrawRegion(src);
+                float u0 = region.x / textureW, v0 = region.y / textureH;
+                float u1 = (region.x + region.w) / textureW, v1 = (region.y + region.h) / textureH;
+                float x0 = x * t, y0 = y * t;
+                chunk.vertices.push_back({{x0, y0}, white, {u0, v0}});
+                chunk.vertices.push_back({{x0 + t, y0}, white, {u1, v0}});
+                chunk.vertices.push_back({{x0 + t, y0 + t}, white, {u1, v1}});
+                chunk.vertices.push_back({{x0, y0 + t}, white, {u0, v1}});
+            }
+        }
+    }
+
+    public:
+    Tilemap() {
+        type = EntityType::TILEMAP;
+        hasCollision = false;
+    }
+
+    void SetMaterial(Material* m) {
+        material = m;
+        MarkAllDirty();
+    }
+    Material* GetMaterial() const { return material; }
+
+    // Tile size in pixels, the tileset is read as a grid of this size
+    void SetTileSize(int pixels) {
+        tileSize = std::max(pixels, 1);
+        size = {(float)(columns * tileSize), (float)(rows * tileSize)};
+        MarkAllDirty();
+    }
+    int GetTileSize() const { return tileSize; }
+
+    // Keeps the tiles that are inside both the old and new size
+    void Resize(int newColumns, int newRows) {
+        newColumns = std::max(newColumns, 0);
+        newRows = std::max(newRows, 0);
+        std::vector<uint16_t> resized((size_t)newColumns * newRows, 0);
+        for (int y = 0; y < std::min(rows, newRows); y++) {
+            for (int x = 0; x < std::min(columns, newColumns); x++)
+                resized[y * newColumns + x] = tiles[y * columns + x];
+        }
+        tiles.swap(resized);
+        columns = newColumns;
+        rows = newRows;
+        size = {(float)(columns * tileSize), (float)(rows * tileSize)};
+
+        chunkColumns = (columns + CHUNK_TILES - 1) / CHUNK_TILES;
+        chunkRows = (rows + CHUNK_TILES - 1) / CHUNK_TILES;
+        chunks.assign((size_t)chunkColumns * chunkRows, Chunk_t());
+    }
+
+    int GetColumns() const { return columns; }
+    int GetRows() const { return rows; }
+
+    uint16_t GetTile(int x, int y) const {
+        if (x < 0 || y < 0 || x >= columns || y >= rows)
+            return 0;
+        return tiles[y * columns + x];
+    }
+
+    void SetTile(int x, int y, uint16_t tile) {
+        if (x < 0 || y < 0 || x >= columns || y >= rows)
+            return;
+        uint16_t &cell = tiles[y * columns + x];
+        if (cell == tile)
+            return;
+        cell = tile;
+        ChunkAt(x, y).dirty = true;
+    }
+
+    void Fill(uint16_t tile) {
+        std::fill(tiles.begin(), tiles.end(), tile);
+        MarkAllDirty();
+    }
+
+    // Cell under a world position, false when it's outside the map
+    bool WorldToTile(Vector2 worldPosition, int &x, int &y) const {
+        float cell = tileSize * scale;
+        Vector2 local = worldPosition - (position - GetDrawSize() * (scale * 0.5f));
+        x = (int)std::floor(local.x / cell);
+        y = (int)std::floor(local.y / cell);
+        return x >= 0 && y >= 0 && x < columns && y < rows;
+    }
+
+    Vector2 GetDrawSize() const override {
+        return {(float)(columns * tileSize), (float)(rows * tileSize)};
+    }
+
+    // The chunks are already prebuilt geometry
+    bool IsDrawCacheable() const override { return false; }
+
+    // Tiles are written as packets with a uint16 header: the top bit set is
+    // a run of (header & 0x7fff) copies of the one tile that follows, clear
+    // is that many tiles as they are. Levels are mostly empty space and rows
+    // of the same tile, and a busy area costs 2 bytes every 32k tiles.
+    void SaveState(SnapshotWriter &w) const override {
+        Entity::SaveState(w);
+        w.Write(MaterialManager::GetInstance().GetMaterialIndex(material));
+        w.Write(tileSize);
+        w.Write(columns);
+        w.Write(rows);
+
+        const size_t MAX_PACKET = 0x7fff, MIN_RUN = 3;
+        size_t i = 0, count = tiles.size();
+        while (i < count) {
+            size_t run = 1;
+            while (i + run < count && tiles[i + run] == tiles[i] && run < MAX_PACKET)
+                run++;
+            if (run >= MIN_RUN) {
+                w.Write((uint16_t)(0x8000 | run));
+                w.Write(tiles[i]);
+                i += run;
+                continue;
+            }
+
+            // Literals up to the next run worth encoding
+            size_t literals = 0;
+            while (i + literals < count && literals < MAX_PACKET) {
+                size_t next = i + literals;
+                if (next + MIN_RUN <= count && tiles[next] == tiles[next + 1] && tiles[next] == tiles[next + 2])
+                    break;
+                literals++;
+            }
+            w.Write((uint16_t)literals);
+            for (size_t n = 0; n < literals; n++)
+                w.Write(tiles[i + n]);
+            i += literals;
+        }
+    }
+
+    // Only chunks whose tiles differ get rebuilt, so restoring a snapshot
+    // of the same map is cheap
+    void LoadState(SnapshotReader &r) override {
+        Entity::LoadState(r);
+        Material *loaded = MaterialManager::GetInstance().GetMaterialByIndex(r.Read<int32_t>());
+        int newTileSize = r.Read<int>();
+        int newColumns = r.Read<int>();
+        int newRows = r.Read<int>();
+        if (loaded != material)
+            SetMaterial(loaded);
+        if (newTileSize != tileSize)
+            SetTileSize(newTileSize);
+        if (newColumns != columns || newRows != rows)
+            Resize(newColumns, newRows);
+
+        size_t i = 0;
+        while (i < tiles.size() && r.IsOk()) {
+            uint16_t header = r.Read<uint16_t>();
+            size_t length = header & 0x7fff;
+            if (length == 0)
+                break;
+            bool run = header & 0x8000;
+            uint16_t tile = run ? r.Read<uint16_t>() : 0;
+            for (size_t n = 0; n < length && i < tiles.size(); n++, i++)
+                SetTile((int)(i % columns), (int)(i / columns), run ? tile : r.Read<uint16_t>());
+        }
+    }
+
+    void Draw() override {
+        stats = TilemapStats_t();
+        if (!material || !material->GetTexture()) {
+            SDL_Log("Tilemap: Couldn't find material/texture!");
+            return;
+        }
+
+        // The atlas was turned on or off
+        SDL_Texture *texture = material->GetDrawTexture();
+        if (texture != builtTexture) {
+            builtTexture = texture;
+            MarkAllDirty();
+        }
+
+        Camera& camera = Camera::GetInstance();
+        float pixelScale = camera.GetZoomOnScreen(scale);
+        Vector2 origin = camera.WorldToScreen(renderPosition - GetDrawSize() * (scale * 0.5f));
+        Vector2 screen = Screen::GetInstance().GetSize();
+        float chunkPixels = CHUNK_TILES * tileSize * pixelScale;
+        if (chunkPixels <= 0.0f)
+            return;
+
+        int minX = std::max((int)std::floor(-origin.x / chunkPixels), 0);
+        int minY = std::max((int)std::floor(-origin.y / chunkPixels), 0);
+        int maxX = std::min((int)std::floor((screen.x - origin.x) / chunkPixels), chunkColumns - 1);
+        int maxY = std::min((int)std::floor((screen.y - origin.y) / chunkPixels), chunkRows - 1);
+
+        RenderQueue &queue = RenderQueue::GetInstance();
+        for (int cy = minY; cy <= maxY; cy++) {
+            for (int cx = minX; cx <= maxX; cx++) {
+                Chunk_t &chunk = chunks[cy * chunkColumns + cx];
+                if (chunk.dirty)
+                    BuildChunk(cx, cy);
+                if (chunk.vertices.empty())
+                    continue;
+                int quads = (int)chunk.vertices.size() / 4;
+                queue.AddQuads(texture, chunk.vertices.data(), quads, origin.x, origin.y, pixelScale);
+                stats.chunksDrawn++;
+                stats.quads += quads;
+            }
+        }
+    }
+
+    // Of the last Draw
+    const TilemapStats_t& GetStats() const {
+        return stats;
+    }
+};
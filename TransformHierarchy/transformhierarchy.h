@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "../Entity/entity.h"
+
+struct TransformNode_t {
+    Entity *entity;
+    Entity *parent;
+    int depth;
+    Vector2 local;          // offset from the parent
+    bool dirty;             // offset changed or the child was moved, see MarkMoved
+    int parentNode = -1;    // the parent's node, -1 when the parent is a root
+    int root = -1;          // index in the hierarchy's roots
+    int end = 0;            // one past the last node of this subtree
+    Vector2 world = {0.0f, 0.0f};   // last position written to the child
+    bool moved = false;     // written in the current Update
+    bool childDirty = false;    // a node below is dirty
+};
+
+// A parent without a parent and the range of nodes below it
+struct TransformRoot_t {
+    Entity *entity;
+    Vector2 world;          // position the last Update saw
+    int begin, end;
+    bool dirty;             // a node in the range is dirty
+};
+
+// Parent/child links between entities. Only children get a node, stored
+// depth-first in one array with all nodes under one root (a parent without
+// a parent) next to each other, so a single forward pass updates every
+// world transform. Roots are the only entities read, once each; a child's
+// parent position comes from the parent's node. A root that didn't move
+// with nothing dirty below it is skipped with all its nodes, so are clean
+// subtrees under a moved one.
+//
+// A child is rewritten when its parent moved or its offset changed.
+// Anything else that moves an attached child (collision resolve, gameplay
+// code) calls MarkMoved, otherwise it stays where it was put. The result
+// goes to the child's position: collision and rendering keep reading
+// Entity::position as the cached world transform.
+class TransformHierarchy {
+    private:
+    std::vector<TransformNode_t> nodes;
+    std::vector<TransformRoot_t> roots;
+    bool orderDirty = false;
+    int lastUpdated = 0;
+    int lastVisited = 0;
+    std::vector<Entity*> movedStatic;   // static children the last Update wrote
+
+    // Reorder scratch, indices into the old order
+    std::vector<TransformNode_t> reordered;
+    std::vector<int> firstChild, lastChild, nextSibling;
+    std::vector<std::pair<int, int>> rootLevel;     // root, node under it
+
+    int FindNode(const Entity *entity) const {
+        int index = entity->GetTransformNode();
+        if (index >= 0 && index < (int)nodes.size() && nodes[index].entity == entity)
+            return index;
+        return -1;
+    }
+
+    // Appends the old node and its subtree to reordered, depth-first
+    void Place(int old, int parentNode, int root, int depth) {
+        int index = (int)reordered.size();
+        reordered.push_back(nodes[old]);
+        TransformNode_t &n = reordered.back();
+        n.parentNode = parentNode;
+        n.root = root;
+        n.depth = depth;
+        n.dirty = true;
+        n.childDirty = false;
+        for (int c = firstChild[old]; c >= 0; c = nextSibling[c])
+            Place(c, index, root, depth + 1);
+        reordered[index].end = (int)reordered.size();
+    }
+
+    void Reorder() {
+        size_t count = nodes.size();
+        firstChild.assign(count, -1);
+        lastChild.assign(count, -1);
+        nextSibling.assign(count, -1);
+        for (int i = 0; i < (int)count; i++) {
+            int p = FindNode(nodes[i].parent);
+            if (p < 0)
+                continue;
+            if (lastChild[p] < 0)
+                firstChild[p] = i;
+            else
+                nextSibling[lastChild[p]] = i;
+            lastChild[p] = i;
+        }
+
+        // Roots in the order their first child was attached, each with all
+        // of its subtrees. A root's transformNode holds -2 - its index
+        // meanwhile, roots have no node so it's -1 otherwise.
+        roots.clear();
+        rootLevel.clear();
+        for (int i = 0; i < (int)count; i++) {
+            Entity *root = nodes[i].parent;
+            if (FindNode(root) >= 0)
+                continue;
+            if (root->transformNode == -1) {
+                root->transformNode = -2 - (int)roots.size();
+                roots.push_back({root, root->GetPosition(), 0, 0, true});
+            }
+            rootLevel.push_back({-2 - root->transformNode, i});
+        }
+        std::stable_sort(rootLevel.begin(), rootLevel.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+            return a.first < b.first;
+        });
+
+        reordered.clear();
+        for (size_t k = 0; k < rootLevel.size(); k++) {
+            TransformRoot_t &r = roots[rootLevel[k].first];
+            if (k == 0 || rootLevel[k - 1].first != rootLevel[k].first)
+                r.begin = (int)reordered.size();
+            Place(rootLevel[k].second, -1, rootLevel[k].first, 1);
+            r.end = (int)reordered.size();
+        }
+        for (TransformRoot_t &r : roots)
+            r.entity->transformNode = -1;
+        nodes.swap(reordered);
+
+        for (int i = 0; i < (int)nodes.size(); i++)
+            nodes[i].entity->transformNode = i;
+
+        orderDirty = false;
+    }
+
+    void MarkDirty(int index) {
+        nodes[index].dirty = true;
+        if (orderDirty)
+            return;     // Reorder marks every node anyway
+        for (int p = nodes[index].parentNode; p >= 0 && !nodes[p].childDirty; p = nodes[p].parentNode)
+            nodes[p].childDirty = true;
+        roots[nodes[index].root].dirty = true;
+    }
+
+    public:
+    // local is the child's offset from the parent's position
+    bool Attach(Entity *child, Entity *parent, Vector2 local) {
+        if (!child || !parent || child == parent)
+            return false;
+
+        for (Entity *p = parent; p; p = p->GetParent()) {
+            if (p == child) {
+                SDL_Log("TransformHierarchy: attaching would create a cycle");
+                return false;
+            }
+        }
+
+        int index = FindNode(child);
+        if (index < 0) {
+            nodes.push_back({child, parent, 0, local, true});
+            child->transformNode = (int)nodes.size() - 1;
+        } else {
+            nodes[index].parent = parent;
+            nodes[index].local = local;
+        }
+
+        child->parent = parent;
+        orderDirty = true;
+        return true;
+    }
+
+    // The child keeps its current world position
+    void Detach(Entity *child) {
+        int index = FindNode(child);
+        if (index < 0)
+            return;
+
+        nodes.erase(nodes.begin() + index);
+        for (int i = index; i < (int)nodes.size(); i++)
+            nodes[i].entity->transformNode = i;
+
+        child->parent = nullptr;
+        child->transformNode = -1;
+        orderDirty = true;
+    }
+
+    // Call when an entity leaves the world: drops its node and detaches its
+    // direct children
+    void OnRemove(Entity *entity) {
+        if (nodes.empty())
+            return;
+
+        for (auto &n : nodes) {
+            if (n.parent == entity)
+                n.entity->parent = nullptr;
+        }
+
+        nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [entity](const TransformNode_t &n) {
+            return n.entity == entity || n.parent == entity;
+        }), nodes.end());
+
+        for (int i = 0; i < (int)nodes.size(); i++)
+            nodes[i].entity->transformNode = i;
+
+        entity->transformNode = -1;
+        entity->parent = nullptr;
+        orderDirty = true;
+    }
+
+    void SetLocalPosition(Entity *child, Vector2 local) {
+        int index = FindNode(child);
+        if (index < 0)
+            return;
+        nodes[index].local = local;
+        MarkDirty(index);
+    }
+
+    // The child was moved off parent + local, the next Update puts it back
+    void MarkMoved(Entity *child) {
+        int index = FindNode(child);
+        if (index >= 0)
+            MarkDirty(index);
+    }
+
+    Vector2 GetLocalPosition(const Entity *child) const {
+        int index = FindNode(child);
+        return index < 0 ? child->GetPosition() : nodes[index].local;
+    }
+
+    // Single depth-first pass, parents are always updated before children
+    void Update() {
+        if (orderDirty)
+            Reorder();
+
+        lastUpdated = 0;
+        lastVisited = 0;
+        movedStatic.clear();
+        for (TransformRoot_t &r : roots) {
+            Vector2 rootWorld = r.entity->GetPosition();
+            bool rootMoved = rootWorld != r.world;
+            if (!rootMoved && !r.dirty)
+                continue;
+            r.world = rootWorld;
+            r.dirty = false;
+
+            for (int i = r.begin; i < r.end;) {
+                TransformNode_t &n = nodes[i];
+                Vector2 parentWorld = n.parentNode < 0 ? rootWorld : nodes[n.parentNode].world;
+                bool parentMoved = n.parentNode < 0 ? rootMoved : nodes[n.parentNode].moved;
+                if (!parentMoved && !n.dirty && !n.childDirty) {
+                    i = n.end;
+                    continue;
+                }
+
+                lastVisited++;
+                n.moved = parentMoved || n.dirty;
+                n.dirty = false;
+                n.childDirty = false;
+                if (n.moved) {
+                    n.world = parentWorld + n.local;
+                    n.entity->SetPosition(n.world);
+                    lastUpdated++;
+                    if (n.entity->IsStatic())
+                        movedStatic.push_back(n.entity);
+                }
+                i++;
+            }
+        }
+    }
+
+    void Clear() {
+        for (auto &n : nodes) {
+            n.entity->parent = nullptr;
+            n.entity->transformNode = -1;
+        }
+        nodes.clear();
+        roots.clear();
+        orderDirty = false;
+    }
+
+    const std::vector<TransformNode_t>& GetNodes() const {
+        return nodes;
+    }
+
+    int GetLastUpdatedCount() const {
+        return lastUpdated;
+    }
+
+    // Nodes the last Update looked at, skipped subtrees aren't counted
+    int GetLastVisitedCount() const {
+        return lastVisited;
+    }
+
+    // Static entities may be cached by what draws them, the World tells it
+    const std::vector<Entity*>& GetMovedStatic() const {
+        return movedStatic;
+    }
+};
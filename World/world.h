@@ -1,8 +1,49 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
+#include <type_traits>
 #include "../Entity/entity.h"
 #include "../Player/player.h"
+#include "../EntityBuckets/entitybuckets.h"
+#include "../CommandBuffer/commandbuffer.h"
+#include "../DeferredWrites/deferredwrites.h"
+#include "../ThreadPool/threadpool.h"
+#include "../TickScheduler/tickscheduler.h"
+#include "../Morton/morton.h"
+#include "../Snapshot/snapshot.h"
+#include "../TransformHierarchy/transformhierarchy.h"
+#include "../EntityIndex/entityindex.h"
+#include "../CullingGrid/cullinggrid.h"
+#include "../ChunkCache/chunkcache.h"
+#include "../Engine/enginecontext.h"
+#include <atomic>
+
+struct WorldStats_t {
+    double processMs = 0.0;
+    double drawMs = 0.0;
+
+    // Spatial re-sort of entitylist
+    double spatialSortMs = 0.0;
+    size_t spatialInversions = 0;   // neighbours out of Morton order before the sort
+    bool spatialFullSort = false;
+    int spatialSorts = 0;
+
+    // View culling in DrawEntities
+    int drawnEntities = 0;
+    int culledEntities = 0;
+    double cullMs = 0.0;        // grid update, view query, bounds tests and queueing
+};
+
+class World;
+
+// One phase of a fixed step, see World::GetStepPhases
+struct WorldPhase_t {
+    const char *name;
+    std::vector<const char*> reads;     // frame graph resources
+    std::vector<const char*> writes;
+    void (*run)(World &world, double dt);
+};
 
 class World {
     private:
@@ -10,70 +51,913 @@ class World {
     int max_entities = 64;
     Player *localPlayer;
 
+    // Spawns/destroys requested while the entity list is being walked:
+    // process, collision detection and resolve
+    CommandBuffer commands;
+    bool iterating = false;
+    std::vector<CollisionInfo_t> stepCollisions;
+
+    // Entities grouped by concrete type for devirtualized update/draw loops.
+    // entitylist keeps insertion order for the virtual path and saving.
+    EntityBuckets<WorldEntityTypes> buckets;
+    bool staticDispatch = true;
+    WorldStats_t stats;
+
+    std::vector<AnimatedEntity*> animatedList;
+
+    // Distance-based update LOD
+    TickScheduler tickScheduler;
+
+    // Parent/child links, children's positions are derived from their parent
+    TransformHierarchy transforms;
+
+    // Tag and name lookups, type lookups go through buckets
+    EntityIndex index;
+
+    // Optionally keeps entitylist in Morton order of position so collision
+    // walks spatial neighbours together. Buckets keep insertion order, which
+    // is the draw order. Off by default: --spatial-bench hasn't shown a gain
+    // over spawn order yet.
+    bool spatialSort = false;
+    float spatialCellSize = 64.0f;
+    float spatialResortThreshold = 0.05f;
+    std::vector<std::pair<uint64_t, Entity*>> sortScratch;
+
+    // Only what intersects the camera view (plus margin) is drawn. The grid
+    // follows non-static entities in Interpolate, so sim-only worlds never
+    // pay for it, static ones through OnStaticChanged.
+    CullingGrid culling;
+    double cullUpdateMs = 0.0;
+    bool viewCulling = true;
+    float cullMargin = 32.0f;
+    std::vector<Entity*> cullCandidates;
+
+    // Static drawables pre-rendered per world chunk, see ChunkCache
+    ChunkCache chunkCache;
+
+    // Scratch for snapshots: entities in bucket (insertion) order, which
+    // doesn't change with the spatial sort
+    std::vector<Entity*> stableOrder;
+    std::vector<uint8_t> snapshotTypes;
+    static constexpr uint32_t SNAPSHOT_VERSION = 7;
+    uint32_t nextEntityId = 1;
+    bool parallelUpdate = false;
+    size_t parallelMinEntities = 256;
+
     World(const World&) = delete;
     World& operator=(const World&) = delete;
 
+    friend class EngineContext;
     World() {
         entitylist.reserve(max_entities);
     };
 
+    // Contexts other than the default one are torn down with their entities
+    ~World() {
+        ClearEntities();
+    }
+
+    bool InsertEntity(Entity *entity) {
+        if (entitylist.size() == max_entities)
+            return false;
+        entitylist.push_back(entity);
+        if (entity->id == 0)
+            entity->id = nextEntityId++;
+        entity->ResetInterpolation();
+        tickScheduler.AssignPhase(entity);
+        entity->worldBucket = buckets.Classify(entity);
+        buckets.Insert(entity, entity->worldBucket);
+        index.Insert(entity);
+        culling.Insert(entity);
+        chunkCache.Insert(entity);
+        if (AnimatedEntity *animated = dynamic_cast<AnimatedEntity*>(entity))
+            animatedList.push_back(animated);
+        return true;
+    }
+
+    bool EraseEntity(Entity *entity) {
+        for (int i = 0; i < entitylist.size(); i++) {
+            Entity *e = entitylist.at(i);
+            if (e == entity && e != nullptr) {
+                entitylist.erase(entitylist.begin() + i);
+                buckets.Erase(e, e->worldBucket);
+                transforms.OnRemove(e);
+                index.Erase(e);
+                culling.Erase(e);
+                chunkCache.Erase(e);
+                if (AnimatedEntity *animated = dynamic_cast<AnimatedEntity*>(e)) {
+                    auto it = std::find(animatedList.begin(), animatedList.end(), animated);
+                    if (it != animatedList.end())
+                        animatedList.erase(it);
+                }
+                if (e == localPlayer)
+                    localPlayer = nullptr;
+                delete e;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Updates one typed bucket with non-virtual calls. Buckets of
+    // parallel-safe types go through the thread pool, order is the index of
+    // the bucket's first entity for DeferredWrites ordering.
+    template <typename T>
+    void ProcessBucket(std::vector<T*> &bucket, double dt, size_t order) {
+        if (bucket.empty())
+            return;
+
+        if (parallelUpdate && bucket.size() >= parallelMinEntities && bucket.front()->IsParallelSafe()) {
+            DeferredWrites &writes = DeferredWrites::GetInstance();
+            writes.Begin();
+            ThreadPool::GetInstance().ParallelFor(bucket.size(), 64, [&bucket, dt, order](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    TickState_t &tick = bucket[i]->GetTickState();
+                    if (!tick.update)
+                        continue;
+                    DeferredWrites::SetOrder(order + i);
+                    bucket[i]->T::Process(tick.stepDt);
+                }
+            });
+            writes.Apply();
+            return;
+        }
+
+        for (T *e : bucket) {
+            TickState_t &tick = e->GetTickState();
+            if (tick.update)
+                e->T::Process(tick.stepDt);
+        }
+    }
+
+    void BuildStableOrder() {
+        stableOrder.clear();
+        buckets.ForEachBucket([this](auto &bucket) {
+            stableOrder.insert(stableOrder.end(), bucket.begin(), bucket.end());
+        });
+        stableOrder.insert(stableOrder.end(), buckets.GetDynamic().begin(), buckets.GetDynamic().end());
+    }
+
+    // What snapshots and checksums capture, see SaveSnapshot
+    void WriteState(SnapshotWriter &w) {
+        BuildStableOrder();
+
+        w.Write(SNAPSHOT_VERSION);
+        w.Write(nextEntityId);
+        Camera::GetInstance().SaveState(w);
+
+        w.Write((uint32_t)stableOrder.size());
+        int32_t localIndex = -1;
+        for (uint32_t i = 0; i < stableOrder.size(); i++) {
+            stableOrder[i]->stableIndex = i;
+            w.Write((uint8_t)stableOrder[i]->GetType());
+            if (stableOrder[i] == localPlayer)
+                localIndex = (int32_t)i;
+        }
+        w.Write(localIndex);
+
+        for (Entity *e : stableOrder) {
+            e->SaveState(w);
+            w.Write(e->id);
+            w.Write(e->GetTags());
+            w.WriteString(e->GetName());
+        }
+
+        // Current (spatial) order of entitylist, it affects collision order
+        for (Entity *e : entitylist)
+            w.Write(e->stableIndex);
+
+        const auto &links = transforms.GetNodes();
+        w.Write((uint32_t)links.size());
+        for (const auto &n : links) {
+            w.Write(n.entity->stableIndex);
+            w.Write(n.parent->stableIndex);
+            w.Write(n.local);
+        }
+    }
+
     public:
 
     static World& GetInstance() {
-        static World world;
-        return world;
+        return EngineContext::Current().Get<World>();
     }
 
-    std::vector<Entity*> GetEntities() {
+    // Fresh entity of a stored type, used by snapshots and replication
+    static Entity* CreateEntityOfType(EntityType type) {
+        switch (type) {
+            case EntityType::SPRITE_ENTITY: return new SpriteEntity();
+            case EntityType::TILED_SPRITE_ENTITY: return new TiledSpriteEntity();
+            case EntityType::TILEMAP: return new Tilemap();
+            case EntityType::AGENT: return new Agent();
+            case EntityType::ANIMATED_ENTITY: {
+                AnimatedEntity *animated = new AnimatedEntity();
+                animated->InitializeAnimations();
+                return animated;
+            }
+            case EntityType::PLAYER: {
+                Player *player = new Player();
+                player->InitializeAnimations();
+                return player;
+            }
+            default: return new Entity();
+        }
+    }
+
+    // The list is only valid until the next sync point (FlushCommands),
+    // don't hold on to it across frames.
+    const std::vector<Entity*>& GetEntities() const {
         return entitylist;
     }
 
+    // While the world is iterating the entity is queued and added at the
+    // next FlushCommands(), so this returns true without touching the list.
     bool AddEntity(Entity *entity) {
-        if (entitylist.size() == max_entities)
-            return false;
-        entitylist.push_back(entity);
-        return true;
+        if (iterating) {
+            commands.Spawn(entity);
+            return true;
+        }
+        return InsertEntity(entity);
     }
 
     bool RemoveEntity(Entity *entity) {
         if (entitylist.size() == 0)
             return false;
 
-        for (int i = 0; i < entitylist.size(); i++) {
-            Entity *e = entitylist.at(i);
-            if (e == entity && e != nullptr) {
-                entitylist.erase(entitylist.begin() + i);
-                delete e;
-                e = nullptr;
-                break;
-            }
+        if (iterating) {
+            commands.Destroy(entity);
+            return true;
         }
 
+        EraseEntity(entity);
         return true;
     }
 
+    // Explicitly defer a spawn/destroy to the next sync point
+    void QueueSpawn(Entity *entity) { commands.Spawn(entity); }
+    void QueueDestroy(Entity *entity) { commands.Destroy(entity); }
+
+    // Sync point: apply every queued spawn and destroy in one batch
+    void FlushCommands() {
+        if (commands.IsEmpty())
+            return;
+
+        auto &batch = commands.Take();
+        for (auto &c : batch) {
+            if (c.type == EntityCommandType_t::Spawn) {
+                if (!InsertEntity(c.entity)) {
+                    SDL_Log("World: entity limit reached, dropping queued spawn");
+                    delete c.entity;
+                }
+            } else {
+                EraseEntity(c.entity);
+            }
+        }
+    }
+
     void ProcessEntities(double dt) {
         if (entitylist.size() == 0)
             return;
 
-        for (auto *e : entitylist) {
-            if (!e || e == nullptr)
-                continue;
+        Uint64 start = SDL_GetTicksNS();
+        iterating = true;
+
+        // Pick who updates this frame and with what dt
+        tickScheduler.Schedule(entitylist, dt);
+
+        if (!staticDispatch) {
+            // Reference path: one virtual call per entity in insertion order
+            for (auto *e : entitylist) {
+                if (!e || e == nullptr)
+                    continue;
+
+                if (e->GetTickState().update)
+                    e->Process(e->GetTickState().stepDt);
+            }
+        } else {
+            // Tight per-type loops, parallel-safe types fan out to the pool
+            // and have their shared writes merged serially afterwards
+            size_t order = 0;
+            buckets.ForEachBucket([this, dt, &order](auto &bucket) {
+                using T = std::remove_pointer_t<typename std::decay_t<decltype(bucket)>::value_type>;
+                ProcessBucket<T>(bucket, dt, order);
+                order += bucket.size();
+            });
 
-            e->Process(dt);
+            for (auto *e : buckets.GetDynamic()) {
+                if (e->GetTickState().update)
+                    e->Process(e->GetTickState().stepDt);
+            }
         }
+
+        iterating = false;
+        stats.processMs = (double)(SDL_GetTicksNS() - start) / 1e6;
     }
 
-    void DrawEntities() {
+    // Re-sorts entitylist by Morton code. Nearly sorted lists (little drift
+    // since the last frame) get an insertion sort. Once more than the
+    // threshold fraction of neighbours are out of order, or the insertion
+    // sort runs past a budget of moves (a few teleports can each shift
+    // most of the list), it does a full stable sort instead.
+    // Entity pointers don't change, only their order in the list.
+    void UpdateSpatialOrder() {
+        stats.spatialInversions = 0;
+        stats.spatialFullSort = false;
+        if (!spatialSort || entitylist.size() < 2)
+            return;
+
+        Uint64 start = SDL_GetTicksNS();
+        size_t count = entitylist.size();
+
+        sortScratch.resize(count);
+        for (size_t i = 0; i < count; i++)
+            sortScratch[i] = {Morton::Encode(entitylist[i]->GetPosition(), spatialCellSize), entitylist[i]};
+
+        size_t inversions = 0;
+        for (size_t i = 1; i < count; i++) {
+            if (sortScratch[i - 1].first > sortScratch[i].first)
+                inversions++;
+        }
+        stats.spatialInversions = inversions;
+        if (inversions == 0)
+            return;
+
+        auto byKey = [](const std::pair<uint64_t, Entity*> &a, const std::pair<uint64_t, Entity*> &b) {
+            return a.first < b.first;
+        };
+
+        bool fullSort = inversions > (size_t)(count * spatialResortThreshold);
+        if (!fullSort) {
+            // Stable like stable_sort, so giving up halfway and finishing
+            // with it gives the same order
+            size_t budget = count * 4, shifts = 0;
+            for (size_t i = 1; i < count && !fullSort; i++) {
+                auto item = sortScratch[i];
+                size_t j = i;
+                while (j > 0 && byKey(item, sortScratch[j - 1])) {
+                    sortScratch[j] = sortScratch[j - 1];
+                    j--;
+                    if (++shifts > budget) {
+                        fullSort = true;
+                        break;
+                    }
+                }
+                sortScratch[j] = item;
+            }
+        }
+        if (fullSort) {
+            std::stable_sort(sortScratch.begin(), sortScratch.end(), byKey);
+            stats.spatialFullSort = true;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            entitylist[i] = sortScratch[i].second;
+
+        stats.spatialSorts++;
+        stats.spatialSortMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    // cellSize should be around the collision cell size
+    void SetSpatialSort(bool enabled, float cellSize = 64.0f, float resortThreshold = 0.05f) {
+        spatialSort = enabled;
+        spatialCellSize = cellSize;
+        spatialResortThreshold = resortThreshold;
+    }
+
+    bool IsSpatialSort() const {
+        return spatialSort;
+    }
+
+    // Captures entities, their velocities and animation state, and the
+    // camera into one buffer. out's capacity is reused between calls.
+    void SaveSnapshot(Snapshot &out) {
+        SnapshotWriter w(out.data);
+        WriteState(w);
+    }
+
+    // Hash of the state SaveSnapshot would capture, for replay and desync
+    // checks. Folds the same fields straight into the hash, nothing is
+    // written out. Not the same value as Snapshot::Checksum.
+    uint64_t Checksum() {
+        uint64_t hash = SnapshotWriter::HASH_SEED;
+        SnapshotWriter w(hash);
+        WriteState(w);
+        return hash;
+    }
+
+    // Restores a snapshot made by SaveSnapshot. When the world holds the same
+    // entities as when it was taken (same count and types) they are updated
+    // in place and pointers stay valid, otherwise the world is rebuilt.
+    bool RestoreSnapshot(const Snapshot &in) {
+        if (iterating) {
+            SDL_Log("World: can't restore a snapshot while iterating");
+            return false;
+        }
+
+        SnapshotReader r(in.data);
+        if (r.Read<uint32_t>() != SNAPSHOT_VERSION) {
+            SDL_Log("World: snapshot version mismatch");
+            return false;
+        }
+
+        uint32_t savedNextId = r.Read<uint32_t>();
+        Camera::GetInstance().LoadState(r);
+
+        uint32_t count = r.Read<uint32_t>();
+        std::vector<uint8_t> &types = snapshotTypes;
+        types.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            types[i] = r.Read<uint8_t>();
+        int32_t localIndex = r.Read<int32_t>();
+        if (!r.IsOk())
+            return false;
+
+        BuildStableOrder();
+        bool inPlace = stableOrder.size() == count;
+        for (uint32_t i = 0; inPlace && i < count; i++)
+            inPlace = (uint8_t)stableOrder[i]->GetType() == types[i];
+
+        if (!inPlace) {
+            ClearEntities();
+            if (max_entities < (int)count)
+                max_entities = (int)count;
+            for (uint32_t i = 0; i < count; i++)
+                InsertEntity(CreateEntityOfType((EntityType)types[i]));
+            BuildStableOrder();
+        }
+
+        std::string name;
+        for (Entity *e : stableOrder) {
+            e->LoadState(r);
+            r.Read(e->id);
+            index.SetTags(e, r.Read<uint64_t>());
+            r.ReadString(name);
+            index.SetName(e, NameTable::GetInstance().Intern(name));
+        }
+        nextEntityId = savedNextId;
+
+        localPlayer = nullptr;
+        if (localIndex >= 0 && localIndex < (int32_t)count && stableOrder[localIndex]->GetType() == EntityType::PLAYER)
+            localPlayer = static_cast<Player*>(stableOrder[localIndex]);
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t index = r.Read<uint32_t>();
+            if (index < count)
+                entitylist[i] = stableOrder[index];
+        }
+
+        transforms.Clear();
+        uint32_t linkCount = r.Read<uint32_t>();
+        for (uint32_t i = 0; i < linkCount && r.IsOk(); i++) {
+            uint32_t child = r.Read<uint32_t>();
+            uint32_t parent = r.Read<uint32_t>();
+            Vector2 local = r.Read<Vector2>();
+            if (child < count && parent < count)
+                transforms.Attach(stableOrder[child], stableOrder[parent], local);
+        }
+
+        // Trace queries in the next step should see the restored positions
+        CollisionSystem::GetInstance().BuildSpatialGrid(entitylist);
+        chunkCache.Refresh(entitylist);
+        culling.Refresh(entitylist);
+
+        return r.IsOk();
+    }
+
+    // Attaches child to parent, from then on the child's position is the
+    // parent's position + local. Removing the parent detaches its children.
+    bool Attach(Entity *child, Entity *parent, Vector2 local) {
+        return transforms.Attach(child, parent, local);
+    }
+
+    // Attaches keeping the child where it currently is
+    bool Attach(Entity *child, Entity *parent) {
+        return transforms.Attach(child, parent, child->GetPosition() - parent->GetPosition());
+    }
+
+    void Detach(Entity *child) {
+        transforms.Detach(child);
+    }
+
+    void SetLocalPosition(Entity *child, Vector2 local) {
+        transforms.SetLocalPosition(child, local);
+    }
+
+    Vector2 GetLocalPosition(const Entity *child) const {
+        return transforms.GetLocalPosition(child);
+    }
+
+    // Call after moving an attached child other than through
+    // SetLocalPosition (collision resolve already does), the next
+    // UpdateTransforms puts it back at parent + local
+    void OnChildMoved(Entity *child) {
+        transforms.MarkMoved(child);
+    }
+
+    // Writes the world position of attached entities whose parent moved,
+    // whose offset changed or that were moved off it. Runs after anything
+    // that moves parents (process, collision resolve) and before collision
+    // and drawing.
+    void UpdateTransforms() {
+        transforms.Update();
+        for (Entity *e : transforms.GetMovedStatic())
+            OnStaticChanged(e);
+    }
+
+    const TransformHierarchy& GetTransforms() const {
+        return transforms;
+    }
+
+    // Every entity whose exact class is T (subclasses of T are in their own
+    // bucket). T must be one of WorldEntityTypes.
+    template <typename T>
+    EntityView<T> Query() {
+        return EntityView<T>(buckets.Get<T>());
+    }
+
+    // Entities that have all tags in mask, e.g. WithTags(NameTable::GetInstance().Tag("enemy"))
+    TagView WithTags(uint64_t mask) const {
+        return index.WithTags(mask);
+    }
+
+    EntityView<Entity> WithName(const std::string &name) const {
+        return index.WithName(NameTable::GetInstance().Find(name));
+    }
+
+    // First entity with that name, nullptr if there is none
+    Entity* FindEntity(const std::string &name) const {
+        EntityView<Entity> found = WithName(name);
+        return found.empty() ? nullptr : found[0];
+    }
+
+    void RetagEntity(Entity *entity, uint64_t tags) {
+        index.SetTags(entity, tags);
+    }
+
+    void AddTags(Entity *entity, uint64_t tags) {
+        index.SetTags(entity, entity->GetTags() | tags);
+    }
+
+    void RemoveTags(Entity *entity, uint64_t tags) {
+        index.SetTags(entity, entity->GetTags() & ~tags);
+    }
+
+    // Names don't have to be unique, an empty name removes it
+    void RenameEntity(Entity *entity, const std::string &name) {
+        index.SetName(entity, NameTable::GetInstance().Intern(name));
+    }
+
+    // Broadphase over entitylist, the pairs are kept for ResolveCollisions
+    void DetectCollisions() {
+        iterating = true;
+        stepCollisions = CollisionSystem::GetInstance().DetectCollisions(entitylist);
+        iterating = false;
+    }
+
+    // Pushes the pairs DetectCollisions found apart, spawns and destroys
+    // from here wait for the next FlushCommands
+    void ResolveCollisions() {
+        iterating = true;
+        CollisionSystem::GetInstance().ResolveCollisions(stepCollisions);
+        iterating = false;
+
+        // Pushed children go back to parent + local in UpdateTransforms
+        for (const CollisionInfo_t &c : stepCollisions) {
+            if (c.a->GetParent())
+                transforms.MarkMoved(c.a);
+            if (c.b->GetParent())
+                transforms.MarkMoved(c.b);
+        }
+    }
+
+    const std::vector<CollisionInfo_t>& GetStepCollisions() const {
+        return stepCollisions;
+    }
+
+    // Call before each fixed simulation step
+    void BeginStep() {
+        for (auto *e : entitylist)
+            e->SavePreviousPosition();
+        Camera::GetInstance().SavePreviousPosition();
+    }
+
+    // The phases of one fixed step in order, with the resources each reads
+    // and writes. Step runs them serially and the frame graph in main.cpp
+    // schedules them by their resources, both from this list: rollback and
+    // replay need the two to step alike.
+    static const std::vector<WorldPhase_t>& GetStepPhases() {
+        static const std::vector<WorldPhase_t> phases = {
+            // Traces see where entities are at the start of the step, not
+            // where the last broadphase saw them before the resolve. The step
+            // then depends only on world state.
+            {"grid", {"entities"}, {"grid"}, [](World &world, double) {
+                CollisionSystem::GetInstance().BuildSpatialGrid(world.entitylist);
+            }},
+            {"process", {"grid"}, {"entities", "animation", "camera"}, [](World &world, double dt) {
+                world.ProcessEntities(dt);
+            }},
+            {"commands", {}, {"entities"}, [](World &world, double) {
+                world.FlushCommands();
+            }},
+            {"transforms", {}, {"entities"}, [](World &world, double) {
+                world.UpdateTransforms();
+            }},
+            {"spatial", {}, {"entities"}, [](World &world, double) {
+                world.UpdateSpatialOrder();
+            }},
+            // Only touches animation state, overlaps the broadphase
+            {"animation", {"entities"}, {"animation"}, [](World &world, double dt) {
+                world.TickAnimations(dt);
+            }},
+            {"broadphase", {"entities"}, {"grid", "collisions"}, [](World &world, double) {
+                world.DetectCollisions();
+            }},
+            {"resolve", {"collisions"}, {"entities"}, [](World &world, double) {
+                world.ResolveCollisions();
+            }},
+            // Children follow parents pushed around by the resolve before drawing
+            {"transforms2", {}, {"entities"}, [](World &world, double) {
+                world.UpdateTransforms();
+            }},
+            {"commands2", {}, {"entities"}, [](World &world, double) {
+                world.FlushCommands();
+            }},
+        };
+        return phases;
+    }
+
+    // One fixed step through GetStepPhases, run serially. For worlds stepped
+    // outside the main loop (rollback, replay, tools).
+    void Step(double dt) {
+        BeginStep();
+        for (const WorldPhase_t &phase : GetStepPhases())
+            phase.run(*this, dt);
+    }
+
+    // Blend between the last two simulation steps for rendering, alpha is how
+    // far the clock is into the next step (0..1)
+    void Interpolate(float alpha) {
+        for (auto *e : entitylist)
+            e->InterpolatePosition(alpha);
+        Camera::GetInstance().InterpolatePosition(alpha);
+        if (viewCulling) {
+            Uint64 start = SDL_GetTicksNS();
+            culling.Update();
+            cullUpdateMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+        }
+    }
+
+    // Advances sprite animations. Only touches animation state, so the frame
+    // graph runs it next to the collision broadphase.
+    // Animations of off-screen entities aren't ticked at all.
+    void TickAnimations(double dt) {
+        Vector2 viewMin, viewMax;
+        tickScheduler.GetViewBounds(viewMin, viewMax);
+
+        if (parallelUpdate && animatedList.size() >= parallelMinEntities) {
+            std::atomic<int> skipped{0};
+            ThreadPool::GetInstance().ParallelFor(animatedList.size(), 256, [&](size_t begin, size_t end) {
+                int localSkipped = 0;
+                for (size_t i = begin; i < end; i++) {
+                    if (tickScheduler.ShouldTickAnimation(animatedList[i], viewMin, viewMax))
+                        animatedList[i]->TickAnimation(dt);
+                    else
+                        localSkipped++;
+                }
+                skipped += localSkipped;
+            });
+            tickScheduler.SetAnimationsSkipped(skipped);
+            return;
+        }
+
+        int skipped = 0;
+        for (auto *a : animatedList) {
+            if (tickScheduler.ShouldTickAnimation(a, viewMin, viewMax))
+                a->TickAnimation(dt);
+            else
+                skipped++;
+        }
+        tickScheduler.SetAnimationsSkipped(skipped);
+    }
+
+    TickScheduler& GetTickScheduler() {
+        return tickScheduler;
+    }
+
+    // Opt-in: update IsParallelSafe() entities across the thread pool once
+    // there are at least minEntities of them
+    void SetParallelUpdate(bool enabled, size_t minEntities = 256) {
+        parallelUpdate = enabled;
+        parallelMinEntities = minEntities;
+    }
+
+    bool IsParallelUpdate() const {
+        return parallelUpdate;
+    }
+
+    // Culls and queues the frame into the RenderQueue, false when there is
+    // nothing to draw. useCache lets the chunk cache render its targets.
+    bool QueueEntities(bool useCache) {
         if (entitylist.size() == 0)
+            return false;
+
+        RenderQueue &queue = RenderQueue::GetInstance();
+
+        // The cache renders its stale chunks first and opens the queue
+        bool cached = useCache && chunkCache.IsEnabled();
+        if (cached) {
+            Vector2 viewMin, viewMax;
+            GetViewBounds(viewMin, viewMax);
+            chunkCache.Draw(entitylist, viewMin, viewMax, [this](RenderQueue &q, Entity *e) {
+                SetDrawOwner(q, e);
+                if (staticDispatch)
+                    EntityBuckets<WorldEntityTypes>::Draw(e, e->worldBucket);
+                else
+                    e->Draw();
+            });
+        } else {
+            queue.Begin();
+        }
+
+        if (viewCulling) {
+            QueueVisible(queue, cached);
+        } else {
+            int drawn = 0;
+            if (!staticDispatch) {
+                for (auto *e : entitylist) {
+                    if (!e || e == nullptr || (cached && e->drawCached))
+                        continue;
+
+                    SetDrawOwner(queue, e);
+                    e->Draw();
+                    drawn++;
+                }
+            } else {
+                buckets.ForEachBucket([this, &queue, &drawn, cached](auto &bucket) {
+                    using T = std::remove_pointer_t<typename std::decay_t<decltype(bucket)>::value_type>;
+                    for (T *e : bucket) {
+                        if (cached && e->drawCached)
+                            continue;
+                        SetDrawOwner(queue, e);
+                        e->T::Draw();
+                        drawn++;
+                    }
+                });
+
+                for (auto *e : buckets.GetDynamic()) {
+                    if (cached && e->drawCached)
+                        continue;
+                    SetDrawOwner(queue, e);
+                    e->Draw();
+                    drawn++;
+                }
+            }
+            stats.drawnEntities = drawn;
+            stats.culledEntities = 0;
+        }
+        return true;
+    }
+
+    void DrawEntities() {
+        Uint64 start = SDL_GetTicksNS();
+        if (!QueueEntities(true))
             return;
 
-        for (auto *e : entitylist) {
-            if (!e || e == nullptr)
+        SpriteBatch &batch = SpriteBatch::GetInstance();
+        batch.Begin();
+        RenderQueue::GetInstance().Submit(batch);
+        batch.End();
+        stats.drawMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    // The frame DrawEntities would draw, kept in list for another thread to
+    // draw. Never touches the renderer, so the chunk cache is bypassed and
+    // cached entities are queued one by one.
+    void RecordEntities(DrawList_t &list) {
+        Uint64 start = SDL_GetTicksNS();
+        if (!QueueEntities(false)) {
+            list.items.clear();
+            list.vertices.clear();
+            return;
+        }
+        RenderQueue::GetInstance().Record(list);
+        stats.drawMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    }
+
+    // The bucket then insertion order, what the buckets draw in
+    static uint64_t DrawRank(const Entity *e) {
+        uint64_t bucket = e->worldBucket < 0 ? (uint64_t)EntityBuckets<WorldEntityTypes>::Count : (uint64_t)e->worldBucket;
+        return (bucket << 32) | e->drawOrder;
+    }
+
+    // Sort inputs for what e queues next: DrawRank and the bottom edge for
+    // y-sorted layers
+    void SetDrawOwner(RenderQueue &queue, Entity *e) {
+        float bottom = e->GetRenderPosition().y + std::fabs(e->GetDrawSize().y * e->GetScale()) * 0.5f;
+        queue.SetOwner(e, e->renderLayer, DrawRank(e), bottom);
+    }
+
+    // Camera view in world units, grown by the cull margin
+    void GetViewBounds(Vector2 &viewMin, Vector2 &viewMax) const {
+        Camera &camera = Camera::GetInstance();
+        Vector2 half = Screen::GetInstance().GetSize() / (2.0f * camera.GetZoom());
+        Vector2 margin = {cullMargin, cullMargin};
+        viewMin = camera.GetRenderPosition() - half - margin;
+        viewMax = camera.GetRenderPosition() + half + margin;
+    }
+
+    // Queues what the view rectangle touches, cached entities came with
+    // their chunk
+    void QueueVisible(RenderQueue &queue, bool cached) {
+        Uint64 start = SDL_GetTicksNS();
+        Vector2 viewMin, viewMax;
+        GetViewBounds(viewMin, viewMax);
+
+        cullCandidates.clear();
+        culling.Query(viewMin, viewMax, cullCandidates);
+        // The grid hands them out in cell order, which changes whenever
+        // something changes cell. In draw order the queue sees the same
+        // owners as last frame and can start from last frame's sort.
+        std::sort(cullCandidates.begin(), cullCandidates.end(), [](const Entity *a, const Entity *b) {
+            return DrawRank(a) < DrawRank(b);
+        });
+
+        int drawn = 0;
+        for (Entity *e : cullCandidates) {
+            if (cached && e->drawCached)
+                continue;
+            Vector2 pos = e->GetRenderPosition();
+            Vector2 extent = e->GetDrawSize() * (e->GetScale() * 0.5f);
+            extent = {std::fabs(extent.x), std::fabs(extent.y)};
+            if (pos.x + extent.x < viewMin.x || pos.x - extent.x > viewMax.x ||
+                pos.y + extent.y < viewMin.y || pos.y - extent.y > viewMax.y)
                 continue;
 
-            e->Draw();
+            SetDrawOwner(queue, e);
+            if (staticDispatch)
+                EntityBuckets<WorldEntityTypes>::Draw(e, e->worldBucket);
+            else
+                e->Draw();
+            drawn++;
         }
+        stats.cullMs = cullUpdateMs + (double)(SDL_GetTicksNS() - start) / 1e6;
+        stats.drawnEntities = drawn;
+        stats.culledEntities = (int)entitylist.size() - drawn - (cached ? chunkCache.GetStats().cachedEntities : 0);
+    }
+
+    // Only entities in view are drawn. margin is in world units around the
+    // view, it covers movement since the grid update and drawing that spills
+    // past an entity's bounds.
+    void SetViewCulling(bool enabled, float margin = 32.0f) {
+        viewCulling = enabled;
+        cullMargin = margin;
+    }
+
+    bool IsViewCulling() const {
+        return viewCulling;
+    }
+
+    float GetCullMargin() const {
+        return cullMargin;
+    }
+
+    CullingGrid& GetCullingGrid() {
+        return culling;
+    }
+
+    // Pre-renders static entities per chunk, on by default. Turning it off
+    // draws them one by one again.
+    void SetDrawCache(bool enabled) {
+        chunkCache.SetEnabled(enabled, entitylist);
+    }
+
+    bool IsDrawCache() const {
+        return chunkCache.IsEnabled();
+    }
+
+    // Call after moving or restyling a static entity, or after changing
+    // whether it's static. Re-renders its draw cache chunk and refiles it in
+    // the culling grid, which only follows non-static entities on its own.
+    void OnStaticChanged(Entity *entity) {
+        chunkCache.Invalidate(entity);
+        culling.Refile(entity);
+    }
+
+    ChunkCache& GetChunkCache() {
+        return chunkCache;
+    }
+
+    // Switches between the per-type buckets (default) and the old
+    // virtual-call path over entitylist, for comparing the two
+    void SetStaticDispatch(bool enabled) {
+        staticDispatch = enabled;
+    }
+
+    bool IsStaticDispatch() const {
+        return staticDispatch;
+    }
+
+    const WorldStats_t& GetStats() const {
+        return stats;
     }
 
     void SetMaxEntities(int max_entities) {
@@ -86,11 +970,21 @@ class World {
 
     void SetLocalPlayer(Player *player) {
         localPlayer = player;
+        if (player)
+            player->SetAlwaysUpdate(true);
     }
 
     void ClearEntities() {
+        commands.Discard();
+        transforms.Clear();
+        index.Clear();
+        culling.Clear();
+        chunkCache.Clear();
         for (Entity *e : entitylist)
             delete e;
         entitylist.clear();
+        buckets.Clear();
+        animatedList.clear();
+        localPlayer = nullptr;
     }
 };
\ No newline at end of file
@@ -0,0 +1,652 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <SDL3/SDL.h>
+#include "../Engine/enginecontext.h"
+#include "../World/world.h"
+#include "../ThreadPool/threadpool.h"
+#include "../Agent/agent.h"
+#include "../InputRecorder/inputrecorder.h"
+
+// Benchmarks of the World's update paths. Each run builds its scene in a
+// fresh EngineContext, so runs don't share entities or caches. The faster
+// path is checked against the reference one before times are reported,
+// and every bench returns false when a check fails. main runs them through
+// the table at the end of this file.
+
+struct WorldBenchTimes_t {
+    double averageMs = 0.0, medianMs = 0.0, maxMs = 0.0;
+};
+
+namespace WorldBench {
+    inline WorldBenchTimes_t Summarize(std::vector<double> ms) {
+        WorldBenchTimes_t t;
+        if (ms.empty())
+            return t;
+        for (double m : ms)
+            t.averageMs += m;
+        t.averageMs /= ms.size();
+        std::sort(ms.begin(), ms.end());
+        t.medianMs = ms[ms.size() / 2];
+        t.maxMs = ms.back();
+        return t;
+    }
+
+    inline void Log(const char *name, const WorldBenchTimes_t &t, uint64_t checksum) {
+        SDL_Log("  %-10s avg %.3f ms, median %.3f, max %.3f | checksum %016llx",
+                name, t.averageMs, t.medianMs, t.maxMs, (unsigned long long)checksum);
+    }
+
+    // Runs build() then steps, timing measure() after each step, in a
+    // context of its own. Returns the world checksum at the end.
+    inline uint64_t Run(const std::function<void(World&)> &build, int steps,
+                        const std::function<double(World&)> &step, WorldBenchTimes_t &times) {
+        EngineContext context;
+        EngineContext::Scope scope(context);
+        World &world = World::GetInstance();
+        build(world);
+        world.FlushCommands();
+
+        std::vector<double> ms;
+        ms.reserve(steps);
+        for (int i = 0; i < steps; i++)
+            ms.push_back(step(world));
+        times = Summarize(ms);
+        uint64_t checksum = world.Checksum();
+        world.ClearEntities();
+        return checksum;
+    }
+
+    // FNV-1a over what a recorded frame would draw, in order
+    inline uint64_t HashList(const DrawList_t &list) {
+        uint64_t hash = 1469598103934665603ull;
+        auto add = [&hash](const void *data, size_t size) {
+            const uint8_t *bytes = (const uint8_t*)data;
+            for (size_t i = 0; i < size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+        };
+        for (const RenderItem_t &item : list.items) {
+            add(&item.kind, sizeof(item.kind));
+            add(&item.dst, sizeof(item.dst));
+            add(&item.color, sizeof(item.color));
+        }
+        return hash;
+    }
+}
+
+struct ParallelBenchSettings_t {
+    int agents = 10000;
+    int steps = 300;
+};
+
+// Agents wandering around, updated serially and then across the thread
+// pool. Times ProcessEntities only, the phase that goes parallel. Fails
+// when the worlds end up different, parallel updates have to be
+// deterministic.
+inline bool RunParallelBench(const ParallelBenchSettings_t &settings) {
+    SDL_Log("Parallel bench: %d agents, %d steps, %d workers", settings.agents, settings.steps,
+            ThreadPool::GetInstance().GetWorkerCount());
+    auto build = [&settings](bool parallel) {
+        return [&settings, parallel](World &world) {
+            world.SetMaxEntities(settings.agents);
+            world.SetParallelUpdate(parallel);
+            for (int i = 0; i < settings.agents; i++) {
+                Agent *agent = new Agent();
+                Vector2 home = {(float)(i % 100) * 64.0f, (float)(i / 100) * 64.0f};
+                agent->SetPosition(home);
+                agent->SetWander(home, 200.0f, (uint32_t)i * 2654435761u + 1);
+                agent->SetAlwaysUpdate(true);
+                world.AddEntity(agent);
+            }
+        };
+    };
+    auto step = [](World &world) {
+        world.Step(1.0 / 60.0);
+        return world.GetStats().processMs;
+    };
+
+    WorldBenchTimes_t serial, parallel;
+    uint64_t serialSum = WorldBench::Run(build(false), settings.steps, step, serial);
+    uint64_t parallelSum = WorldBench::Run(build(true), settings.steps, step, parallel);
+    WorldBench::Log("serial", serial, serialSum);
+    WorldBench::Log("parallel", parallel, parallelSum);
+    if (parallel.medianMs > 0.0)
+        SDL_Log("  speedup x%.2f", serial.medianMs / parallel.medianMs);
+
+    bool ok = serialSum == parallelSum;
+    if (!ok)
+        SDL_Log("  the parallel world differs");
+    return ok;
+}
+
+struct DispatchBenchSettings_t {
+    int entities = 100000;
+    int steps = 200;
+};
+
+// Wandering agents interleaved with plain rects in insertion order, the
+// worst case for the virtual path's branch prediction. Both paths step the
+// world and record every entity's draw, the view isn't culled. Times
+// ProcessEntities plus RecordEntities. Fails when the worlds or the sorted
+// frames differ.
+inline bool RunDispatchBench(const DispatchBenchSettings_t &settings) {
+    SDL_Log("Dispatch bench: %d entities, %d steps", settings.entities, settings.steps);
+    auto build = [&settings](bool bucketed) {
+        return [&settings, bucketed](World &world) {
+            world.SetMaxEntities(settings.entities);
+            world.SetStaticDispatch(bucketed);
+            world.SetViewCulling(false);
+            for (int i = 0; i < settings.entities; i++) {
+                Vector2 home = {(float)(i % 300) * 32.0f, (float)(i / 300) * 32.0f};
+                if (i % 2 == 0) {
+                    Agent *agent = new Agent();
+                    agent->SetPosition(home);
+                    agent->SetWander(home, 96.0f, (uint32_t)i * 2654435761u + 1);
+                    agent->SetAlwaysUpdate(true);
+                    world.AddEntity(agent);
+                } else {
+                    Entity *rect = new Entity();
+                    rect->SetPosition(home);
+                    rect->SetSize({12.0f, 12.0f});
+                    world.AddEntity(rect);
+                }
+            }
+        };
+    };
+    DrawList_t list;
+    auto step = [&list](World &world) {
+        world.Step(1.0 / 60.0);
+        world.Interpolate(1.0f);
+        world.RecordEntities(list);
+        return world.GetStats().processMs + world.GetStats().drawMs;
+    };
+
+    WorldBenchTimes_t virtualTimes, bucketTimes;
+    uint64_t virtualSum = WorldBench::Run(build(false), settings.steps, step, virtualTimes);
+    uint64_t virtualFrame = WorldBench::HashList(list);
+    uint64_t bucketSum = WorldBench::Run(build(true), settings.steps, step, bucketTimes);
+    uint64_t bucketFrame = WorldBench::HashList(list);
+    WorldBench::Log("virtual", virtualTimes, virtualSum);
+    WorldBench::Log("buckets", bucketTimes, bucketSum);
+    if (bucketTimes.medianMs > 0.0)
+        SDL_Log("  speedup x%.2f", virtualTimes.medianMs / bucketTimes.medianMs);
+
+    bool ok = virtualSum == bucketSum && virtualFrame == bucketFrame && !list.items.empty();
+    if (!ok)
+        SDL_Log("  the bucketed world or frame differs");
+    return ok;
+}
+
+struct SpatialBenchSettings_t {
+    int entities = 50000;
+    int steps = 120;
+    float area = 8000.0f;
+};
+
+// Boxes drifting over a large area, a few teleporting every step, in spawn
+// order and then kept in Morton order. Times the spatial sort plus
+// DetectCollisions and the culled queueing (cullMs) of a view in the
+// middle. The pairs found and the entities drawn have to be the same
+// either way, only the order they are visited in changes.
+inline bool RunSpatialBench(const SpatialBenchSettings_t &settings) {
+    SDL_Log("Spatial bench: %d entities, %d steps, %.0f x %.0f", settings.entities, settings.steps,
+            settings.area, settings.area);
+
+    // Positions are a function of entity and step, so both runs see the same motion
+    auto noise = [](uint32_t a, uint32_t b) {
+        uint32_t h = a * 2654435761u + b * 2246822519u + 0x9e3779b9u;
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return (float)(h >> 8) / 16777216.0f;
+    };
+
+    struct Totals_t {
+        uint64_t pairs = 0, pairHash = 0, drawn = 0;
+        double detectMs = 0.0, cullMs = 0.0;
+    };
+    std::vector<Entity*> boxes;
+    int stepIndex = 0;
+    Totals_t totals;
+    DrawList_t list;
+
+    auto build = [&](bool morton) {
+        return [&, morton](World &world) {
+            boxes.clear();
+            stepIndex = 0;
+            totals = {};
+            world.SetMaxEntities(settings.entities);
+            world.SetSpatialSort(morton, 100.0f);
+            world.SetViewCulling(true);
+            Camera::GetInstance().SetPosition({settings.area * 0.5f, settings.area * 0.5f});
+            for (int i = 0; i < settings.entities; i++) {
+                Entity *box = new Entity();
+                box->SetPosition({noise(i, 0) * settings.area, noise(i, 1) * settings.area});
+                box->SetSize({16.0f, 16.0f});
+                world.AddEntity(box);
+                boxes.push_back(box);
+            }
+        };
+    };
+    auto step = [&](World &world) {
+        CollisionSystem &collisionSystem = CollisionSystem::GetInstance();
+        uint32_t s = (uint32_t)++stepIndex * 4 + 2;
+        world.BeginStep();
+        for (size_t i = 0; i < boxes.size(); i++) {
+            Vector2 p = boxes[i]->GetPosition();
+            if ((i + stepIndex) % 500 == 0)
+                p = {noise(i, s) * settings.area, noise(i, s + 1) * settings.area};
+            else
+                p += Vector2(noise(i, s) - 0.5f, noise(i, s + 1) - 0.5f) * 4.0f;
+            boxes[i]->SetPosition(p);
+        }
+
+        Uint64 start = SDL_GetTicksNS();
+        world.UpdateSpatialOrder();
+        std::vector<CollisionInfo_t> pairs = collisionSystem.DetectCollisions(world.GetEntities());
+        double ms = (double)(SDL_GetTicksNS() - start) / 1e6;
+        world.Interpolate(1.0f);
+        world.RecordEntities(list);
+
+        // Order independent, the Morton order visits pairs differently
+        for (const CollisionInfo_t &c : pairs) {
+            uint64_t a = std::min(c.a->GetId(), c.b->GetId()), b = std::max(c.a->GetId(), c.b->GetId());
+            uint64_t h = ((a << 32) | b) * 0x9e3779b97f4a7c15ull;
+            totals.pairHash += h ^ (h >> 29);
+        }
+        totals.pairs += pairs.size();
+        totals.drawn += world.GetStats().drawnEntities;
+        totals.detectMs += collisionSystem.GetLastDetectMs();
+        totals.cullMs += world.GetStats().cullMs;
+        return ms + world.GetStats().cullMs;
+    };
+
+    WorldBenchTimes_t spawnTimes, mortonTimes;
+    WorldBench::Run(build(false), settings.steps, step, spawnTimes);
+    Totals_t spawn = totals;
+    WorldBench::Run(build(true), settings.steps, step, mortonTimes);
+    Totals_t morton = totals;
+
+    WorldBench::Log("spawn", spawnTimes, spawn.pairHash);
+    SDL_Log("             detect %.3f ms, cull %.3f ms | %llu pairs, %llu drawn", spawn.detectMs / settings.steps,
+            spawn.cullMs / settings.steps, (unsigned long long)spawn.pairs, (unsigned long long)spawn.drawn);
+    WorldBench::Log("morton", mortonTimes, morton.pairHash);
+    SDL_Log("             detect %.3f ms, cull %.3f ms | %llu pairs, %llu drawn", morton.detectMs / settings.steps,
+            morton.cullMs / settings.steps, (unsigned long long)morton.pairs, (unsigned long long)morton.drawn);
+    if (mortonTimes.medianMs > 0.0)
+        SDL_Log("  speedup x%.2f", spawnTimes.medianMs / mortonTimes.medianMs);
+
+    bool ok = spawn.pairs == morton.pairs && spawn.pairHash == morton.pairHash && spawn.drawn == morton.drawn;
+    if (!ok)
+        SDL_Log("  the sorted world found other pairs or drew other entities");
+    return ok;
+}
+
+struct SnapshotBenchSettings_t {
+    int entities = 10000;
+    int steps = 120;
+};
+
+// Agents wandering between static walls and sprites. Every step saves a
+// snapshot and delta encodes it against the step before, as the rollback
+// and replication code do. Then times in-place restores of those
+// snapshots and one restore into an empty world. Every restore has to
+// give back the checksum the world had when it was saved.
+inline bool RunSnapshotBench(const SnapshotBenchSettings_t &settings) {
+    SDL_Log("Snapshot bench: %d entities, %d steps", settings.entities, settings.steps);
+    EngineContext context;
+    EngineContext::Scope scope(context);
+    World &world = World::GetInstance();
+    world.SetMaxEntities(settings.entities);
+    for (int i = 0; i < settings.entities; i++) {
+        Vector2 home = {(float)(i % 100) * 48.0f, (float)(i / 100) * 48.0f};
+        Entity *e;
+        if (i % 3 == 0) {
+            Agent *agent = new Agent();
+            agent->SetWander(home, 64.0f, (uint32_t)i * 2654435761u + 1);
+            agent->SetAlwaysUpdate(true);
+            e = agent;
+        } else if (i % 3 == 1) {
+            e = new SpriteEntity();
+        } else {
+            e = new Entity();
+            e->SetStatic(true);
+        }
+        e->SetPosition(home);
+        world.AddEntity(e);
+    }
+    world.FlushCommands();
+
+    std::vector<Snapshot> snapshots(settings.steps);
+    std::vector<uint64_t> checksums(settings.steps);
+    std::vector<uint8_t> delta;
+    std::vector<double> saveMs;
+    size_t deltaBytes = 0;
+    bool ok = true;
+    for (int s = 0; s < settings.steps; s++) {
+        world.Step(1.0 / 60.0);
+        Uint64 start = SDL_GetTicksNS();
+        world.SaveSnapshot(snapshots[s]);
+        saveMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+        checksums[s] = world.Checksum();
+
+        if (s > 0) {
+            snapshots[s].EncodeDelta(snapshots[s - 1], delta);
+            deltaBytes += delta.size();
+            Snapshot decoded;
+            if (!decoded.DecodeDelta(snapshots[s - 1], delta) || decoded.data != snapshots[s].data)
+                ok = false;
+        }
+    }
+
+    // Oldest first, the entities are still the same so pointers are kept
+    std::vector<double> restoreMs;
+    for (int s = 0; s < settings.steps; s++) {
+        Uint64 start = SDL_GetTicksNS();
+        bool restored = world.RestoreSnapshot(snapshots[s]);
+        restoreMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+        if (!restored || world.Checksum() != checksums[s])
+            ok = false;
+    }
+
+    world.ClearEntities();
+    Uint64 start = SDL_GetTicksNS();
+    bool rebuilt = world.RestoreSnapshot(snapshots.back());
+    double rebuildMs = (double)(SDL_GetTicksNS() - start) / 1e6;
+    if (!rebuilt || world.Checksum() != checksums.back())
+        ok = false;
+    world.ClearEntities();
+
+    WorldBench::Log("save", WorldBench::Summarize(saveMs), checksums.back());
+    WorldBench::Log("restore", WorldBench::Summarize(restoreMs), checksums.back());
+    SDL_Log("  rebuild    %.3f ms | snapshot %zu bytes, delta avg %zu bytes", rebuildMs,
+            snapshots.back().data.size(), settings.steps > 1 ? deltaBytes / (settings.steps - 1) : (size_t)0);
+    if (!ok)
+        SDL_Log("  a restore or delta didn't round trip");
+    return ok;
+}
+
+struct TransformBenchSettings_t {
+    int parents = 2000;
+    int children = 4;       // per parent
+    int steps = 120;
+};
+
+// Children on wandering agents and on still walls. Every step some
+// children of still parents are pushed away and reported with OnChildMoved,
+// as collision resolve does, and after the step every child has to be back
+// at parent + local. Then detaches nodes from the middle of the hierarchy
+// and checks that the children after them still take local offsets and
+// reattach without duplicate nodes. Times UpdateTransforms and counts the
+// nodes it visits, subtrees of still walls should be skipped.
+inline bool RunTransformBench(const TransformBenchSettings_t &settings) {
+    SDL_Log("Transform bench: %d parents x %d children, %d steps", settings.parents, settings.children,
+            settings.steps);
+    EngineContext context;
+    EngineContext::Scope scope(context);
+    World &world = World::GetInstance();
+    world.SetMaxEntities(settings.parents * (settings.children + 1));
+
+    std::vector<Entity*> children;
+    for (int i = 0; i < settings.parents; i++) {
+        Vector2 home = {(float)(i % 50) * 96.0f, (float)(i / 50) * 96.0f};
+        Entity *parent;
+        if (i % 2 == 0) {
+            Agent *agent = new Agent();
+            agent->SetWander(home, 32.0f, (uint32_t)i * 2654435761u + 1);
+            agent->SetAlwaysUpdate(true);
+            parent = agent;
+        } else {
+            parent = new Entity();
+            parent->SetStatic(true);
+        }
+        parent->SetPosition(home);
+        world.AddEntity(parent);
+
+        for (int c = 0; c < settings.children; c++) {
+            Entity *child = new Entity();
+            child->SetSize({4.0f, 4.0f});
+            child->SetCollision(false);
+            world.AddEntity(child);
+            world.Attach(child, parent, {(float)(c - settings.children / 2) * 8.0f, 16.0f});
+            children.push_back(child);
+        }
+    }
+    world.FlushCommands();
+
+    auto misplaced = [&world, &children]() {
+        int count = 0;
+        for (Entity *child : children) {
+            if (child->GetParent() &&
+                child->GetPosition() != child->GetParent()->GetPosition() + world.GetLocalPosition(child))
+                count++;
+        }
+        return count;
+    };
+
+    bool ok = true;
+    std::vector<double> updateMs;
+    int updated = 0, visited = 0;
+    for (int s = 0; s < settings.steps; s++) {
+        world.Step(1.0 / 60.0);
+
+        // Children of walls are at odd parent indices
+        for (size_t i = (size_t)settings.children * (s % 7 * 2 + 1); i < children.size(); i += (size_t)settings.children * 14) {
+            children[i]->SetPosition(children[i]->GetPosition() + Vector2(5.0f, -3.0f));
+            world.OnChildMoved(children[i]);
+        }
+
+        Uint64 start = SDL_GetTicksNS();
+        world.UpdateTransforms();
+        updateMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+        updated += world.GetTransforms().GetLastUpdatedCount();
+        visited += world.GetTransforms().GetLastVisitedCount();
+        if (misplaced() > 0)
+            ok = false;
+    }
+    int moved = misplaced();
+
+    // Detach every third child, front to back, then move and reattach the rest
+    size_t nodes = world.GetTransforms().GetNodes().size();
+    size_t detached = 0;
+    for (size_t i = 0; i < children.size(); i += 3) {
+        world.Detach(children[i]);
+        detached++;
+    }
+    for (size_t i = 1; i < children.size(); i += 3)
+        world.SetLocalPosition(children[i], {0.0f, -24.0f});
+    for (size_t i = 2; i < children.size(); i += 3)
+        world.Attach(children[i], children[i]->GetParent(), {0.0f, 24.0f});
+    world.UpdateTransforms();
+    int offsetsLost = 0;
+    for (size_t i = 0; i < children.size(); i++) {
+        if (i % 3 == 0)
+            continue;
+        Vector2 local = i % 3 == 1 ? Vector2(0.0f, -24.0f) : Vector2(0.0f, 24.0f);
+        if (children[i]->GetPosition() != children[i]->GetParent()->GetPosition() + local)
+            offsetsLost++;
+    }
+    size_t expectedNodes = nodes - detached;
+    if (offsetsLost > 0 || world.GetTransforms().GetNodes().size() != expectedNodes)
+        ok = false;
+
+    WorldBench::Log("update", WorldBench::Summarize(updateMs), world.Checksum());
+    SDL_Log("  %.1f nodes visited and %.1f written per step of %zu, %d left misplaced | detach: %d offsets lost, %zu nodes for %zu children",
+            (double)visited / settings.steps, (double)updated / settings.steps, children.size(), moved, offsetsLost,
+            world.GetTransforms().GetNodes().size(), expectedNodes);
+    world.ClearEntities();
+    if (!ok)
+        SDL_Log("  a child isn't at parent + local");
+    return ok;
+}
+
+struct ReplayBenchSettings_t {
+    int agents = 5000;
+    int steps = 600;
+};
+
+// A player driven by scripted input among wandering agents and walls,
+// recorded through the InputRecorder and then replayed from the recording's
+// start snapshot. The replay has to match every recorded checksum. Also
+// times World::Checksum against saving a snapshot and hashing the buffer,
+// the way checksums were taken before.
+inline bool RunReplayBench(const ReplayBenchSettings_t &settings) {
+    SDL_Log("Replay bench: %d agents, %d steps", settings.agents, settings.steps);
+    EngineContext context;
+    EngineContext::Scope scope(context);
+    World &world = World::GetInstance();
+    InputSystem &input = InputSystem::GetInstance();
+    InputRecorder &recorder = InputRecorder::GetInstance();
+    world.SetMaxEntities(settings.agents * 2 + 16);
+    input.SetKeyboardEnabled(false);
+
+    Entity *floor = new Entity();
+    floor->SetPosition({0.0f, 200.0f});
+    floor->SetSize({4000.0f, 32.0f});
+    floor->SetStatic(true);
+    world.AddEntity(floor);
+    for (int i = 0; i < settings.agents; i++) {
+        Vector2 home = {(float)(i % 100) * 48.0f - 2400.0f, -(float)(i / 100) * 48.0f};
+        Agent *agent = new Agent();
+        agent->SetWander(home, 64.0f, (uint32_t)i * 2654435761u + 1);
+        agent->SetAlwaysUpdate(true);
+        agent->SetPosition(home);
+        world.AddEntity(agent);
+        Entity *wall = new Entity();
+        wall->SetPosition(home + Vector2{24.0f, 24.0f});
+        wall->SetSize({8.0f, 8.0f});
+        wall->SetStatic(true);
+        world.AddEntity(wall);
+    }
+    Player *player = new Player();
+    player->InitializeAnimations();
+    player->SetSize({14.0f, 17.0f});
+    player->SetPosition({0.0f, 150.0f});
+    world.AddEntity(player);
+    world.FlushCommands();
+
+    static const uint8_t moves[] = {0, INPUT_LEFT, INPUT_RIGHT, INPUT_LEFT | INPUT_JUMP, INPUT_RIGHT | INPUT_JUMP, INPUT_JUMP};
+    const double dt = 1.0 / 60.0;
+    std::vector<double> checksumMs, snapshotMs;
+    uint64_t fieldHash = 0, bufferHash = 0;
+    Snapshot scratch;
+    recorder.StartRecording(world);
+    for (int s = 0; s < settings.steps; s++) {
+        input.Set(0, {moves[(s / 20) % sizeof(moves)]});
+        double stepDt = dt;
+        recorder.BeforeStep(stepDt);
+        world.Step(stepDt);
+        recorder.AfterStep(world);
+
+        Uint64 start = SDL_GetTicksNS();
+        fieldHash = world.Checksum();
+        checksumMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+        start = SDL_GetTicksNS();
+        world.SaveSnapshot(scratch);
+        bufferHash = scratch.Checksum();
+        snapshotMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+    }
+    recorder.StopRecording();
+    uint64_t recorded = world.Checksum();
+
+    bool ok = recorder.StartReplay(world);
+    std::vector<double> replayMs;
+    while (ok && !recorder.IsReplayDone()) {
+        input.Set(0, InputState_t());   // the recording's inputs replace these
+        double stepDt = 0.0;
+        recorder.BeforeStep(stepDt);
+        Uint64 start = SDL_GetTicksNS();
+        world.Step(stepDt);
+        replayMs.push_back((double)(SDL_GetTicksNS() - start) / 1e6);
+        recorder.AfterStep(world);
+    }
+    const ReplayStats_t &stats = recorder.GetReplayStats();
+    ok = ok && stats.frames == (size_t)settings.steps && stats.mismatches == 0 && world.Checksum() == recorded;
+    world.ClearEntities();
+
+    WorldBench::Log("replay", WorldBench::Summarize(replayMs), recorded);
+    WorldBench::Log("checksum", WorldBench::Summarize(checksumMs), fieldHash);
+    WorldBench::Log("snapshot", WorldBench::Summarize(snapshotMs), bufferHash);
+    SDL_Log("  %zu of %d frames replayed, %zu mismatches", stats.frames, settings.steps, stats.mismatches);
+    if (!ok)
+        SDL_Log("  the replay didn't reproduce the recording");
+    return ok;
+}
+
+// What main runs for --<flag>[=N], N sets the bench's size (agents,
+// entities, parents) and 0 keeps its default. Flags are matched and the
+// result reported here, a bench only logs its numbers and why it failed.
+struct WorldBenchEntry_t {
+    const char *flag;
+    const char *name;
+    bool (*run)(int size);
+};
+
+namespace WorldBench {
+    inline const std::vector<WorldBenchEntry_t>& GetBenches() {
+        static const std::vector<WorldBenchEntry_t> benches = {
+            {"--parallel-bench", "Parallel", [](int size) {
+                ParallelBenchSettings_t settings;
+                if (size > 0)
+                    settings.agents = size;
+                return RunParallelBench(settings);
+            }},
+            {"--dispatch-bench", "Dispatch", [](int size) {
+                DispatchBenchSettings_t settings;
+                if (size > 0)
+                    settings.entities = size;
+                return RunDispatchBench(settings);
+            }},
+            {"--spatial-bench", "Spatial", [](int size) {
+                SpatialBenchSettings_t settings;
+                if (size > 0)
+                    settings.entities = size;
+                return RunSpatialBench(settings);
+            }},
+            {"--snapshot-bench", "Snapshot", [](int size) {
+                SnapshotBenchSettings_t settings;
+                if (size > 0)
+                    settings.entities = size;
+                return RunSnapshotBench(settings);
+            }},
+            {"--transform-bench", "Transform", [](int size) {
+                TransformBenchSettings_t settings;
+                if (size > 0)
+                    settings.parents = size;
+                return RunTransformBench(settings);
+            }},
+            {"--replay-bench", "Replay", [](int size) {
+                ReplayBenchSettings_t settings;
+                if (size > 0)
+                    settings.agents = size;
+                return RunReplayBench(settings);
+            }},
+        };
+        return benches;
+    }
+
+    // The bench arg asks for, nullptr if it isn't one. size gets N from =N.
+    inline const WorldBenchEntry_t* Match(const char *arg, int &size) {
+        for (const WorldBenchEntry_t &bench : GetBenches()) {
+            size_t length = SDL_strlen(bench.flag);
+            if (SDL_strncmp(arg, bench.flag, length) != 0 || (arg[length] != '\0' && arg[length] != '='))
+                continue;
+            size = arg[length] == '=' ? SDL_atoi(arg + length + 1) : 0;
+            return &bench;
+        }
+        return nullptr;
+    }
+
+    inline bool RunBench(const WorldBenchEntry_t &bench, int size) {
+        bool ok = bench.run(size);
+        SDL_Log("%s bench: %s", bench.name, ok ? "ok" : "FAILED");
+        return ok;
+    }
+}
@@ -9,6 +9,12 @@ cp -r Assets build/Assets
 
 if [[ "$1" == "imgui" ]]; then
     clang++ -o build/main *.cpp -lSDL3 -lSDL3_image -lm -DENABLEIMGUI
+elif [[ "$1" == "headless" ]]; then
+    clang++ -o build/main main.cpp -lSDL3 -lm -DHEADLESS
+elif [[ "$1" == "bench" ]]; then
+    clang++ -O2 -o build/main main.cpp -lSDL3 -lm -DHEADLESS
+    ./build/main --render-bench
+    exit $?
 else
     clang++ -o build/main main.cpp -lSDL3 -lSDL3_image -lm
 fi
@@ -13,6 +13,14 @@
 #include "CollisionSystem/collisionsystem.h"
 //#include "SpriteEntity/spriteentity.h"
 #include "Material/materialmanager.h"
+#include "TaskGraph/taskgraph.h"
+#include "Net/replicationbench.h"
+#include "Net/rollbackbench.h"
+#include "RenderBench/renderbench.h"
+#include "WorldBench/worldbench.h"
+#include "FramePipeline/framepipeline.h"
+#include "InputSystem/inputsystem.h"
+#include "InputRecorder/inputrecorder.h"
 
 //#define ENABLEIMGUI
 
@@ -38,7 +46,40 @@ extern "C" {
 #include "Lua/Libraries/camera.h"
 #endif
 
-double oldNow = 0.0;
+// Fixed-step simulation clock
+static Uint64 oldNowNS = 0;
+static Uint64 accumulatorNS = 0;
+static Uint64 fixedStepNS = SDL_NS_PER_SECOND / 60;
+static constexpr int MAX_CATCHUP_STEPS = 5; // beyond this we drop time instead of spiraling
+static double renderDelta = 0.0;            // real time since the last rendered frame
+
+// Headless: no window, renderer or textures, only the simulation runs.
+// HEADLESS builds are always headless, others opt in with --headless.
+#ifdef HEADLESS
+static bool headless = true;
+#else
+static bool headless = false;
+#endif
+static bool uncapped = false;   // headless: step as fast as possible instead of following the clock
+static Uint64 maxSteps = 0;     // quit after this many steps, 0 runs forever
+static Uint64 simSteps = 0;
+static Uint64 runStartNS = 0;
+static const char *recordPath = nullptr;    // --record, saved on quit
+static const char *replayPath = nullptr;    // --replay, runs headless and uncapped
+static int atlasPageSize = 0;               // --atlas, 0 keeps one texture per material
+
+// --render-thread: the simulation runs on its own thread and records draw
+// lists, this (main) thread only draws them
+static FramePipeline pipeline;
+// SDL's keyboard state belongs to the main thread. It's copied here before
+// the steps run, with the render thread on between Sync and Kick, and the
+// steps read the copy.
+static InputState_t keyboardInput;
+
+// Simulation phases, built once in SDL_AppInit and run for every fixed step
+static TaskGraph frameGraph;
+static double frameDelta = 0.0;
+static double stepDelta = 0.0;     // dt of the step the graph is running, a replay's recorded one
 #ifdef ENABLEIMGUI
 ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 float entSize[2] = {500.0, 500.0};
@@ -52,6 +93,151 @@ float entScale = 1.0f;
 lua_State *L = nullptr;
 #endif
 
+#ifdef ENABLEIMGUI
+static void DrawFrameGraphUI() {
+    if (ImGui::Begin("Frame Graph", NULL, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::Text("Last frame: %.3f ms", frameGraph.GetLastFrameMs());
+        for (const auto& node : frameGraph.GetNodes()) {
+            ImGui::BulletText("%-10s %7.3f +%7.3f ms %s", node->name.c_str(),
+                              node->startMs, node->durationMs, node->ranOnMain ? "(main)" : "");
+        }
+        if (ImGui::Button("Log Graph"))
+            frameGraph.LogGraph();
+        if (pipeline.IsRunning()) {
+            const FramePipelineStats_t &stats = pipeline.GetStats();
+            bool pipelined = pipeline.GetLatency() == FrameLatency_t::PIPELINED;
+            if (ImGui::Checkbox("Pipelined (one frame of latency)", &pipelined))
+                pipeline.SetLatency(pipelined ? FrameLatency_t::PIPELINED : FrameLatency_t::LOW);
+            ImGui::Text("Simulation thread %.3f ms, waited %.3f ms", stats.produceMs, stats.waitMs);
+        }
+    }
+    ImGui::End();
+}
+#endif
+
+static void RenderFrame() {
+    SDL_Renderer *renderer = Screen::GetInstance().GetRenderer();
+    World &world = World::GetInstance();
+
+    #ifdef ENABLEIMGUI
+    ImGui_ImplSDLRenderer3_NewFrame();
+    ImGui_ImplSDL3_NewFrame();
+    ImGui::NewFrame();
+    #endif
+
+    SDL_SetRenderDrawColorFloat(renderer, 0.0, 0.0, 0.0, SDL_ALPHA_OPAQUE_FLOAT);
+    SDL_RenderClear(renderer);
+
+    #ifdef ENABLEIMGUI
+        // Update editor
+        editor.Update(renderDelta, renderer);
+
+        // Draw editor UI
+        editor.DrawUI();
+        DrawFrameGraphUI();
+    #endif
+
+    // Materials the editor loaded this frame join the atlas before drawing.
+    // Never with the render thread on, the front list still draws the old pages.
+    if (!pipeline.IsRunning())
+        MaterialManager::GetInstance().UpdateAtlas();
+
+    // The world is the simulation thread's again after Kick, draw the list
+    // it recorded last
+    if (pipeline.IsRunning()) {
+        pipeline.Kick();
+        SpriteBatch &batch = SpriteBatch::GetInstance();
+        batch.Begin();
+        RenderQueue::Draw(pipeline.GetFront(), batch);
+        batch.End();
+    } else {
+        world.DrawEntities();
+    }
+
+    #ifdef ENABLEIMGUI
+    ImGui::Render();
+    ImGuiIO& io = ImGui::GetIO(); (void)io;
+    SDL_SetRenderScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
+    ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+    #endif
+
+    SDL_RenderPresent(renderer);
+}
+
+// Gameplay rate, rendering still runs as fast as the display allows
+static void SetSimulationRate(int hz) {
+    if (hz <= 0)
+        return;
+    fixedStepNS = SDL_NS_PER_SECOND / (Uint64)hz;
+    frameDelta = (double)fixedStepNS / (double)SDL_NS_PER_SECOND;
+}
+
+// One fixed step: input, then the frame graph. A replay feeds the recorded
+// input and dt instead of the keyboard.
+static void SimulateStep(World &world, InputState_t keyboard) {
+    InputRecorder &recorder = InputRecorder::GetInstance();
+    InputSystem::GetInstance().BeginStep(keyboard);
+    double dt = frameDelta;
+    recorder.BeforeStep(dt);
+    stepDelta = dt;
+    world.BeginStep();
+    frameGraph.Run();
+    recorder.AfterStep(world);
+}
+
+// Fixed steps for the time since the last call, returns how many ran. On
+// the simulation thread when the frame pipeline runs.
+static int AdvanceSimulation(World &world, InputState_t keyboard) {
+    const Uint64 now = SDL_GetTicksNS();
+    if (oldNowNS == 0)
+        oldNowNS = now;
+    Uint64 elapsed = now - oldNowNS; // time since last frame
+    oldNowNS = now; // update for next iteration
+
+    renderDelta = (double)elapsed / (double)SDL_NS_PER_SECOND;
+    accumulatorNS += elapsed;
+
+    int steps = 0;
+    if (headless && uncapped) {
+        SimulateStep(world, keyboard);
+        steps = 1;
+    } else {
+        while (accumulatorNS >= fixedStepNS && steps < MAX_CATCHUP_STEPS) {
+            SimulateStep(world, keyboard);
+            accumulatorNS -= fixedStepNS;
+            steps++;
+        }
+
+        // Heavy frame: don't carry the backlog into the next frame
+        if (accumulatorNS >= fixedStepNS)
+            accumulatorNS %= fixedStepNS;
+    }
+
+    simSteps += steps;
+    return steps;
+}
+
+static bool IsRunDone() {
+    return (maxSteps && simSteps >= maxSteps) || InputRecorder::GetInstance().IsReplayDone();
+}
+
+// Exit status of a finished run, a replay that diverged fails
+static SDL_AppResult RunResult() {
+    return InputRecorder::GetInstance().GetReplayStats().mismatches ? SDL_APP_FAILURE : SDL_APP_SUCCESS;
+}
+
+// Each phase declares what it reads and writes, the graph orders phases that
+// conflict and lets the others overlap (animation runs next to broadphase).
+// The phases are World's, the same Step runs.
+static void BuildFrameGraph() {
+    World &world = World::GetInstance();
+    for (const WorldPhase_t &phase : World::GetStepPhases()) {
+        frameGraph.AddTask(phase.name, phase.reads, phase.writes, [&world, &phase]() {
+            phase.run(world, stepDelta);
+        });
+    }
+}
+
 /* This function runs once at startup. */
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[])
 {
@@ -66,37 +252,169 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[])
     luaopen_camera(L);
     #endif
 
+    SetSimulationRate(60);
+    bool replicationLoopback = false;
+    bool rollbackLoopback = false;
+    bool renderBench = false;
+    const WorldBenchEntry_t *worldBench = nullptr;
+    int worldBenchSize = 0;
+    bool renderThread = false;
+    FrameLatency_t renderLatency = FrameLatency_t::PIPELINED;
+    RenderBenchSettings_t renderBenchSettings;
+    ReplicationBenchSettings_t replicationBench;
+    RollbackBenchSettings_t rollbackBench;
+    LinkSettings_t netLink = replicationBench.link;
+    for (int i = 1; i < argc; i++) {
+        if (SDL_strncmp(argv[i], "--tick-rate=", 12) == 0)
+            SetSimulationRate(SDL_atoi(argv[i] + 12));
+        else if (SDL_strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (SDL_strcmp(argv[i], "--uncapped") == 0)
+            uncapped = true;
+        else if (SDL_strncmp(argv[i], "--steps=", 8) == 0)
+            maxSteps = (Uint64)SDL_atoi(argv[i] + 8);
+        else if (SDL_strncmp(argv[i], "--replication-loopback", 22) == 0) {
+            replicationLoopback = true;
+            if (argv[i][22] == '=')
+                replicationBench.clients = SDL_atoi(argv[i] + 23);
+        }
+        else if (SDL_strncmp(argv[i], "--replication-entities=", 23) == 0)
+            replicationBench.entities = SDL_atoi(argv[i] + 23);
+        else if (SDL_strncmp(argv[i], "--net-latency=", 14) == 0)
+            netLink.latencyMs = SDL_atof(argv[i] + 14);
+        else if (SDL_strncmp(argv[i], "--net-loss=", 11) == 0)
+            netLink.loss = SDL_atof(argv[i] + 11) / 100.0;
+        else if (SDL_strncmp(argv[i], "--interest-radius=", 18) == 0)
+            replicationBench.interestRadius = (float)SDL_atof(argv[i] + 18);
+        else if (SDL_strcmp(argv[i], "--rollback-loopback") == 0)
+            rollbackLoopback = true;
+        else if (SDL_strncmp(argv[i], "--rollback-delay=", 17) == 0)
+            rollbackBench.rollback.inputDelay = SDL_atoi(argv[i] + 17);
+        else if (SDL_strncmp(argv[i], "--rollback-frames=", 18) == 0)
+            rollbackBench.rollback.maxRollback = SDL_atoi(argv[i] + 18);
+        else if (SDL_strncmp(argv[i], "--rollback-desync-at=", 21) == 0)
+            rollbackBench.desyncAt = SDL_atoi(argv[i] + 21);
+        else if (SDL_strncmp(argv[i], "--record=", 9) == 0)
+            recordPath = argv[i] + 9;
+        else if (SDL_strncmp(argv[i], "--replay=", 9) == 0)
+            replayPath = argv[i] + 9;
+        else if (SDL_strncmp(argv[i], "--atlas", 7) == 0)
+            atlasPageSize = argv[i][7] == '=' ? SDL_atoi(argv[i] + 8) : 2048;
+        else if (const WorldBenchEntry_t *bench = WorldBench::Match(argv[i], worldBenchSize))
+            worldBench = bench;
+        else if (SDL_strcmp(argv[i], "--render-thread") == 0)
+            renderThread = true;
+        else if (SDL_strcmp(argv[i], "--low-latency") == 0)
+            renderLatency = FrameLatency_t::LOW;
+        else if (SDL_strncmp(argv[i], "--render-bench-frames=", 22) == 0)
+            renderBenchSettings.frames = SDL_atoi(argv[i] + 22);
+        else if (SDL_strncmp(argv[i], "--render-bench-expect=", 22) == 0)
+            renderBenchSettings.expectHash = SDL_strtoull(argv[i] + 22, nullptr, 16);
+        else if (SDL_strncmp(argv[i], "--render-bench", 14) == 0) {
+            renderBench = true;
+            if (argv[i][14] == '=')
+                renderBenchSettings.sprites = SDL_atoi(argv[i] + 15);
+        }
+    }
+
+    // Replays run as fast as possible, the recording holds the dts
+    if (replayPath) {
+        headless = true;
+        uncapped = true;
+    }
+
+    // Self-contained server + clients benchmark, no window
+    if (replicationLoopback) {
+        headless = true;
+        replicationBench.link = netLink;
+        replicationBench.tickRate = (int)(1.0 / frameDelta + 0.5);
+        return RunReplicationLoopback(replicationBench) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+
+    // Two rollback peers with scripted input, no window
+    if (rollbackLoopback) {
+        headless = true;
+        rollbackBench.link = netLink;
+        rollbackBench.tickRate = (int)(1.0 / frameDelta + 0.5);
+        return RunRollbackLoopback(rollbackBench) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+
+    // World update benchmarks, no window
+    if (worldBench)
+        return WorldBench::RunBench(*worldBench, worldBenchSize) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+
+    // Software renderer into memory, no window
+    if (renderBench)
+        return RunRenderBench(renderBenchSettings) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+
     /* Initialize our world */
     Screen &screen = Screen::GetInstance();
+    if (!screen.Init(headless))
+        return SDL_APP_FAILURE;
     World &world = World::GetInstance();
     Camera::GetInstance();
 
     #ifdef ENABLEIMGUI
-    float main_scale = SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay());
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
-
-    ImGui::StyleColorsDark();
-    ImGuiStyle& style = ImGui::GetStyle();
-    style.ScaleAllSizes(main_scale);
-    style.ScaleAllSizes(main_scale);
-    style.FontScaleDpi = main_scale;
-
-    // Setup Platform/Renderer backends
-    ImGui_ImplSDL3_InitForSDLRenderer(screen.GetWindow(), screen.GetRenderer());
-    ImGui_ImplSDLRenderer3_Init(screen.GetRenderer());
+    if (!headless) {
+        float main_scale = SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay());
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void)io;
+        io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;     // Enable Keyboard Controls
+        io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;      // Enable Gamepad Controls
+
+        ImGui::StyleColorsDark();
+        ImGuiStyle& style = ImGui::GetStyle();
+        style.ScaleAllSizes(main_scale);
+        style.ScaleAllSizes(main_scale);
+        style.FontScaleDpi = main_scale;
+
+        // Setup Platform/Renderer backends
+        ImGui_ImplSDL3_InitForSDLRenderer(screen.GetWindow(), screen.GetRenderer());
+        ImGui_ImplSDLRenderer3_Init(screen.GetRenderer());
+    }
     #endif
 
     SDL_Log("%s", SDL_GetBasePath());
 
     MaterialManager::GetInstance().LoadMaterial("player", "Assets/sprites/knight.png");
     MaterialManager::GetInstance().LoadMaterial("tiles", "Assets/sprites/world_tileset.png");
+    if (atlasPageSize > 0 && MaterialManager::GetInstance().EnableAtlas(atlasPageSize)) {
+        const TextureAtlas &atlas = MaterialManager::GetInstance().GetAtlas();
+        SDL_Log("Texture atlas: %zu pages, %.1f%% occupied", atlas.GetPages().size(), atlas.GetOccupancy() * 100.0);
+    }
 
     Camera::GetInstance().SetZoom(2.0f);
 
+    BuildFrameGraph();
+
+    // Materials are loaded, the snapshot in the recording can refer to them
+    if (replayPath && !InputRecorder::GetInstance().StartReplay(world, replayPath))
+        return SDL_APP_FAILURE;
+    if (recordPath)
+        InputRecorder::GetInstance().StartRecording(world);
+
+    if (headless)
+        SDL_Log("Headless, %s at %.0f Hz", uncapped ? "uncapped" : "fixed tick", 1.0 / frameDelta);
+    runStartNS = SDL_GetTicksNS();
+
+    // Chunk cache targets are rendered to, which only this thread may do.
+    // Recorded frames bypass the cache, so drop its textures now.
+    if (renderThread && !headless) {
+        world.SetDrawCache(false);
+        pipeline.SetLatency(renderLatency);
+        pipeline.Start([](DrawList_t &list) {
+            World &world = World::GetInstance();
+            AdvanceSimulation(world, keyboardInput);
+            world.Interpolate((float)((double)accumulatorNS / (double)fixedStepNS));
+            world.RecordEntities(list);
+        });
+        SDL_Log("Render thread on, %s", renderLatency == FrameLatency_t::PIPELINED ? "pipelined" : "low latency");
+        #ifdef ENABLEIMGUI
+        editor.SetAssetsLocked(true);
+        #endif
+    }
+
     /*Player *player = new Player();
     player->SetScale(1.0f);
     player->SetPosition({0.0, 0.0});
@@ -137,7 +455,8 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
     }
 
     #ifdef ENABLEIMGUI
-    ImGui_ImplSDL3_ProcessEvent(event);
+    if (!headless)
+        ImGui_ImplSDL3_ProcessEvent(event);
     #endif
 
     return SDL_APP_CONTINUE;  /* carry on with the program! */
@@ -146,48 +465,33 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
 /* This function runs once per frame, and is the heart of the program. */
 SDL_AppResult SDL_AppIterate(void *appstate)
 {
-    const double now = ((double)SDL_GetTicks()) / 1000.0; // current time in seconds
-    double deltaTime = now - oldNow; // time since last frame
-    oldNow = now; // update for next iteration
-
-    Screen &screen = Screen::GetInstance();
     World &world = World::GetInstance();
-    auto &collisionSystem = CollisionSystem::GetInstance();
-    SDL_Renderer *renderer = screen.GetRenderer();
-    Camera &camera = Camera::GetInstance();
 
-    world.ProcessEntities(deltaTime);
-
-    auto collisions = collisionSystem.DetectCollisions(world.GetEntities());
-    collisionSystem.ResolveCollisions(collisions);
-
-    #ifdef ENABLEIMGUI
-    ImGui_ImplSDLRenderer3_NewFrame();
-    ImGui_ImplSDL3_NewFrame();
-    ImGui::NewFrame();
-    #endif
-
-    SDL_SetRenderDrawColorFloat(renderer, 0.0, 0.0, 0.0, SDL_ALPHA_OPAQUE_FLOAT);
-    SDL_RenderClear(renderer);
-
-    #ifdef ENABLEIMGUI
-        // Update editor
-        editor.Update(deltaTime, renderer);
-
-        // Draw editor UI
-        editor.DrawUI();
-    #endif
+    // The simulation thread stays idle from Sync until RenderFrame kicks
+    // the next frame, the editor can change the world in between
+    if (pipeline.IsRunning()) {
+        pipeline.Sync();
+        if (IsRunDone())
+            return RunResult();
+        keyboardInput = InputSystem::ReadKeyboard();
+        RenderFrame();
+        return SDL_APP_CONTINUE;
+    }
 
-    world.DrawEntities();
+    keyboardInput = InputSystem::ReadKeyboard();
+    int steps = AdvanceSimulation(world, keyboardInput);
+    if (IsRunDone())
+        return RunResult();
 
-    #ifdef ENABLEIMGUI
-    ImGui::Render();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    SDL_SetRenderScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
-    ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
-    #endif
+    if (headless) {
+        // Nothing to draw, sleep until the next tick is due
+        if (steps == 0)
+            SDL_DelayNS(fixedStepNS - accumulatorNS);
+        return SDL_APP_CONTINUE;
+    }
 
-    SDL_RenderPresent(renderer);
+    world.Interpolate((float)((double)accumulatorNS / (double)fixedStepNS));
+    RenderFrame();
 
     return SDL_APP_CONTINUE;
 }
@@ -195,21 +499,41 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 /* This function runs once at shutdown. */
 void SDL_AppQuit(void *appstate, SDL_AppResult result)
 {
+    pipeline.Stop();
+
     #ifdef ENABLEIMGUI
-    ImGui_ImplSDLRenderer3_Shutdown();
-    ImGui_ImplSDL3_Shutdown();
-    ImGui::DestroyContext();
+    if (!headless) {
+        ImGui_ImplSDLRenderer3_Shutdown();
+        ImGui_ImplSDL3_Shutdown();
+        ImGui::DestroyContext();
+    }
     #endif
 
+    double runMs = (double)(SDL_GetTicksNS() - runStartNS) / 1e6;
+    SDL_Log("Ran %llu steps in %.1f ms (%.3f ms/step)", (unsigned long long)simSteps, runMs,
+            simSteps ? runMs / (double)simSteps : 0.0);
+
+    InputRecorder &recorder = InputRecorder::GetInstance();
+    if (replayPath) {
+        const ReplayStats_t &replay = recorder.GetReplayStats();
+        SDL_Log("Replay: %zu of %zu frames, %.3f ms/frame simulated, %zu mismatches",
+                replay.frames, recorder.GetFrameCount(),
+                replay.frames ? replay.stepMs / (double)replay.frames : 0.0, replay.mismatches);
+        if (replay.mismatches)
+            SDL_Log("Replay: first mismatch at frame %lld", (long long)replay.firstMismatch);
+    }
+    if (recordPath) {
+        recorder.StopRecording();
+        if (recorder.Save(recordPath))
+            SDL_Log("Recorded %zu frames to %s", recorder.GetFrameCount(), recordPath);
+    }
+
     #ifdef ENABLELUA
     lua_close(L);
     #endif
 
     MaterialManager::GetInstance().UnloadAll();
 
-    for (auto &e : World::GetInstance().GetEntities()) {
-        if (e == nullptr)
-            continue;
-        delete e;
-    }
+    World::GetInstance().ClearEntities();
+    EntityPoolRegistry::GetInstance().LogStats();
 }
\ No newline at end of file